@@ -0,0 +1,174 @@
+/*******************************************************************************
+* parse_ascii.c: this file is part of the cutsky program.
+
+* cutsky: cutsky catalogue generator.
+
+* Github repository:
+        https://github.com/cheng-zhao/cutsky
+
+* Copyright (c) 2023-2025 Cheng Zhao <zhaocheng03@gmail.com> [MIT license]
+
+*******************************************************************************/
+
+#include "read_file.h"
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <float.h>
+
+/*============================================================================*\
+                    Definitions for the fast number parser
+\*============================================================================*/
+
+/* Maximum number of significant digits stored in the integer mantissa. */
+#define PARSE_MAX_DIGIT         19
+/* Maximum mantissa that can be represented exactly by a double. */
+#define PARSE_MAX_MANT          (UINT64_C(1) << 53)
+/* Maximum power of 10 that can be represented exactly by a double. */
+#define PARSE_MAX_POW10         22
+/* Cap of the parsed exponent for avoiding integer overflows. */
+#define PARSE_MAX_EXP           100000
+
+/* The fast path relies on correctly rounded double-precision arithmetics. */
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+  #define PARSE_FAST_PATH
+#endif
+
+/* Whitespaces except for '\n', which terminates memory mapped lines. */
+#define PARSE_IS_SPACE(c)       ((c) == ' ' || (c) == '\t' || (c) == '\v' ||  \
+    (c) == '\f' || (c) == '\r')
+#define PARSE_IS_DIGIT(c)       ((unsigned) ((c) - '0') < 10)
+/* Characters that may continue a number in formats handled by `strtod`. */
+#define PARSE_IS_ALNUM(c)       (PARSE_IS_DIGIT(c) || (c) == '.' ||     \
+    ((unsigned) (((c) | 0x20) - 'a') < 26))
+
+
+/*============================================================================*\
+                      Functions for parsing numbers
+\*============================================================================*/
+
+#ifdef PARSE_FAST_PATH
+/******************************************************************************
+Function `parse_dbl_fast`:
+  Convert a decimal number to double precision, if it is exactly representable
+  as an integer mantissa and a power of 10 that are both exact in double
+  precision (Clinger's fast path), in which case a single multiplication or
+  division gives the correctly rounded result.
+Arguments:
+  * `str`:      the string to be parsed;
+  * `val`:      the parsed value;
+  * `end`:      the first character after the number.
+Return:
+  Zero on success; non-zero if the fast path is not applicable.
+******************************************************************************/
+static inline int parse_dbl_fast(const char *str, double *val,
+    const char **end) {
+  static const double ptab[PARSE_MAX_POW10 + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+    1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  const char *p = str;
+  bool neg = false;
+  if (*p == '-') {
+    neg = true;
+    p++;
+  }
+  else if (*p == '+') p++;
+
+  /* Integer and fractional parts, with leading zeros omitted. */
+  uint64_t mant = 0;
+  int ndigit = 0, nsig = 0, exp = 0;
+  for (; PARSE_IS_DIGIT(*p); p++, ndigit++) {
+    if (nsig || *p != '0') {
+      if (++nsig > PARSE_MAX_DIGIT) return 1;
+      mant = mant * 10 + (*p - '0');
+    }
+  }
+  if (*p == '.') {
+    for (p++; PARSE_IS_DIGIT(*p); p++, ndigit++) {
+      if (nsig || *p != '0') {
+        if (++nsig > PARSE_MAX_DIGIT) return 1;
+        mant = mant * 10 + (*p - '0');
+      }
+      exp--;
+    }
+  }
+  if (!ndigit) return 1;
+
+  /* Exponent. */
+  if ((*p | 0x20) == 'e') {
+    const char *q = p + 1;
+    bool eneg = false;
+    if (*q == '-') {
+      eneg = true;
+      q++;
+    }
+    else if (*q == '+') q++;
+    if (!PARSE_IS_DIGIT(*q)) return 1;
+    int e = 0;
+    for (; PARSE_IS_DIGIT(*q); q++) {
+      if (e < PARSE_MAX_EXP) e = e * 10 + (*q - '0');
+    }
+    exp += eneg ? -e : e;
+    p = q;
+  }
+
+  /* Leave unusual formats, such as hexadecimals, to `strtod`. */
+  if (PARSE_IS_ALNUM(*p)) return 1;
+
+  if (mant > PARSE_MAX_MANT) return 1;
+  double v = (double) mant;
+  if (mant == 0) exp = 0;
+  if (exp < 0) {
+    if (exp < -PARSE_MAX_POW10) return 1;
+    v /= ptab[-exp];
+  }
+  else if (exp > 0) {
+    if (exp > PARSE_MAX_POW10) return 1;
+    v *= ptab[exp];
+  }
+
+  *val = neg ? -v : v;
+  *end = p;
+  return 0;
+}
+#endif
+
+
+/*============================================================================*\
+                     Interface for parsing ASCII records
+\*============================================================================*/
+
+/******************************************************************************
+Function `parse_dbl_fields`:
+  Parse whitespace-separated floating-point numbers from a string, and save
+  them to separate arrays, in the same way as `sscanf` with "%lf %lf ...".
+  The string is terminated by either '\0' or '\n'.
+Arguments:
+  * `line`:     the string to be parsed;
+  * `nfield`:   number of fields to be parsed;
+  * `out`:      arrays for the parsed numbers, one for each field;
+  * `idx`:      index of the parsed numbers in the arrays.
+Return:
+  Number of successfully parsed fields.
+******************************************************************************/
+int parse_dbl_fields(const char *line, const int nfield, double *const *out,
+    const size_t idx) {
+  const char *p = line;
+  for (int i = 0; i < nfield; i++) {
+    while (PARSE_IS_SPACE(*p)) p++;
+    const char *end;
+#ifdef PARSE_FAST_PATH
+    if (!parse_dbl_fast(p, out[i] + idx, &end)) {
+      p = end;
+      continue;
+    }
+#endif
+    /* Fallback for the general cases. */
+    if (*p == '\n' || *p == '\0') return i;
+    out[i][idx] = strtod(p, (char **) &end);
+    if (end == p) return i;
+    p = end;
+  }
+  return nfield;
+}
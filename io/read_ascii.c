@@ -10,16 +10,60 @@
 
 *******************************************************************************/
 
+#define _DEFAULT_SOURCE         /* for `madvise` */
 #include "define.h"
 #include "read_file.h"
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>     /* IWYU pragma: keep */
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 /*============================================================================*\
                           Function for reading chunks
 \*============================================================================*/
 
+/******************************************************************************
+Function `read_bytes`:
+  Read bytes from the file stream, or from the byte range of the file with
+  `pread` if there is no stream.
+Arguments:
+  * `ifile`:    interface for file reading;
+  * `dst`:      buffer for the bytes to be read;
+  * `num`:      maximum number of bytes to be read.
+Return:
+  Number of bytes read.
+******************************************************************************/
+static size_t read_bytes(IFILE *ifile, char *dst, size_t num) {
+  if (ifile->fp) return fread(dst, sizeof(char), num, ifile->fp);
+
+  if (num > ifile->fsize - ifile->fpos) num = ifile->fsize - ifile->fpos;
+  size_t nread = 0;
+  while (nread < num) {
+    ssize_t n = pread(ifile->fd, dst + nread, num - nread,
+        (off_t) (ifile->fpos + nread));
+    if (n <= 0) break;
+    nread += n;
+  }
+  ifile->fpos += nread;
+  return nread;
+}
+
+/******************************************************************************
+Function `read_eof`:
+  Check whether the end of the file or the byte range is reached.
+Arguments:
+  * `ifile`:    interface for file reading.
+Return:
+  True if the end is reached.
+******************************************************************************/
+static inline bool read_eof(IFILE *ifile) {
+  if (ifile->fp) return feof(ifile->fp);
+  return ifile->fpos >= ifile->fsize;
+}
+
 /******************************************************************************
 Function `readchunk_ascii`:
   Read a chunk from an ASCII file.
@@ -53,7 +97,7 @@ static inline int readchunk_ascii(IFILE *ifile) {
     ifile->size = size;
   }
 
-  nread = fread(ifile->chunk + ifile->rest, sizeof(char), nread, ifile->fp);
+  nread = read_bytes(ifile, ifile->chunk + ifile->rest, nread);
   ifile->used = 0;
   ifile->rest += nread;
 
@@ -65,6 +109,151 @@ static inline int readchunk_ascii(IFILE *ifile) {
 }
 
 
+/*============================================================================*\
+                     Functions for memory mapped file reading
+\*============================================================================*/
+
+/******************************************************************************
+Function `fd_close`:
+  Release the mapped window and the descriptor of a file that is read without
+  the stream interface, i.e., through memory mapping or `pread`.
+Arguments:
+  * `ifile`:    interface for file reading.
+******************************************************************************/
+static void fd_close(IFILE *ifile) {
+  if (ifile->map) munmap(ifile->map, ifile->mlen);
+  ifile->map = NULL;
+  ifile->moff = ifile->mlen = 0;
+  if (ifile->fd != -1 && close(ifile->fd))
+    P_WRN("failed to close file: `%s'\n", ifile->fname);
+  ifile->fd = -1;
+}
+
+/******************************************************************************
+Function `fd_release`:
+  Close the file opened without the stream interface, and restore the buffer
+  for reading by chunks if the file is memory mapped.
+Arguments:
+  * `ifile`:    interface for file reading.
+******************************************************************************/
+static void fd_release(IFILE *ifile) {
+  fd_close(ifile);
+  if (ifile->mapped) {
+    ifile->chunk = ifile->buf;
+    ifile->buf = NULL;
+    ifile->mapped = false;
+  }
+}
+
+/******************************************************************************
+Function `mmap_window`:
+  Map a window of the file, starting from the page containing a given offset.
+Arguments:
+  * `ifile`:    interface for file reading;
+  * `pos`:      offset of the first byte to be mapped.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int mmap_window(IFILE *ifile, const size_t pos) {
+  long psize = sysconf(_SC_PAGESIZE);
+  if (psize <= 0) psize = 4096;
+
+  if (ifile->map) munmap(ifile->map, ifile->mlen);
+  ifile->moff = pos - pos % (size_t) psize;
+  ifile->mlen = ifile->fsize - ifile->moff;
+  if (ifile->mlen > CUTSKY_MMAP_WINDOW) ifile->mlen = CUTSKY_MMAP_WINDOW;
+
+  ifile->map = mmap(NULL, ifile->mlen, PROT_READ, MAP_PRIVATE, ifile->fd,
+      (off_t) ifile->moff);
+  if (ifile->map == MAP_FAILED) {
+    ifile->map = NULL;
+    ifile->mlen = 0;
+    P_ERR("failed to map file into memory: `%s'\n", ifile->fname);
+    return CUTSKY_ERR_FILE;
+  }
+
+  /* Hints for the access pattern; failures are harmless. */
+#ifdef MADV_SEQUENTIAL
+  madvise(ifile->map, ifile->mlen, MADV_SEQUENTIAL);
+#endif
+#ifdef MADV_HUGEPAGE
+  madvise(ifile->map, ifile->mlen, MADV_HUGEPAGE);
+#endif
+  return 0;
+}
+
+/******************************************************************************
+Function `mmap_readlines`:
+  Locate multiple records (lines) in the memory mapped file, and slide the
+  window if necessary. Fewer lines are reported if the window is exhausted.
+Arguments:
+  * `ifile`:    interface for file reading;
+  * `nline`:    maximum number of lines to be read at once.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int mmap_readlines(IFILE *ifile, const size_t nline) {
+  ifile->nline = 0;
+  if (ifile->fd == -1 || ifile->fpos >= ifile->fsize) return 0;
+
+  bool remap = !ifile->map || ifile->fpos < ifile->moff ||
+      ifile->fpos >= ifile->moff + ifile->mlen;
+  for (;;) {
+    int ecode;
+    if (remap && (ecode = mmap_window(ifile, ifile->fpos))) return ecode;
+
+    const char *begin = ifile->map + (ifile->fpos - ifile->moff);
+    const char *end = ifile->map + ifile->mlen;
+    const char *base = begin;
+    size_t *pos = ifile->lines;
+    ifile->nline = scan_newlines(base, end - base, pos, nline);
+    for (size_t i = 0; i < ifile->nline; i++) {
+      const char *nl = base + pos[i];
+      pos[i] = begin - ifile->map;
+      begin = nl + 1;
+    }
+
+    if (ifile->nline) {
+      ifile->chunk = ifile->map;
+      ifile->fpos = ifile->moff + (begin - ifile->map);
+      return 0;
+    }
+
+    /* Copy the last line if it is not ending with '\n'. */
+    if (ifile->moff + ifile->mlen == ifile->fsize) {
+      const size_t len = end - begin;
+      if (len >= ifile->size) {
+        if (len >= CUTSKY_MAX_CHUNK) {
+          P_ERR("line of ASCII file exceeding %d bytes\n", CUTSKY_MAX_CHUNK);
+          return CUTSKY_ERR_FILE;
+        }
+        char *tmp = realloc(ifile->buf, (len + 1) * sizeof(char));
+        if (!tmp) {
+          P_ERR("failed to allocate memory for reading file by chunk\n");
+          return CUTSKY_ERR_MEMORY;
+        }
+        ifile->buf = tmp;
+        ifile->size = len + 1;
+      }
+      memcpy(ifile->buf, begin, len);
+      ifile->buf[len] = '\0';
+      ifile->chunk = ifile->buf;
+      ifile->lines[0] = 0;
+      ifile->nline = 1;
+      ifile->fpos = ifile->fsize;
+      return 0;
+    }
+
+    /* Restart the window from the current line. */
+    if (remap) {
+      P_ERR("line of ASCII file exceeding %d bytes\n", CUTSKY_MMAP_WINDOW);
+      return CUTSKY_ERR_FILE;
+    }
+    remap = true;
+  }
+}
+
+
 /*============================================================================*\
                           Interfaces for file reading
 \*============================================================================*/
@@ -88,6 +277,10 @@ IFILE *input_init(void) {
   ifile->used = ifile->rest = 0;
   ifile->size = CUTSKY_FILE_CHUNK;
   ifile->nline = ifile->maxline = 0;
+  ifile->mapped = false;
+  ifile->fd = -1;
+  ifile->buf = ifile->map = NULL;
+  ifile->moff = ifile->mlen = ifile->fsize = ifile->fpos = 0;
   ifile->chunk = calloc(ifile->size, sizeof(char));
   if (!ifile->chunk) {
     P_ERR("failed to allocate memory for reading file by chunk\n");
@@ -106,6 +299,7 @@ Arguments:
 ******************************************************************************/
 void input_destroy(IFILE *ifile) {
   if (!ifile) return;
+  fd_release(ifile);
   free(ifile->chunk);
   if (ifile->lines) free(ifile->lines);
   if (ifile->fp) {
@@ -137,6 +331,7 @@ int input_newfile(IFILE *ifile, const char *fname) {
   /* Close the previous file and open the current one. */
   if (ifile->fp && fclose(ifile->fp))
     P_WRN("failed to close file: `%s'\n", ifile->fname);
+  fd_release(ifile);
 
   ifile->fp = NULL;
   if (!(ifile->fp = fopen(fname, "r"))) {
@@ -158,6 +353,290 @@ int input_newfile(IFILE *ifile, const char *fname) {
   return 0;
 }
 
+/******************************************************************************
+Function `input_newfile_mmap`:
+  Open a new file for reading through memory mapping.
+Arguments:
+  * `ifile`:    interface for file reading;
+  * `fname`:    name of the file to be read from.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+int input_newfile_mmap(IFILE *ifile, const char *fname) {
+  if (!ifile) {
+    P_ERR("the interface for file reading is not initialized\n");
+    return CUTSKY_ERR_ARG;
+  }
+  if (!fname || !(*fname)) {
+    P_ERR("invalid input file name\n");
+    return CUTSKY_ERR_ARG;
+  }
+
+  /* Close the previous file, and keep the buffer for the last line. */
+  if (ifile->fp && fclose(ifile->fp))
+    P_WRN("failed to close file: `%s'\n", ifile->fname);
+  ifile->fp = NULL;
+  fd_close(ifile);
+  if (!ifile->mapped) {
+    ifile->buf = ifile->chunk;
+    ifile->chunk = NULL;
+    ifile->mapped = true;
+  }
+  ifile->used = ifile->rest = ifile->nline = 0;
+
+  if ((ifile->fd = open(fname, O_RDONLY)) == -1) {
+    P_ERR("failed to open file for reading: `%s'\n", fname);
+    return CUTSKY_ERR_FILE;
+  }
+  struct stat st;
+  if (fstat(ifile->fd, &st)) {
+    P_ERR("failed to get the status of file: `%s'\n", fname);
+    return CUTSKY_ERR_FILE;
+  }
+  if (!st.st_size) {
+    P_ERR("empty file: `%s'\n", fname);
+    return CUTSKY_ERR_FILE;
+  }
+
+  ifile->fname = fname;
+  ifile->fsize = st.st_size;
+  ifile->fpos = 0;
+  return 0;
+}
+
+/******************************************************************************
+Function `input_ranges`:
+  Split a file into byte ranges with boundaries aligned to line breaks.
+Arguments:
+  * `fname`:    name of the file to be split;
+  * `nrange`:   number of byte ranges;
+  * `offset`:   offsets of range boundaries, with length `nrange` + 1.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+int input_ranges(const char *fname, const int nrange, size_t *offset) {
+  if (!fname || !(*fname) || nrange <= 0 || !offset) {
+    P_ERR("invalid arguments for splitting the input file\n");
+    return CUTSKY_ERR_ARG;
+  }
+
+  int fd = open(fname, O_RDONLY);
+  if (fd == -1) {
+    P_ERR("failed to open file for reading: `%s'\n", fname);
+    return CUTSKY_ERR_FILE;
+  }
+  struct stat st;
+  if (fstat(fd, &st)) {
+    P_ERR("failed to get the status of file: `%s'\n", fname);
+    close(fd);
+    return CUTSKY_ERR_FILE;
+  }
+  const size_t fsize = st.st_size;
+  if (!fsize) {
+    P_ERR("empty file: `%s'\n", fname);
+    close(fd);
+    return CUTSKY_ERR_FILE;
+  }
+
+  /* Move each nominal boundary to the beginning of the next line. */
+  char buf[BUFSIZ];
+  offset[0] = 0;
+  offset[nrange] = fsize;
+  for (int i = 1; i < nrange; i++) {
+    size_t pos = fsize / nrange * i;
+    if (pos < offset[i - 1]) pos = offset[i - 1];
+    if (pos == 0) {
+      offset[i] = 0;
+      continue;
+    }
+    pos -= 1;           /* the range starts right after a '\n' */
+    for (;;) {
+      ssize_t n = pread(fd, buf, BUFSIZ, (off_t) pos);
+      if (n < 0) {
+        P_ERR("failed to read file: `%s'\n", fname);
+        close(fd);
+        return CUTSKY_ERR_FILE;
+      }
+      if (n == 0) {
+        pos = fsize;
+        break;
+      }
+      const char *nl = memchr(buf, '\n', n);
+      if (nl) {
+        pos += nl - buf + 1;
+        break;
+      }
+      pos += n;
+    }
+    offset[i] = pos;
+  }
+
+  if (close(fd)) P_WRN("failed to close file: `%s'\n", fname);
+  return 0;
+}
+
+/******************************************************************************
+Function `input_count_records`:
+  Count records in a byte range of an ASCII file, i.e., lines that are neither
+  empty nor comments, by scanning line breaks without parsing the lines.
+Arguments:
+  * `fname`:    name of the file to be scanned;
+  * `start`:    offset of the first byte of the range;
+  * `end`:      offset of the byte right after the range, SIZE_MAX for the
+                end of the file;
+  * `comment`:  the comment symbol, '\0' for disabling comments;
+  * `num`:      number of records in the range.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+int input_count_records(const char *fname, const size_t start,
+    const size_t end, const char comment, size_t *num) {
+  if (!fname || !(*fname) || start > end || !num) {
+    P_ERR("invalid arguments for counting records in the input file\n");
+    return CUTSKY_ERR_ARG;
+  }
+
+  int fd = open(fname, O_RDONLY);
+  if (fd == -1) {
+    P_ERR("failed to open file for reading: `%s'\n", fname);
+    return CUTSKY_ERR_FILE;
+  }
+
+  size_t size = CUTSKY_FILE_CHUNK;
+  char *buf = malloc(size * sizeof(char));
+  size_t *pos = malloc(CUTSKY_DATA_CHUNK * sizeof(size_t));
+  if (!buf || !pos) {
+    P_ERR("failed to allocate memory for counting records\n");
+    if (buf) free(buf);
+    if (pos) free(pos);
+    close(fd);
+    return CUTSKY_ERR_MEMORY;
+  }
+
+  size_t rest = 0, nrec = 0, fpos = start;
+  for (;;) {
+    /* Read the range with `pread`, to be run in parallel for many ranges. */
+    size_t nread = 0;
+    if (fpos < end) {
+      size_t nmax = size - rest;
+      if (nmax > end - fpos) nmax = end - fpos;
+      ssize_t n = pread(fd, buf + rest, nmax, (off_t) fpos);
+      if (n < 0) {
+        P_ERR("failed to read file: `%s'\n", fname);
+        free(buf); free(pos); close(fd);
+        return CUTSKY_ERR_FILE;
+      }
+      nread = n;
+      fpos += nread;
+    }
+
+    size_t done;
+    if (!nread) {
+      /* The last line may not be ending with '\n'. */
+      if (rest) {
+        buf[rest++] = '\n';
+        nrec += scan_records(buf, rest, comment, pos, CUTSKY_DATA_CHUNK,
+            &done);
+      }
+      break;
+    }
+
+    /* Count records in complete lines, and keep the incomplete one. */
+    const size_t len = rest + nread;
+    nrec += scan_records(buf, len, comment, pos, CUTSKY_DATA_CHUNK, &done);
+    rest = len - done;
+    if (rest && done) memmove(buf, buf + done, rest);
+
+    /* Enlarge the buffer if it is occupied by a single line. */
+    if (rest >= size - 1) {
+      if (CUTSKY_MAX_CHUNK / 2 < size) {
+        P_ERR("line of ASCII file exceeding %d bytes\n", CUTSKY_MAX_CHUNK);
+        free(buf); free(pos); close(fd);
+        return CUTSKY_ERR_FILE;
+      }
+      size *= 2;
+      char *tmp = realloc(buf, size * sizeof(char));
+      if (!tmp) {
+        P_ERR("failed to allocate memory for counting records\n");
+        free(buf); free(pos); close(fd);
+        return CUTSKY_ERR_MEMORY;
+      }
+      buf = tmp;
+    }
+  }
+
+  free(buf);
+  free(pos);
+  if (close(fd)) P_WRN("failed to close file: `%s'\n", fname);
+  *num = nrec;
+  return 0;
+}
+
+/******************************************************************************
+Function `input_newrange`:
+  Open a byte range of a file for reading, with `pread` or memory mapping,
+  so that different ranges can be read independently in parallel.
+Arguments:
+  * `ifile`:    interface for file reading;
+  * `fname`:    name of the file to be read from;
+  * `start`:    offset of the first byte of the range;
+  * `end`:      offset of the byte right after the range;
+  * `use_mmap`: true for reading with memory mapping.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+int input_newrange(IFILE *ifile, const char *fname, const size_t start,
+    const size_t end, const bool use_mmap) {
+  int ecode;
+  if (use_mmap) {
+    if ((ecode = input_newfile_mmap(ifile, fname))) return ecode;
+  }
+  else {
+    if (!ifile) {
+      P_ERR("the interface for file reading is not initialized\n");
+      return CUTSKY_ERR_ARG;
+    }
+    if (!fname || !(*fname)) {
+      P_ERR("invalid input file name\n");
+      return CUTSKY_ERR_ARG;
+    }
+
+    /* Close the previous file. */
+    if (ifile->fp && fclose(ifile->fp))
+      P_WRN("failed to close file: `%s'\n", ifile->fname);
+    ifile->fp = NULL;
+    fd_release(ifile);
+
+    if ((ifile->fd = open(fname, O_RDONLY)) == -1) {
+      P_ERR("failed to open file for reading: `%s'\n", fname);
+      return CUTSKY_ERR_FILE;
+    }
+    struct stat st;
+    if (fstat(ifile->fd, &st)) {
+      P_ERR("failed to get the status of file: `%s'\n", fname);
+      return CUTSKY_ERR_FILE;
+    }
+    ifile->fname = fname;
+    ifile->fsize = st.st_size;
+  }
+
+  if (start > end || end > ifile->fsize) {
+    P_ERR("invalid byte range of file: `%s'\n", fname);
+    return CUTSKY_ERR_ARG;
+  }
+  ifile->fpos = start;
+  ifile->fsize = end;
+  ifile->line = NULL;
+  ifile->used = ifile->rest = ifile->nline = 0;
+  if (use_mmap) return 0;
+
+  /* Initialise the first chunk. */
+  ifile->rest = read_bytes(ifile, ifile->chunk, ifile->size);
+  /* Append '\n' to the last line. */
+  if (ifile->rest < ifile->size) ifile->chunk[ifile->rest] = '\n';
+  return 0;
+}
+
 /******************************************************************************
 Function `input_readline`:
   Read a record (line) from the input file.
@@ -171,6 +650,10 @@ int input_readline(IFILE *ifile) {
     P_ERR("the interface for file reading is not initialized\n");
     return CUTSKY_ERR_ARG;
   }
+  if (ifile->mapped) {
+    P_ERR("reading single lines from memory mapped files is not supported\n");
+    return CUTSKY_ERR_ARG;
+  }
 
   char *begin = ifile->chunk + ifile->used;
   char *end;
@@ -178,7 +661,7 @@ int input_readline(IFILE *ifile) {
   /* Read the file if no line is found. */
   while (!(end = memchr(begin, '\n', ifile->rest))) {
     if (ifile->used + ifile->rest < ifile->size) {      /* end-of-file */
-      if (!feof(ifile->fp)) {
+      if (!read_eof(ifile)) {
         P_ERR("unexpected end of file: `%s'\n", ifile->fname);
         return CUTSKY_ERR_FILE;
       }
@@ -233,38 +716,39 @@ int input_readlines(IFILE *ifile, const size_t nline) {
     ifile->lines = tmp;
   }
 
-  char *begin = ifile->chunk + ifile->used;
-  char *end;
+  if (ifile->mapped) return mmap_readlines(ifile, nline);
+
   size_t processed = 0;
 
   /* Read `nline` lines. */
-  for (ifile->nline = 0; ifile->nline < nline; ifile->nline++) {
-    /* Read the file if no line is found. */
-    while (!(end = memchr(begin, '\n', ifile->rest - processed))) {
-      if (ifile->used + ifile->rest < ifile->size) {    /* end-of-file */
-        if (!feof(ifile->fp)) {
-          P_ERR("unexpected end of file: `%s'\n", ifile->fname);
-          return CUTSKY_ERR_FILE;
-        }
-        /* Process the remaining lines. */
-        for (size_t i = 0; i < ifile->nline; i++)
-          ifile->lines[i] += ifile->used;
-        ifile->used += processed;
-        ifile->rest -= processed;
-        return 0;
-      }
-
-      int ecode;
-      if ((ecode = readchunk_ascii(ifile))) return ecode;
-      begin = ifile->chunk + ifile->used + processed;
+  for (ifile->nline = 0; ; ) {
+    /* Locate line breaks in the unprocessed bytes at once. */
+    char *begin = ifile->chunk + ifile->used;
+    const size_t base = processed;
+    size_t *pos = ifile->lines + ifile->nline;
+    const size_t n = scan_newlines(begin + base, ifile->rest - base, pos,
+        nline - ifile->nline);
+
+    /* Convert positions of line breaks to starting points of lines. */
+    for (size_t i = 0; i < n; i++) {
+      const size_t end = base + pos[i];
+      begin[end] = '\0';        /* replace '\n' by string terminator '\0' */
+      pos[i] = processed;
+      processed = end + 1;
     }
+    if ((ifile->nline += n) == nline) break;
 
-    *end = '\0';        /* replace '\n' by string terminator '\0' */
+    /* Read the file if not enough lines are found. */
+    if (ifile->used + ifile->rest < ifile->size) {      /* end-of-file */
+      if (!read_eof(ifile)) {
+        P_ERR("unexpected end of file: `%s'\n", ifile->fname);
+        return CUTSKY_ERR_FILE;
+      }
+      break;
+    }
 
-    ifile->lines[ifile->nline] = processed;
-    const size_t len = end + 1 - begin;
-    begin += len;
-    processed += len;
+    int ecode;
+    if ((ecode = readchunk_ascii(ifile))) return ecode;
   }
 
   for (size_t i = 0; i < ifile->nline; i++) ifile->lines[i] += ifile->used;
@@ -272,3 +756,80 @@ int input_readlines(IFILE *ifile, const size_t nline) {
   ifile->rest -= processed;
   return 0;
 }
+
+/******************************************************************************
+Function `input_transfer`:
+  Hand the file stream and unprocessed bytes over to another interface, and
+  fill its buffer, without modifying lines already read by the source. This
+  enables double buffering, with lines in the source being processed while
+  the destination is being read.
+Arguments:
+  * `dst`:      interface to take over the file stream;
+  * `src`:      interface with the currently opened file.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+int input_transfer(IFILE *dst, IFILE *src) {
+  if (!dst || !src) {
+    P_ERR("the interface for file reading is not initialized\n");
+    return CUTSKY_ERR_ARG;
+  }
+
+  /* Close the previous file of the destination if needed. */
+  if (dst->fp && fclose(dst->fp))
+    P_WRN("failed to close file: `%s'\n", dst->fname);
+  dst->fp = NULL;
+
+  /* Memory mapped files: lines are located by the destination itself. */
+  if (src->mapped) {
+    if (src->fd == -1) {
+      P_ERR("no file is opened for reading\n");
+      return CUTSKY_ERR_ARG;
+    }
+    fd_close(dst);
+    if (!dst->mapped) {
+      dst->buf = dst->chunk;
+      dst->chunk = NULL;
+      dst->mapped = true;
+    }
+    dst->fname = src->fname;
+    dst->fd = src->fd;
+    dst->fsize = src->fsize;
+    dst->fpos = src->fpos;
+    dst->line = NULL;
+    dst->used = dst->rest = dst->nline = 0;
+    src->fd = -1;
+    return 0;
+  }
+
+  if (!src->fp) {
+    P_ERR("no file is opened for reading\n");
+    return CUTSKY_ERR_ARG;
+  }
+
+  fd_release(dst);
+
+  /* Enlarge the buffer if needed. */
+  if (dst->size < src->size) {
+    char *tmp = realloc(dst->chunk, src->size * sizeof(char));
+    if (!tmp) {
+      P_ERR("failed to allocate memory for reading file by chunk\n");
+      return CUTSKY_ERR_MEMORY;
+    }
+    dst->chunk = tmp;
+    dst->size = src->size;
+  }
+
+  /* Copy unprocessed bytes, and leave the processed ones untouched. */
+  memcpy(dst->chunk, src->chunk + src->used, src->rest);
+  dst->fname = src->fname;
+  dst->fp = src->fp;
+  dst->line = NULL;
+  dst->used = 0;
+  dst->rest = src->rest;
+  dst->nline = 0;
+  src->fp = NULL;
+  src->rest = 0;
+
+  return readchunk_ascii(dst);
+}
@@ -32,6 +32,7 @@
 #define __READ_FILE_H__
 
 #include <stdio.h>
+#include <stdbool.h>
 
 #ifdef WITH_CFITSIO
 #include <fitsio.h>
@@ -52,6 +53,14 @@ typedef struct {
   size_t size;          /* capacity of the buffer                        */
   size_t nline;         /* number of lines in the chunk                  */
   size_t maxline;       /* capacity of the array storing lines           */
+  bool mapped;          /* true if the file is memory mapped             */
+  int fd;               /* descriptor of the file if there is no stream  */
+  char *buf;            /* buffer for reading if the file is mapped      */
+  char *map;            /* memory mapped window of the file              */
+  size_t moff;          /* offset of the mapped window in the file       */
+  size_t mlen;          /* length of the mapped window                   */
+  size_t fsize;         /* end of the file or the byte range to be read  */
+  size_t fpos;          /* offset of the first unprocessed byte          */
 } IFILE;
 
 #ifdef WITH_CFITSIO
@@ -102,6 +111,65 @@ Return:
 ******************************************************************************/
 int input_newfile(IFILE *ifile, const char *fname);
 
+/******************************************************************************
+Function `input_newfile_mmap`:
+  Open a new file for reading through memory mapping. Lines are then passed
+  without copying, and are terminated by '\n' rather than '\0', except for
+  the last line if it is not ending with '\n'. Only `input_readlines` is
+  supported for memory mapped files.
+Arguments:
+  * `ifile`:    interface for file reading;
+  * `fname`:    name of the file to be read from.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+int input_newfile_mmap(IFILE *ifile, const char *fname);
+
+/******************************************************************************
+Function `input_ranges`:
+  Split a file into byte ranges with boundaries aligned to line breaks.
+Arguments:
+  * `fname`:    name of the file to be split;
+  * `nrange`:   number of byte ranges;
+  * `offset`:   offsets of range boundaries, with length `nrange` + 1.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+int input_ranges(const char *fname, const int nrange, size_t *offset);
+
+/******************************************************************************
+Function `input_count_records`:
+  Count records in a byte range of an ASCII file, i.e., lines that are neither
+  empty nor comments, by scanning line breaks without parsing the lines.
+Arguments:
+  * `fname`:    name of the file to be scanned;
+  * `start`:    offset of the first byte of the range;
+  * `end`:      offset of the byte right after the range, SIZE_MAX for the
+                end of the file;
+  * `comment`:  the comment symbol, '\0' for disabling comments;
+  * `num`:      number of records in the range.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+int input_count_records(const char *fname, const size_t start,
+    const size_t end, const char comment, size_t *num);
+
+/******************************************************************************
+Function `input_newrange`:
+  Open a byte range of a file for reading, with `pread` or memory mapping,
+  so that different ranges can be read independently in parallel.
+Arguments:
+  * `ifile`:    interface for file reading;
+  * `fname`:    name of the file to be read from;
+  * `start`:    offset of the first byte of the range;
+  * `end`:      offset of the byte right after the range;
+  * `use_mmap`: true for reading with memory mapping.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+int input_newrange(IFILE *ifile, const char *fname, const size_t start,
+    const size_t end, const bool use_mmap);
+
 /******************************************************************************
 Function `input_readline`:
   Read a record (line) from the input file.
@@ -123,6 +191,74 @@ Return:
 ******************************************************************************/
 int input_readlines(IFILE *ifile, const size_t nline);
 
+/******************************************************************************
+Function `input_transfer`:
+  Hand the file stream and unprocessed bytes over to another interface, and
+  fill its buffer, without modifying lines already read by the source.
+Arguments:
+  * `dst`:      interface to take over the file stream;
+  * `src`:      interface with the currently opened file.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+int input_transfer(IFILE *dst, IFILE *src);
+
+
+/*============================================================================*\
+                      Interfaces for scanning line breaks
+\*============================================================================*/
+
+/******************************************************************************
+Function `scan_newlines`:
+  Locate line breaks in a buffer, with the fastest available instructions.
+Arguments:
+  * `buf`:      the buffer to be scanned;
+  * `len`:      length of the buffer;
+  * `pos`:      array for positions of line breaks, relative to `buf`;
+  * `max`:      maximum number of line breaks to be located.
+Return:
+  Number of located line breaks.
+******************************************************************************/
+size_t scan_newlines(const char *buf, const size_t len, size_t *pos,
+    const size_t max);
+
+/******************************************************************************
+Function `scan_records`:
+  Count records in a buffer, i.e., lines that are neither empty nor comments.
+  The buffer is supposed to start at the beginning of a line.
+Arguments:
+  * `buf`:      the buffer to be scanned;
+  * `len`:      length of the buffer;
+  * `comment`:  the comment symbol, '\0' for disabling comments;
+  * `pos`:      workspace for positions of line breaks;
+  * `max`:      capacity of the workspace;
+  * `done`:     number of bytes of the complete lines being scanned.
+Return:
+  Number of records in the complete lines.
+******************************************************************************/
+size_t scan_records(const char *buf, const size_t len, const char comment,
+    size_t *pos, const size_t max, size_t *done);
+
+/*============================================================================*\
+                     Interface for parsing ASCII records
+\*============================================================================*/
+
+/******************************************************************************
+Function `parse_dbl_fields`:
+  Parse whitespace-separated floating-point numbers from a string, and save
+  them to separate arrays, in the same way as `sscanf` with "%lf %lf ...".
+  The string is terminated by either '\0' or '\n'.
+Arguments:
+  * `line`:     the string to be parsed;
+  * `nfield`:   number of fields to be parsed;
+  * `out`:      arrays for the parsed numbers, one for each field;
+  * `idx`:      index of the parsed numbers in the arrays.
+Return:
+  Number of successfully parsed fields.
+******************************************************************************/
+int parse_dbl_fields(const char *line, const int nfield, double *const *out,
+    const size_t idx);
+
 
 #ifdef WITH_CFITSIO
 
@@ -158,6 +294,18 @@ Return:
 ******************************************************************************/
 int ifits_newfiles(IFFILE *ifile, const char **fnames, const int ninput);
 
+/******************************************************************************
+Function `ifits_count_rows`:
+  Count the total number of rows in a set of FITS files, from the headers.
+Arguments:
+  * `fnames`:   names of the files;
+  * `ninput`:   number of files;
+  * `num`:      total number of rows.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+int ifits_count_rows(const char **fnames, const int ninput, size_t *num);
+
 /******************************************************************************
 Function `ifits_readlines`:
   Read multiple records (lines) from the input file.
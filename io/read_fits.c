@@ -223,6 +223,41 @@ int ifits_newfiles(IFFILE *ifile, const char **fnames, const int ninput) {
   return 0;
 }
 
+/******************************************************************************
+Function `ifits_count_rows`:
+  Count the total number of rows in a set of FITS files, from the headers.
+Arguments:
+  * `fnames`:   names of the files;
+  * `ninput`:   number of files;
+  * `num`:      total number of rows.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+int ifits_count_rows(const char **fnames, const int ninput, size_t *num) {
+  if (!fnames || ninput <= 0 || !num) {
+    P_ERR("invalid arguments for counting rows of the input files\n");
+    return CUTSKY_ERR_ARG;
+  }
+
+  size_t ntotal = 0;
+  for (int i = 0; i < ninput; i++) {
+    fitsfile *fp = NULL;
+    int status = 0;
+    long nrow = 0;
+    if (fits_open_data(&fp, fnames[i], READONLY, &status)) FITS_ABORT;
+    if (fits_get_num_rows(fp, &nrow, &status)) FITS_ABORT;
+    if (fits_close_file(fp, &status)) {
+      P_WRN("failed to close file: ");
+      fits_report_error(stderr, status);
+      fits_clear_errmsg();
+    }
+    ntotal += nrow;
+  }
+
+  *num = ntotal;
+  return 0;
+}
+
 /******************************************************************************
 Function `ifits_readlines`:
   Read multiple records (lines) from the input file.
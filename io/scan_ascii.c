@@ -0,0 +1,180 @@
+/*******************************************************************************
+* scan_ascii.c: this file is part of the cutsky program.
+
+* cutsky: cutsky catalogue generator.
+
+* Github repository:
+        https://github.com/cheng-zhao/cutsky
+
+* Copyright (c) 2023-2025 Cheng Zhao <zhaocheng03@gmail.com> [MIT license]
+
+*******************************************************************************/
+
+#include "read_file.h"
+#include <string.h>
+
+/*============================================================================*\
+                   Definitions for the vectorised line scanner
+\*============================================================================*/
+
+/* x86 SIMD kernels are enabled with function attributes and chosen at
+   runtime, so the code runs on any CPU regardless of compiler flags. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    !defined(CUTSKY_NO_SIMD)
+  #define SCAN_X86
+  #include <immintrin.h>
+#endif
+
+
+/*============================================================================*\
+                      Functions for scanning line breaks
+\*============================================================================*/
+
+/******************************************************************************
+Function `scan_newlines_scalar`:
+  Locate line breaks with `memchr`, which is the fallback implementation.
+Arguments:
+  * `buf`:      the buffer to be scanned;
+  * `len`:      length of the buffer;
+  * `pos`:      array for positions of line breaks;
+  * `max`:      maximum number of line breaks to be located.
+Return:
+  Number of located line breaks.
+******************************************************************************/
+static size_t scan_newlines_scalar(const char *buf, const size_t len,
+    size_t *pos, const size_t max) {
+  const char *p = buf;
+  const char *end = buf + len;
+  const char *nl;
+  size_t n = 0;
+  while (n < max && (nl = memchr(p, '\n', end - p))) {
+    pos[n++] = nl - buf;
+    p = nl + 1;
+  }
+  return n;
+}
+
+#ifdef SCAN_X86
+/******************************************************************************
+Function `scan_newlines_sse2`:
+  Locate line breaks with SSE2 instructions, 16 bytes at a time.
+Arguments:
+  * `buf`:      the buffer to be scanned;
+  * `len`:      length of the buffer;
+  * `pos`:      array for positions of line breaks;
+  * `max`:      maximum number of line breaks to be located;
+  * `done`:     number of bytes scanned.
+Return:
+  Number of located line breaks.
+******************************************************************************/
+__attribute__((target("sse2")))
+static size_t scan_newlines_sse2(const char *buf, const size_t len,
+    size_t *pos, const size_t max, size_t *done) {
+  const __m128i nl = _mm_set1_epi8('\n');
+  size_t i = 0, n = 0;
+  for (; i + 16 <= len && n < max; i += 16) {
+    const __m128i v = _mm_loadu_si128((const __m128i *) (buf + i));
+    unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+    for (; mask && n < max; mask &= mask - 1)
+      pos[n++] = i + __builtin_ctz(mask);
+  }
+  *done = i;
+  return n;
+}
+
+/******************************************************************************
+Function `scan_newlines_avx2`:
+  Locate line breaks with AVX2 instructions, 32 bytes at a time.
+Arguments:
+  * `buf`:      the buffer to be scanned;
+  * `len`:      length of the buffer;
+  * `pos`:      array for positions of line breaks;
+  * `max`:      maximum number of line breaks to be located;
+  * `done`:     number of bytes scanned.
+Return:
+  Number of located line breaks.
+******************************************************************************/
+__attribute__((target("avx2")))
+static size_t scan_newlines_avx2(const char *buf, const size_t len,
+    size_t *pos, const size_t max, size_t *done) {
+  const __m256i nl = _mm256_set1_epi8('\n');
+  size_t i = 0, n = 0;
+  for (; i + 32 <= len && n < max; i += 32) {
+    const __m256i v = _mm256_loadu_si256((const __m256i *) (buf + i));
+    unsigned int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl));
+    for (; mask && n < max; mask &= mask - 1)
+      pos[n++] = i + __builtin_ctz(mask);
+  }
+  *done = i;
+  return n;
+}
+#endif
+
+/*============================================================================*\
+                       Interfaces for scanning line breaks
+\*============================================================================*/
+
+/******************************************************************************
+Function `scan_newlines`:
+  Locate line breaks in a buffer, with the fastest available instructions.
+Arguments:
+  * `buf`:      the buffer to be scanned;
+  * `len`:      length of the buffer;
+  * `pos`:      array for positions of line breaks, relative to `buf`;
+  * `max`:      maximum number of line breaks to be located.
+Return:
+  Number of located line breaks.
+******************************************************************************/
+size_t scan_newlines(const char *buf, const size_t len, size_t *pos,
+    const size_t max) {
+  size_t n = 0, i = 0;
+#ifdef SCAN_X86
+  if (__builtin_cpu_supports("avx2"))
+    n = scan_newlines_avx2(buf, len, pos, max, &i);
+  else if (__builtin_cpu_supports("sse2"))
+    n = scan_newlines_sse2(buf, len, pos, max, &i);
+#endif
+  /* Process the remaining bytes. */
+  if (n < max && i < len) {
+    const size_t nrest = scan_newlines_scalar(buf + i, len - i, pos + n,
+        max - n);
+    for (size_t j = n; j < n + nrest; j++) pos[j] += i;
+    n += nrest;
+  }
+  return n;
+}
+
+/******************************************************************************
+Function `scan_records`:
+  Count records in a buffer, i.e., lines that are neither empty nor comments.
+  The buffer is supposed to start at the beginning of a line.
+Arguments:
+  * `buf`:      the buffer to be scanned;
+  * `len`:      length of the buffer;
+  * `comment`:  the comment symbol, '\0' for disabling comments;
+  * `pos`:      workspace for positions of line breaks;
+  * `max`:      capacity of the workspace;
+  * `done`:     number of bytes of the complete lines being scanned.
+Return:
+  Number of records in the complete lines.
+******************************************************************************/
+size_t scan_records(const char *buf, const size_t len, const char comment,
+    size_t *pos, const size_t max, size_t *done) {
+  size_t start = 0, nrec = 0, nnl;
+  do {
+    const size_t base = start;
+    nnl = scan_newlines(buf + base, len - base, pos, max);
+    for (size_t j = 0; j < nnl; j++) {
+      const size_t end = base + pos[j];
+      /* Omit leading whitespaces. */
+      size_t k = start;
+      while (k < end && (buf[k] == ' ' || (buf[k] >= '\t' && buf[k] <= '\r')))
+        k++;
+      if (k < end && buf[k] != comment) nrec++;
+      start = end + 1;
+    }
+  }
+  while (nnl == max);
+  *done = start;
+  return nrec;
+}
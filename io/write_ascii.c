@@ -127,6 +127,35 @@ int output_newfile(OFILE *ofile, const char *fname) {
   return 0;
 }
 
+/******************************************************************************
+Function `output_newtmp`:
+  Flush the buffer to the existing file and open a new temporary file, which
+  is removed automatically when it is closed.
+Arguments:
+  * `ofile`:    structure for writing ASCII files.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+int output_newtmp(OFILE *ofile) {
+  if (!ofile) {
+    P_ERR("the interface for file writing is not initialised\n");
+    return CUTSKY_ERR_ARG;
+  }
+  if (output_flush(ofile)) {
+    P_ERR("failed to flush the buffer to the opened file: `%s'\n",
+        ofile->fname);
+    return CUTSKY_ERR_FILE;
+  }
+  if (ofile->fp && fclose(ofile->fp))
+    P_WRN("failed to close file: `%s'\n", ofile->fname);
+  ofile->fname = "<temporary file>";
+  if (!(ofile->fp = tmpfile())) {
+    P_ERR("failed to open a temporary file for writing\n");
+    return CUTSKY_ERR_FILE;
+  }
+  return 0;
+}
+
 /******************************************************************************
 Function `output_writeline`:
   Write a line to the buffer and save it to the file if necessary.
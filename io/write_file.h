@@ -87,6 +87,17 @@ Return:
 ******************************************************************************/
 int output_newfile(OFILE *ofile, const char *fname);
 
+/******************************************************************************
+Function `output_newtmp`:
+  Flush the buffer to the existing file and open a new temporary file, which
+  is removed automatically when it is closed.
+Arguments:
+  * `ofile`:    structure for writing ASCII files.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+int output_newtmp(OFILE *ofile);
+
 /******************************************************************************
 Function `output_destroy`:
   Deconstruct the interface for writing ASCII files.
@@ -18,6 +18,11 @@
 #include <ctype.h>
 #include <limits.h>
 #include <math.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 /*******************************************************************************
   A simplified implementation of the `polyid` command of mangle:
@@ -34,6 +39,21 @@
 #define MANGLE_CHUNK_INIT_SIZE  1048576
 #define MANGLE_CHUNK_MAX_SIZE   INT_MAX
 #define MANGLE_MAX_RES          15      /* for pixel id < INT_MAX */
+#define MANGLE_IDX_RES          8       /* minimum resolution of the index */
+#define MANGLE_PIX_TOL          1e-10   /* tolerance for pixel boundaries  */
+#define MANGLE_IDX_INIT_PAIR    1024    /* initial number of index entries */
+#define MANGLE_CAP_INIT_NUM     1024    /* initial number of caps in arena */
+
+/* Status of pixels in the index, for those not fully inside a polygon. */
+#define MANGLE_PIX_OUT          (-1)
+#define MANGLE_PIX_EDGE         (-2)
+
+/* Settings of the binary cache. */
+#define MANGLE_CACHE_MAGIC      "MNGLCACH"      /* 8 bytes file signature */
+#define MANGLE_CACHE_VERSION    1
+#define MANGLE_CACHE_ALIGN      64      /* alignment of data sections     */
+#define MANGLE_CACHE_NSEC       8       /* number of data sections        */
+#define MANGLE_CACHE_TMP_LEN    32      /* extra length for the temp file */
 
 #define TWOPI                   0x1.921fb54442d18p+2    /* 2 * PI */
 #define DEG2RAD                 0x1.1df46a2529d39p-6    /* PI / 180 */
@@ -56,6 +76,35 @@
 #define MANGLE_ERR_NOPOLY       (-12)
 
 
+/*============================================================================*\
+                     Data structure for creating the index
+\*============================================================================*/
+
+/* Header of the binary cache, followed by sections of the mask data:
+   poly, nx, ny, nz, thres, pmap, pix, and plist. */
+typedef struct {
+  char magic[8];        /* file signature                        */
+  uint32_t version;     /* version of the cache format           */
+  uint32_t size_poly;   /* size of the polygon structure         */
+  int64_t src_size;     /* size of the polygon-format file       */
+  int64_t src_mtime;    /* modification time of the polygon file */
+  double wmin;          /* minimum weight of polygons            */
+  int32_t npoly;        /* number of polygons                    */
+  int32_t res;          /* resolution for the pixelization       */
+  int32_t ires;         /* resolution of the internal index      */
+  int32_t unused;       /* padding                               */
+  uint64_t ncap;        /* number of caps                        */
+  uint64_t nlist;       /* number of polygons in boundary lists  */
+} MANGLE_CACHE_HEAD;
+
+/* A pixel in the index and a polygon that is not outside the pixel. */
+typedef struct {
+  int pix;              /* index of the pixel    */
+  int poly;             /* index of the polygon  */
+  int cls;              /* classification result */
+} MANGLE_PAIR;
+
+
 /*============================================================================*\
                         Definitions for sorting polygons
 \*============================================================================*/
@@ -130,12 +179,13 @@ Arguments:
   * `wmin`:     minimum weight of polygons to be kept;
   * `num`:      number of valid polygons read from file;
   * `reso`:     resolution of pixelization read from file;
+  * `caps`:     address of the array for caps of all valid polygons;
   * `err`:      an integer for indicating error messages.
 Return:
   Address of the array for valid polygons.
 ******************************************************************************/
 static POLYGON *mangle_read(const char *fname, const double wmin, int *num,
-    int *reso, int *err) {
+    int *reso, POLYCAP **caps, int *err) {
   /* Allocate memory for reading the file by chunks. */
   size_t csize = MANGLE_CHUNK_INIT_SIZE;
   char *chunk = malloc(csize * sizeof(char));
@@ -223,7 +273,9 @@ static POLYGON *mangle_read(const char *fname, const double wmin, int *num,
     free(chunk); fclose(fp);
     return NULL;
   }
-  for (int i = 0; i < npoly; i++) poly[i].cap = NULL;
+  POLYCAP *arena = NULL;        /* caps of all polygons */
+  size_t ncap, max_cap;
+  ncap = max_cap = 0;
 
   /* Minimum and maximum pixel id with the given resolution. */
   const int pmin = ((1 << (res << 1)) - 1) / 3;         /* (4^n - 1) / 3 */
@@ -273,9 +325,19 @@ static POLYGON *mangle_read(const char *fname, const double wmin, int *num,
             p = endl + 1;
             continue;
           }
-          /* Allocate memory for caps. */
-          if (!(ply->cap = malloc(ply->ncap * sizeof(POLYCAP))))
-            *err = MANGLE_ERR_MEMORY;
+          /* Enlarge the arena for caps if necessary. */
+          if (ncap + ply->ncap > max_cap) {
+            size_t max = (max_cap) ? max_cap << 1 : MANGLE_CAP_INIT_NUM;
+            if (max < ncap + ply->ncap) max = ncap + ply->ncap;
+            POLYCAP *tmp = realloc(arena, max * sizeof(POLYCAP));
+            if (!tmp) *err = MANGLE_ERR_MEMORY;
+            else {
+              arena = tmp;
+              max_cap = max;
+            }
+          }
+          ply->icap = ncap;
+          ncap += ply->ncap;
           icap++;
           ipoly++;
         }
@@ -290,7 +352,7 @@ static POLYGON *mangle_read(const char *fname, const double wmin, int *num,
           if (icap++ >= skip_ncap) icap = 0;
         }
         else {
-          memcpy(poly[ipoly - 1].cap + icap - 1, cap, sizeof(POLYCAP));
+          memcpy(arena + poly[ipoly - 1].icap + icap - 1, cap, sizeof(POLYCAP));
           if (icap++ >= poly[ipoly - 1].ncap) icap = 0;
         }
       }
@@ -298,7 +360,7 @@ static POLYGON *mangle_read(const char *fname, const double wmin, int *num,
       /* Check errors. */
       if (*err) {
         free(chunk); fclose(fp);
-        for (int i = 0; i < ipoly; i++) if (poly[i].cap) free(poly[i].cap);
+        if (arena) free(arena);
         free(poly);
         return NULL;
       }
@@ -311,7 +373,7 @@ static POLYGON *mangle_read(const char *fname, const double wmin, int *num,
       *err = chunk_resize(&chunk, &csize);
       if (*err) {
         free(chunk); fclose(fp);
-        for (int i = 0; i < ipoly; i++) if (poly[i].cap) free(poly[i].cap);
+        if (arena) free(arena);
         free(poly);
         return NULL;
       }
@@ -330,7 +392,7 @@ static POLYGON *mangle_read(const char *fname, const double wmin, int *num,
   if (iread != npoly) *err = MANGLE_ERR_NPOLY_LESS;
   else if (!ipoly) *err = MANGLE_ERR_NOPOLY;
   if (*err) {
-    for (int i = 0; i < ipoly; i++) if (poly[i].cap) free(poly[i].cap);
+    if (arena) free(arena);
     free(poly);
     return NULL;
   }
@@ -342,85 +404,384 @@ static POLYGON *mangle_read(const char *fname, const double wmin, int *num,
 
   *num = ipoly;
   *reso = res;
+  *caps = arena;
   return poly;
 }
 
 /******************************************************************************
-Function `mangle_pix_idx`:
-  Create indices for the polygon pixels.
+Function `mangle_cap_arena`:
+  Sort polygons by pixel, and repack their caps into contiguous arrays in the
+  same order, with negative caps converted to positive ones, so that a point
+  is inside a cap if the dot product with the axis exceeds the threshold.
 Arguments:
-  * `poly`:     pointer to the array for polygons;
-  * `npoly`:    number of polygons in the array;
-  * `res`:      resolution of the pixelization;
-  * `err`:      an integer for indicating error messages.
+  * `mask`:     address of the structure for the mask;
+  * `caps`:     caps of all polygons, in the order of reading.
 Return:
-  Address of the array for pixel ID indices.
+  Zero on success; non-zero on error.
 ******************************************************************************/
-static int *mangle_pix_idx(POLYGON *poly, const int npoly, const int res,
-    int *err) {
-  /* Compute the number of pixels given the resolution, and allocate memory. */
-  const int npix = 1 << (res << 1);
-  const int pmin = (npix - 1) / 3;      /* minimum pixel ID */
-  int *pix = calloc(npix + 1, sizeof(int));
-  if (!pix) {
-    *err = MANGLE_ERR_MEMORY;
-    return NULL;
-  }
-
+static int mangle_cap_arena(MANGLE *mask, const POLYCAP *caps) {
   /* Sort polygons based on the pixel IDs. */
   POLYGON tmp;
-  tim_sort(poly, &tmp, npoly);
-
-  /* Record indices. */
-  int prev = -1;
-  for (int i = 0; i < npoly; i++) {
-    int j = poly[i].pixel - pmin;
-    if (j != prev) {
-      for (int k = prev + 1; k <= j; k++) pix[k] = i;
-      prev = j;
+  tim_sort(mask->poly, &tmp, mask->npoly);
+
+  size_t ncap = 0;
+  for (int i = 0; i < mask->npoly; i++) ncap += mask->poly[i].ncap;
+  if (!(mask->nx = malloc(ncap * sizeof(double))) ||
+      !(mask->ny = malloc(ncap * sizeof(double))) ||
+      !(mask->nz = malloc(ncap * sizeof(double))) ||
+      !(mask->thres = malloc(ncap * sizeof(double))))
+    return MANGLE_ERR_MEMORY;
+
+  /* The cap (x,y,z,cm) with cm < 0 is equivalent to (-x,-y,-z,2+cm),
+     but the threshold -(1+cm) is exact. */
+  size_t n = 0;
+  for (int i = 0; i < mask->npoly; i++) {
+    const POLYCAP *c = caps + mask->poly[i].icap;
+    mask->poly[i].icap = n;
+    for (int j = 0; j < mask->poly[i].ncap; j++) {
+      if (c[j][3] >= 0) {
+        mask->nx[n] = c[j][0];
+        mask->ny[n] = c[j][1];
+        mask->nz[n] = c[j][2];
+        mask->thres[n] = 1 - c[j][3];
+      }
+      else {
+        mask->nx[n] = -c[j][0];
+        mask->ny[n] = -c[j][1];
+        mask->nz[n] = -c[j][2];
+        mask->thres[n] = -(1 + c[j][3]);
+      }
+      n++;
     }
   }
-  pix[npix] = npoly;
-
-  return pix;
+  return 0;
 }
 
 
 /*============================================================================*\
-                          Functions for polygon query
+                    Functions for classifying polygon pixels
 \*============================================================================*/
 
 /******************************************************************************
-Function `mangle_inside_cap`:
-  Check if the endpoint of a unit vector is inside a cap.
+Function `mangle_pix_bound`:
+  Compute the boundaries of a pixel in the `simple` pixelization scheme,
+  extended slightly for rounding errors.
 Arguments:
-  * `cap`:      pointer to the cap to be checked;
-  * `v`:        the unit vector to be checked.
+  * `res`:      resolution for the pixelization;
+  * `idx`:      index of the pixel (starting from 0);
+  * `bound`:    ranges of the azimuth angle (in radians) and the sine of the
+                elevation angle: (az_min, az_max, sin_el_min, sin_el_max).
+******************************************************************************/
+static void mangle_pix_bound(const int res, const int idx, double *bound) {
+  const int nside = 1 << res;
+  const int n = idx >> res;
+  const int m = idx & (nside - 1);
+  bound[0] = TWOPI * m / nside - MANGLE_PIX_TOL;
+  bound[1] = TWOPI * (m + 1) / nside + MANGLE_PIX_TOL;
+  bound[2] = 1 - 2.0 * (n + 1) / nside - MANGLE_PIX_TOL;
+  bound[3] = 1 - 2.0 * n / nside + MANGLE_PIX_TOL;
+  if (bound[2] < -1) bound[2] = -1;
+  if (bound[3] > 1) bound[3] = 1;
+}
+
+/******************************************************************************
+Function `mangle_cap_pix`:
+  Classify a cap with respect to a pixel, by computing the range of the cosine
+  of the angle between the polar axis of the cap and points in the pixel.
+Arguments:
+  * `c`:        polar axis of the cap to be classified;
+  * `thres`:    threshold of the cap, i.e., the cosine of its angular radius;
+  * `bound`:    boundaries of the pixel.
+Return:
+  MANGLE_CLS_IN if the pixel is fully inside the cap; MANGLE_CLS_OUT if the
+  pixel is fully outside the cap; MANGLE_CLS_EDGE otherwise.
+******************************************************************************/
+static int mangle_cap_pix(const double *c, const double thres,
+    const double *bound) {
+  /* Range of the horizontal component of the dot product, per unit cosine of
+     the elevation angle: rho * cos(az - phi). */
+  double hmin, hmax;
+  hmin = hmax = 0;
+  const double rho = sqrt(c[0] * c[0] + c[1] * c[1]);
+  if (rho > 0) {
+    double d0 = fmod(bound[0] - atan2(c[1], c[0]), TWOPI);
+    if (d0 < 0) d0 += TWOPI;
+    const double d1 = d0 + bound[1] - bound[0];
+    const double c0 = cos(d0);
+    const double c1 = cos(d1);
+    hmax = (d1 >= TWOPI) ? 1 : ((c0 > c1) ? c0 : c1);
+    hmin = ((d0 <= TWOPI * 0.5 && d1 >= TWOPI * 0.5) || d1 >= TWOPI * 1.5) ?
+        -1 : ((c0 < c1) ? c0 : c1);
+    hmin *= rho;
+    hmax *= rho;
+  }
+
+  /* The dot product is c[2] * s + h * sqrt(1 - s^2), with s being the sine of
+     the elevation angle. The extrema are on the boundaries of s, or at the
+     stationary points, which are +/- sqrt(c[2]^2 + h^2). */
+  const double s0 = bound[2];
+  const double s1 = bound[3];
+  const double r0 = sqrt(1 - s0 * s0);
+  const double r1 = sqrt(1 - s1 * s1);
+  double max = c[2] * s0 + hmax * r0;
+  double tmp = c[2] * s1 + hmax * r1;
+  if (max < tmp) max = tmp;
+  if (hmax > 0) {
+    tmp = sqrt(c[2] * c[2] + hmax * hmax);
+    if (c[2] >= s0 * tmp && c[2] <= s1 * tmp) max = tmp;
+  }
+  double min = c[2] * s0 + hmin * r0;
+  tmp = c[2] * s1 + hmin * r1;
+  if (min > tmp) min = tmp;
+  if (hmin < 0) {
+    tmp = sqrt(c[2] * c[2] + hmin * hmin);
+    if (-c[2] >= s0 * tmp && -c[2] <= s1 * tmp) min = -tmp;
+  }
+
+  /* Compare with the threshold of the cap. */
+  if (min > thres + MANGLE_PIX_TOL) return MANGLE_CLS_IN;
+  if (max < thres - MANGLE_PIX_TOL) return MANGLE_CLS_OUT;
+  return MANGLE_CLS_EDGE;
+}
+
+/******************************************************************************
+Function `mangle_poly_pix`:
+  Classify a polygon with respect to a pixel.
+Arguments:
+  * `mask`:     address of the structure for the mask;
+  * `poly`:     pointer to the polygon to be classified;
+  * `bound`:    boundaries of the pixel.
 Return:
-  True if the endpoint is inside the cap.
+  MANGLE_CLS_IN if the pixel is fully inside the polygon; MANGLE_CLS_OUT if
+  the pixel is fully outside any cap of the polygon; MANGLE_CLS_EDGE otherwise.
 ******************************************************************************/
-static inline bool mangle_inside_cap(const POLYCAP *cap, const double *v) {
-  /* Cosine of the angle between the unit vector and the polar axis. */
-  double angle = (*cap)[0] * v[0] + (*cap)[1] * v[1] + (*cap)[2] * v[2];
-  if ((*cap)[3] >= 0) return angle > 1 - (*cap)[3];
-  else return angle < 1 + (*cap)[3];
+static int mangle_poly_pix(const MANGLE *mask, const POLYGON *poly,
+    const double *bound) {
+  int cls = MANGLE_CLS_IN;
+  for (size_t i = poly->icap; i < poly->icap + poly->ncap; i++) {
+    const double axis[3] = {mask->nx[i], mask->ny[i], mask->nz[i]};
+    int c = mangle_cap_pix(axis, mask->thres[i], bound);
+    if (c == MANGLE_CLS_OUT) return MANGLE_CLS_OUT;
+    if (c == MANGLE_CLS_EDGE) cls = MANGLE_CLS_EDGE;
+  }
+  return cls;
 }
 
+/******************************************************************************
+Function `mangle_poly_range`:
+  Compute the ranges of pixels that may overlap with a polygon, given the
+  bounding circle of the polygon, i.e., the smallest of its caps.
+Arguments:
+  * `mask`:     address of the structure for the mask;
+  * `poly`:     pointer to the polygon;
+  * `res`:      resolution of the pixelization;
+  * `range`:    ranges of the pixel indices along the elevation and azimuth
+                directions: (n_min, n_max, m_min, m_max), with m_max possibly
+                exceeding the number of pixels per side for wrapped ranges.
+******************************************************************************/
+static void mangle_poly_range(const MANGLE *mask, const POLYGON *poly,
+    const int res, int *range) {
+  const int nside = 1 << res;
+  range[0] = range[2] = 0;
+  range[1] = range[3] = nside - 1;
+
+  /* Find the smallest cap, i.e., the one with the largest threshold. */
+  double axis[3] = {0, 0, 0};
+  double thres = -1;
+  for (size_t i = poly->icap; i < poly->icap + poly->ncap; i++) {
+    if (mask->thres[i] > thres) {
+      axis[0] = mask->nx[i];
+      axis[1] = mask->ny[i];
+      axis[2] = mask->nz[i];
+      thres = mask->thres[i];
+    }
+  }
+  if (thres <= -1) return;              /* no constraint from caps */
+  /* A threshold above 1 is for an empty cap; take it as a single point. */
+  if (thres > 1) thres = 1;
+
+  /* Range of the elevation angle of the bounding circle. */
+  const double theta = acos(thres);
+  double norm = sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+  double sine = axis[2] / norm;
+  if (sine > 1) sine = 1;
+  else if (sine < -1) sine = -1;
+  const double el = asin(sine);
+  const double el0 = el - theta;
+  const double el1 = el + theta;
+  if (el1 < TWOPI * 0.25) {
+    range[0] = floor((1 - sin(el1)) * 0.5 * nside) - 1;
+    if (range[0] < 0) range[0] = 0;
+  }
+  if (el0 > -TWOPI * 0.25) {
+    range[1] = ceil((1 - sin(el0)) * 0.5 * nside);
+    if (range[1] > nside - 1) range[1] = nside - 1;
+  }
+
+  /* Range of the azimuth angle, if the circle does not cover a pole. */
+  if (el1 >= TWOPI * 0.25 || el0 <= -TWOPI * 0.25) return;
+  const double daz = asin(sin(theta) / cos(el));
+  double az = atan2(axis[1], axis[0]);
+  if (az < 0) az += TWOPI;
+  const int mmin = floor((az - daz) / TWOPI * nside) - 1;
+  const int mmax = floor((az + daz) / TWOPI * nside) + 1;
+  if (mmax - mmin + 1 >= nside) return;
+  range[2] = (mmin + nside) & (nside - 1);
+  range[3] = range[2] + mmax - mmin;
+}
+
+/******************************************************************************
+Function `mangle_pix_idx`:
+  Create the pixel index of polygons, with pixels classified as fully inside a
+  polygon, fully outside all polygons, or on the boundaries.
+  The index is built at a resolution no coarser than MANGLE_IDX_RES, so that
+  unpixelized or coarsely pixelized masks can be queried efficiently as well.
+Arguments:
+  * `mask`:     address of the structure for the mask.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int mangle_pix_idx(MANGLE *mask) {
+  const int res = mask->res;
+  const int pmin = ((1 << (res << 1)) - 1) / 3;         /* minimum pixel ID */
+  const int ires = (res < MANGLE_IDX_RES) ? MANGLE_IDX_RES : res;
+  const int dres = ires - res;
+  const int nside = 1 << ires;
+  const int nipix = 1 << (ires << 1);
+
+  /* Pairs of pixels in the index and polygons that are not outside them. */
+  size_t npair = 0;
+  size_t max = (mask->npoly < MANGLE_IDX_INIT_PAIR) ?
+      MANGLE_IDX_INIT_PAIR : mask->npoly;
+  MANGLE_PAIR *pair = malloc(max * sizeof(MANGLE_PAIR));
+  if (!pair) return MANGLE_ERR_MEMORY;
+
+  /* Classify polygons with respect to the pixels in their bounding circles,
+     restricted to the pixels in the file they are assigned to. */
+  for (int i = 0; i < mask->npoly; i++) {
+    const int fpix = mask->poly[i].pixel - pmin;
+    const int nf = fpix >> res;
+    const int mf = fpix & ((1 << res) - 1);
+    int range[4];
+    mangle_poly_range(mask, mask->poly + i, ires, range);
+    if (range[0] < nf << dres) range[0] = nf << dres;
+    if (range[1] > ((nf + 1) << dres) - 1) range[1] = ((nf + 1) << dres) - 1;
+
+    for (int n = range[0]; n <= range[1]; n++) {
+      for (int k = range[2]; k <= range[3]; k++) {
+        const int m = k & (nside - 1);
+        if ((m >> dres) != mf) continue;
+
+        const int ipix = (n << ires) + m;
+        double bound[4];
+        mangle_pix_bound(ires, ipix, bound);
+        const int cls = mangle_poly_pix(mask, mask->poly + i, bound);
+        if (cls == MANGLE_CLS_OUT) continue;
+
+        if (npair == max) {
+          if (max >= INT_MAX / 2) {
+            free(pair);
+            return MANGLE_ERR_MEMORY;
+          }
+          max <<= 1;
+          MANGLE_PAIR *ptmp = realloc(pair, max * sizeof(MANGLE_PAIR));
+          if (!ptmp) {
+            free(pair);
+            return MANGLE_ERR_MEMORY;
+          }
+          pair = ptmp;
+        }
+        pair[npair].pix = ipix;
+        pair[npair].poly = i;
+        pair[npair++].cls = cls;
+      }
+    }
+  }
+
+  /* Sort the pairs by pixel, with the order of polygons unchanged. */
+  int *cnt = calloc(nipix + 1, sizeof(int));
+  MANGLE_PAIR *sorted = malloc((npair ? npair : 1) * sizeof(MANGLE_PAIR));
+  if (!cnt || !sorted) {
+    free(pair);
+    if (cnt) free(cnt);
+    if (sorted) free(sorted);
+    return MANGLE_ERR_MEMORY;
+  }
+  for (size_t i = 0; i < npair; i++) cnt[pair[i].pix + 1]++;
+  for (int i = 0; i < nipix; i++) cnt[i + 1] += cnt[i];
+  for (size_t i = 0; i < npair; i++) sorted[cnt[pair[i].pix]++] = pair[i];
+  free(pair);
+  free(cnt);
+
+  if (!(mask->pmap = malloc(nipix * sizeof(int))) ||
+      !(mask->pix = malloc((nipix + 1) * sizeof(int))) ||
+      !(mask->plist = malloc((npair ? npair : 1) * sizeof(int)))) {
+    free(sorted);
+    return MANGLE_ERR_MEMORY;
+  }
+
+  /* Record the status of pixels, with polygons visited in the order of the
+     query, so that the first match is reported for all points. */
+  size_t num = 0;
+  size_t j = 0;
+  for (int i = 0; i < nipix; i++) {
+    mask->pix[i] = num;
+    mask->pmap[i] = MANGLE_PIX_OUT;
+    bool done = false;
+    for (; j < npair && sorted[j].pix == i; j++) {
+      if (done) continue;
+      if (sorted[j].cls == MANGLE_CLS_IN && num == (size_t) mask->pix[i]) {
+        mask->pmap[i] = sorted[j].poly;
+        done = true;
+        continue;
+      }
+      /* Record polygons to be checked for the boundary pixel. */
+      mask->plist[num++] = sorted[j].poly;
+      mask->pmap[i] = MANGLE_PIX_EDGE;
+      if (sorted[j].cls == MANGLE_CLS_IN) done = true;
+    }
+  }
+  mask->pix[nipix] = num;
+  mask->ires = ires;
+  free(sorted);
+
+  /* Reduce memory cost if applicable. */
+  if (num && num < npair) {
+    int *ptmp = realloc(mask->plist, num * sizeof(int));
+    if (ptmp) mask->plist = ptmp;
+  }
+  return 0;
+}
+
+
+/*============================================================================*\
+                          Functions for polygon query
+\*============================================================================*/
+
 /******************************************************************************
 Function `mangle_inside_poly`:
   Check if the endpoint of a unit vector is inside a polygon.
 Arguments:
+  * `mask`:     address of the structure for the mask;
   * `poly`:     pointer to the polygon to be checked;
   * `v`:        the unit vector to be checked.
 Return:
   True if the endpoint is inside the polygon.
 ******************************************************************************/
-static inline bool mangle_inside_poly(const POLYGON *poly, const double *v) {
-  /* Visit all caps of the polygon. */
-  for (int i = 0; i < poly->ncap; i++) {
-    if (!mangle_inside_cap(poly->cap + i, v)) return false;
-  }
-  return true;
+static inline bool mangle_inside_poly(const MANGLE *mask, const POLYGON *poly,
+    const double *v) {
+  const double *nx = mask->nx + poly->icap;
+  const double *ny = mask->ny + poly->icap;
+  const double *nz = mask->nz + poly->icap;
+  const double *thres = mask->thres + poly->icap;
+
+  /* Check all caps of the polygon without branches, for vectorization.
+     The flag is a double, as the reduction of integer flags from double
+     comparisons is not vectorized without AVX. */
+  double out = 0;
+  for (int i = 0; i < poly->ncap; i++)
+    out = (nx[i] * v[0] + ny[i] * v[1] + nz[i] * v[2] > thres[i]) ? out : 1;
+  return out == 0;
 }
 
 /******************************************************************************
@@ -443,32 +804,274 @@ static inline int mangle_query_pix(const int res, const double az,
 }
 
 /******************************************************************************
-Function `mangle_query_poly`:
-  Find a polygon that contains a given point.
+Function `mangle_pseudo_az`:
+  Compute a pseudo-angle of a vector on the x-y plane, which increases
+  monotonically with the azimuth angle, from 0 to 4 for a full circle.
 Arguments:
-  * `poly`:     pointer to the array of polygons to be visited;
-  * `npoly`:    number of polygons to be visited;
-  * `az`:       azimuth angle (in radians) of the point;
-  * `el`:       elevation angle (in radians) of the point.
+  * `v`:        the vector.
 Return:
-  Pointer to the polygon that contains the point.
+  The pseudo-angle, in the range [0, 4].
 ******************************************************************************/
-static inline POLYGON *mangle_query_poly(POLYGON *poly, const int npoly,
-    const double az, const double el) {
-  double v[3];          /* unit vector given the angular direction */
-  v[0] = cos(el) * cos(az);
-  v[1] = cos(el) * sin(az);
-  v[2] = sin(el);
+static inline double mangle_pseudo_az(const double *v) {
+  const double s = fabs(v[0]) + fabs(v[1]);
+  if (s == 0) return 0;
+  const double t = v[1] / s;
+  return (v[0] >= 0) ? ((t < 0) ? 4 + t : t) : 2 - t;
+}
+
+/******************************************************************************
+Function `mangle_azidx_query`:
+  Find the azimuthal pixel index of a unit vector with the lookup table.
+Arguments:
+  * `azi`:      address of the lookup table;
+  * `v`:        the unit vector of the point.
+Return:
+  Index of the pixel along the azimuth direction (starting from 0).
+******************************************************************************/
+static inline int mangle_azidx_query(const MANGLE_AZIDX *azi,
+    const double *v) {
+  const double p = mangle_pseudo_az(v);
+  int c = p * azi->scale;
+  if (c >= azi->ncell) c = azi->ncell - 1;
+  /* There is at most one pixel boundary in each cell. */
+  const int m = azi->cell[c];
+  return m + (p >= azi->edge[m + 1]);
+}
+
+/******************************************************************************
+Function `mangle_query_pix_vec`:
+  Find the pixel index of a point given by a unit vector, following the
+  `simple` pixelization scheme.
+Arguments:
+  * `res`:      resolution for the pixelization;
+  * `azi`:      lookup table for the azimuthal pixel index at `res`;
+  * `v`:        the unit vector of the point.
+Return:
+  Index of the pixel (starting from 0).
+******************************************************************************/
+static inline int mangle_query_pix_vec(const int res, const MANGLE_AZIDX *azi,
+    const double *v) {
+  const int nside = 1 << res;           /* number of pixels per side: 2^res */
+  const int m = mangle_azidx_query(azi, v);
+  /* The sine of the elevation angle is the z component of the vector,
+     which may exceed the range [-1, 1] slightly due to rounding errors. */
+  const double sine = v[2];
+  int n = (sine >= 1) ? 0 : ceil((1 - sine) * 0.5 * nside) - 1;
+  if (n >= nside) n = nside - 1;
+  return (n << res) + m;
+}
 
+/******************************************************************************
+Function `mangle_query_edge`:
+  Find a polygon that contains a given point in a boundary pixel.
+Arguments:
+  * `mask`:     address of the structure for the mask;
+  * `idx`:      index of the pixel in the internal index;
+  * `v`:        the unit vector of the point.
+Return:
+  Pointer to the polygon that contains the point.
+******************************************************************************/
+static inline POLYGON *mangle_query_edge(const MANGLE *mask, const int idx,
+    const double *v) {
   /* Visit the polygons and report the first match. */
-  for (int i = 0; i < npoly; i++) {
-    if (mangle_inside_poly(poly + i, v)) return poly + i;
+  for (int i = mask->pix[idx]; i < mask->pix[idx + 1]; i++) {
+    POLYGON *poly = mask->poly + mask->plist[i];
+    if (mangle_inside_poly(mask, poly, v)) return poly;
   }
 
   return NULL;
 }
 
 
+/*============================================================================*\
+                     Functions for the binary cache of masks
+\*============================================================================*/
+
+/******************************************************************************
+Function `mangle_cache_header`:
+  Fill the header of the binary cache for a mask.
+Arguments:
+  * `mask`:     address of the structure for the mask;
+  * `st`:       status of the polygon-format mask file;
+  * `wmin`:     minimum weight of polygons to be kept;
+  * `head`:     the header to be filled.
+******************************************************************************/
+static void mangle_cache_header(const MANGLE *mask, const struct stat *st,
+    const double wmin, MANGLE_CACHE_HEAD *head) {
+  memset(head, 0, sizeof(MANGLE_CACHE_HEAD));
+  memcpy(head->magic, MANGLE_CACHE_MAGIC, sizeof(head->magic));
+  head->version = MANGLE_CACHE_VERSION;
+  head->size_poly = sizeof(POLYGON);
+  head->src_size = st->st_size;
+  head->src_mtime = st->st_mtime;
+  head->wmin = wmin;
+  head->npoly = mask->npoly;
+  head->res = mask->res;
+  head->ires = mask->ires;
+  head->ncap = mask->npoly ? mask->poly[mask->npoly - 1].icap +
+      mask->poly[mask->npoly - 1].ncap : 0;
+  head->nlist = mask->pix[1 << (mask->ires << 1)];
+}
+
+/******************************************************************************
+Function `mangle_cache_sections`:
+  Compute the offsets of data sections in the binary cache, which are aligned
+  to MANGLE_CACHE_ALIGN bytes.
+Arguments:
+  * `head`:     header of the cache;
+  * `offset`:   offsets of the sections, and the total size of the cache.
+******************************************************************************/
+static void mangle_cache_sections(const MANGLE_CACHE_HEAD *head,
+    uint64_t *offset) {
+  const uint64_t nipix = (uint64_t) 1 << (head->ires << 1);
+  const uint64_t size[MANGLE_CACHE_NSEC] = {
+    head->npoly * sizeof(POLYGON),      /* poly  */
+    head->ncap * sizeof(double),        /* nx    */
+    head->ncap * sizeof(double),        /* ny    */
+    head->ncap * sizeof(double),        /* nz    */
+    head->ncap * sizeof(double),        /* thres */
+    nipix * sizeof(int),                /* pmap  */
+    (nipix + 1) * sizeof(int),          /* pix   */
+    head->nlist * sizeof(int)           /* plist */
+  };
+  uint64_t pos = sizeof(MANGLE_CACHE_HEAD);
+  for (int i = 0; i < MANGLE_CACHE_NSEC; i++) {
+    pos = (pos + MANGLE_CACHE_ALIGN - 1) / MANGLE_CACHE_ALIGN *
+        MANGLE_CACHE_ALIGN;
+    offset[i] = pos;
+    pos += size[i];
+  }
+  offset[MANGLE_CACHE_NSEC] = pos;
+}
+
+/******************************************************************************
+Function `mangle_cache_load`:
+  Map the binary cache of a mask into memory, if it is valid for the source.
+Arguments:
+  * `mask`:     address of the structure for the mask;
+  * `fcache`:   name of the cache file;
+  * `st`:       status of the polygon-format mask file;
+  * `wmin`:     minimum weight of polygons to be kept.
+Return:
+  Zero on success; non-zero if the cache cannot be used.
+******************************************************************************/
+static int mangle_cache_load(MANGLE *mask, const char *fcache,
+    const struct stat *st, const double wmin) {
+  int fd = open(fcache, O_RDONLY);
+  if (fd == -1) return MANGLE_ERR_FILE;
+
+  /* The cache must be newer than the source. */
+  struct stat cst;
+  if (fstat(fd, &cst) || cst.st_mtime < st->st_mtime ||
+      (size_t) cst.st_size < sizeof(MANGLE_CACHE_HEAD)) {
+    close(fd);
+    return MANGLE_ERR_FILE;
+  }
+
+  void *map = mmap(NULL, cst.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return MANGLE_ERR_FILE;
+
+  /* Validate the header against the source file and settings. */
+  const MANGLE_CACHE_HEAD *head = map;
+  uint64_t offset[MANGLE_CACHE_NSEC + 1];
+  if (memcmp(head->magic, MANGLE_CACHE_MAGIC, sizeof(head->magic)) ||
+      head->version != MANGLE_CACHE_VERSION ||
+      head->size_poly != sizeof(POLYGON) ||
+      head->src_size != (int64_t) st->st_size ||
+      head->src_mtime != (int64_t) st->st_mtime || head->wmin != wmin ||
+      head->npoly <= 0 || head->res < 0 || head->res > MANGLE_MAX_RES ||
+      head->ires < head->res || head->ires > MANGLE_MAX_RES) {
+    munmap(map, cst.st_size);
+    return MANGLE_ERR_FILE;
+  }
+  mangle_cache_sections(head, offset);
+  if (offset[MANGLE_CACHE_NSEC] != (uint64_t) cst.st_size) {
+    munmap(map, cst.st_size);
+    return MANGLE_ERR_FILE;
+  }
+
+  /* Set pointers to the data sections, with no parsing. */
+  char *base = map;
+  mask->poly = (POLYGON *) (base + offset[0]);
+  mask->nx = (double *) (base + offset[1]);
+  mask->ny = (double *) (base + offset[2]);
+  mask->nz = (double *) (base + offset[3]);
+  mask->thres = (double *) (base + offset[4]);
+  mask->pmap = (int *) (base + offset[5]);
+  mask->pix = (int *) (base + offset[6]);
+  mask->plist = (int *) (base + offset[7]);
+  mask->npoly = head->npoly;
+  mask->res = head->res;
+  mask->ires = head->ires;
+  mask->map = map;
+  mask->msize = cst.st_size;
+  return 0;
+}
+
+/******************************************************************************
+Function `mangle_cache_save`:
+  Save the mask to a binary cache, through a temporary file that is renamed
+  at the end, so that concurrent jobs never see incomplete caches.
+Arguments:
+  * `mask`:     address of the structure for the mask;
+  * `fcache`:   name of the cache file;
+  * `st`:       status of the polygon-format mask file;
+  * `wmin`:     minimum weight of polygons to be kept.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int mangle_cache_save(const MANGLE *mask, const char *fcache,
+    const struct stat *st, const double wmin) {
+  MANGLE_CACHE_HEAD head;
+  uint64_t offset[MANGLE_CACHE_NSEC + 1];
+  mangle_cache_header(mask, st, wmin, &head);
+  mangle_cache_sections(&head, offset);
+
+  const void *data[MANGLE_CACHE_NSEC] = {mask->poly, mask->nx, mask->ny,
+      mask->nz, mask->thres, mask->pmap, mask->pix, mask->plist};
+  const uint64_t nipix = (uint64_t) 1 << (mask->ires << 1);
+  const uint64_t size[MANGLE_CACHE_NSEC] = {
+    head.npoly * sizeof(POLYGON), head.ncap * sizeof(double),
+    head.ncap * sizeof(double), head.ncap * sizeof(double),
+    head.ncap * sizeof(double), nipix * sizeof(int),
+    (nipix + 1) * sizeof(int), head.nlist * sizeof(int)
+  };
+
+  /* Name of the temporary file. */
+  size_t len = strlen(fcache) + MANGLE_CACHE_TMP_LEN;
+  char *ftmp = malloc(len * sizeof(char));
+  if (!ftmp) return MANGLE_ERR_MEMORY;
+  snprintf(ftmp, len, "%s.tmp%ld", fcache, (long) getpid());
+
+  FILE *fp = fopen(ftmp, "wb");
+  if (!fp) {
+    free(ftmp);
+    return MANGLE_ERR_FILE;
+  }
+
+  /* Write the header and sections, with zero paddings for alignment. */
+  const char pad[MANGLE_CACHE_ALIGN] = {0};
+  uint64_t pos = sizeof(MANGLE_CACHE_HEAD);
+  bool fail = fwrite(&head, sizeof(MANGLE_CACHE_HEAD), 1, fp) != 1;
+  for (int i = 0; i < MANGLE_CACHE_NSEC && !fail; i++) {
+    if (offset[i] > pos &&
+        fwrite(pad, offset[i] - pos, 1, fp) != 1) fail = true;
+    if (size[i] && fwrite(data[i], size[i], 1, fp) != 1) fail = true;
+    pos = offset[i] + size[i];
+  }
+  if (fclose(fp)) fail = true;
+
+  if (fail || rename(ftmp, fcache)) {
+    remove(ftmp);
+    free(ftmp);
+    return MANGLE_ERR_FILE;
+  }
+  free(ftmp);
+  return 0;
+}
+
+
 /*============================================================================*\
                      Interfaces for applying polygon masks
 \*============================================================================*/
@@ -479,11 +1082,13 @@ Function `mangle_init`:
 Arguments:
   * `fname`:    name of the mangle polygon-format mask file;
   * `wmin`:     minimum weight of polygons to be kept;
+  * `fcache`:   name of the binary cache file, NULL for disabling the cache;
   * `err`:      an integer for indicating error messages.
 Return:
   Address of the structure for the mask.
 ******************************************************************************/
-MANGLE *mangle_init(const char *fname, const double wmin, int *err) {
+MANGLE *mangle_init(const char *fname, const double wmin, const char *fcache,
+    int *err) {
   if (!fname || !(*fname)) {
     if (err) *err = MANGLE_ERR_ARGS;
     return NULL;
@@ -498,19 +1103,64 @@ MANGLE *mangle_init(const char *fname, const double wmin, int *err) {
 
   *err = 0;
   mask->poly = NULL;
-  mask->pix = NULL;
+  mask->pmap = mask->pix = mask->plist = NULL;
+  mask->nx = mask->ny = mask->nz = mask->thres = NULL;
+  mask->map = NULL;
+  mask->msize = 0;
+  mask->cache = MANGLE_CACHE_NONE;
+  mask->azi = NULL;
+
+  /* Map the binary cache if it is valid. */
+  struct stat st;
+  if (fcache) {
+    if (stat(fname, &st)) {
+      *err = MANGLE_ERR_FILE;
+      mangle_destroy(mask);
+      return NULL;
+    }
+    if (!mangle_cache_load(mask, fcache, &st, wmin)) {
+      mask->cache = MANGLE_CACHE_LOADED;
+      if (!(mask->azi = mangle_azidx_init(mask->ires))) {
+        *err = MANGLE_ERR_MEMORY;
+        mangle_destroy(mask);
+        return NULL;
+      }
+      return mask;
+    }
+  }
 
   /* Read polygons from file. */
-  if (!(mask->poly = mangle_read(fname, wmin, &mask->npoly, &mask->res, err))) {
+  POLYCAP *caps = NULL;
+  if (!(mask->poly = mangle_read(fname, wmin, &mask->npoly, &mask->res, &caps,
+      err))) {
+    mangle_destroy(mask);
+    return NULL;
+  }
+
+  *err = mangle_cap_arena(mask, caps);
+  free(caps);
+  if (*err) {
+    mangle_destroy(mask);
+    return NULL;
+  }
+
+  if ((*err = mangle_pix_idx(mask))) {
     mangle_destroy(mask);
     return NULL;
   }
 
-  if (!(mask->pix = mangle_pix_idx(mask->poly, mask->npoly, mask->res, err))) {
+  if (!(mask->azi = mangle_azidx_init(mask->ires))) {
+    *err = MANGLE_ERR_MEMORY;
     mangle_destroy(mask);
     return NULL;
   }
 
+  /* Save the binary cache; failures are reported but not fatal. */
+  if (fcache) {
+    mask->cache = mangle_cache_save(mask, fcache, &st, wmin) ?
+        MANGLE_CACHE_FAILED : MANGLE_CACHE_SAVED;
+  }
+
   return mask;
 }
 
@@ -522,16 +1172,95 @@ Arguments:
 ******************************************************************************/
 void mangle_destroy(MANGLE *mask) {
   if (!mask) return;
-  if (mask->poly) {
-    for (int i = 0; i < mask->npoly; i++) {
-      if (mask->poly[i].cap) free(mask->poly[i].cap);
-    }
-    free(mask->poly);
+  mangle_azidx_destroy(mask->azi);
+  if (mask->map) {
+    munmap(mask->map, mask->msize);
+    free(mask);
+    return;
   }
+  if (mask->poly) free(mask->poly);
+  if (mask->nx) free(mask->nx);
+  if (mask->ny) free(mask->ny);
+  if (mask->nz) free(mask->nz);
+  if (mask->thres) free(mask->thres);
+  if (mask->pmap) free(mask->pmap);
   if (mask->pix) free(mask->pix);
+  if (mask->plist) free(mask->plist);
   free(mask);
 }
 
+/******************************************************************************
+Function `mangle_azidx_init`:
+  Create the lookup table for the azimuthal pixel index of unit vectors,
+  following the `simple` pixelization scheme.
+Arguments:
+  * `res`:      resolution for the pixelization.
+Return:
+  Address of the lookup table; NULL if memory allocation fails.
+******************************************************************************/
+MANGLE_AZIDX *mangle_azidx_init(const int res) {
+  MANGLE_AZIDX *azi = malloc(sizeof *azi);
+  if (!azi) return NULL;
+
+  /* The pseudo-angle changes with the azimuth angle by a factor of at most
+     2, so each pixel is wider than pi / nside in the pseudo-angle, and a
+     table with 2 * nside cells has at most one pixel boundary per cell. */
+  const int nside = 1 << res;
+  azi->nside = nside;
+  azi->ncell = nside << 1;
+  azi->scale = azi->ncell / 4.0;
+  azi->cell = malloc(azi->ncell * sizeof(int));
+  azi->edge = malloc((nside + 1) * sizeof(double));
+  if (!azi->cell || !azi->edge) {
+    mangle_azidx_destroy(azi);
+    return NULL;
+  }
+
+  /* The last edge is never reached, even for pseudo-angles rounded to 4. */
+  azi->edge[0] = 0;
+  for (int m = 1; m < nside; m++) {
+    const double az = TWOPI * m / nside;
+    const double v[2] = {cos(az), sin(az)};
+    azi->edge[m] = mangle_pseudo_az(v);
+  }
+  azi->edge[nside] = HUGE_VAL;
+
+  for (int c = 0, m = 0; c < azi->ncell; c++) {
+    const double p = c / azi->scale;
+    while (azi->edge[m + 1] <= p) m++;
+    azi->cell[c] = m;
+  }
+
+  return azi;
+}
+
+/******************************************************************************
+Function `mangle_azidx_destroy`:
+  Deconstruct the lookup table for the azimuthal pixel index.
+Arguments:
+  * `azi`:      address of the lookup table.
+******************************************************************************/
+void mangle_azidx_destroy(MANGLE_AZIDX *azi) {
+  if (!azi) return;
+  if (azi->cell) free(azi->cell);
+  if (azi->edge) free(azi->edge);
+  free(azi);
+}
+
+/******************************************************************************
+Function `mangle_azidx_pix`:
+  Find the azimuthal pixel index of a unit vector, without trigonometric
+  functions.
+Arguments:
+  * `azi`:      address of the lookup table;
+  * `v`:        the unit vector of the point.
+Return:
+  Index of the pixel along the azimuth direction (starting from 0).
+******************************************************************************/
+int mangle_azidx_pix(const MANGLE_AZIDX *azi, const double *v) {
+  return mangle_azidx_query(azi, v);
+}
+
 /******************************************************************************
 Function `mangle_query`:
   Find a polygon that contains a given point.
@@ -546,18 +1275,72 @@ POLYGON *mangle_query(const MANGLE *mask, const double ra, const double dec) {
   /* Compute the azimuth and elevation angles in radians. */
   const double az = ra * DEG2RAD;
   const double el = dec * DEG2RAD;
-  POLYGON *poly = mask->poly;
-  int npoly = mask->npoly;
 
-  /* Find the pixel index if applicable. */
-  if (mask->res) {
-    int idx = mangle_query_pix(mask->res, az, el);
-    poly += mask->pix[idx];
-    npoly = mask->pix[idx + 1] - mask->pix[idx];
-  }
+  /* Look up the pixel index, and check polygons only for boundary pixels. */
+  const int idx = mangle_query_pix(mask->ires, az, el);
+  const int code = mask->pmap[idx];
+  if (code >= 0) return mask->poly + code;
+  if (code == MANGLE_PIX_OUT) return NULL;
 
   /* Find the polygon that contains the point. */
-  return mangle_query_poly(poly, npoly, az, el);
+  double v[3];          /* unit vector given the angular direction */
+  v[0] = cos(el) * cos(az);
+  v[1] = cos(el) * sin(az);
+  v[2] = sin(el);
+  return mangle_query_edge(mask, idx, v);
+}
+
+/******************************************************************************
+Function `mangle_query_vec`:
+  Find a polygon that contains a given point, specified by a unit vector.
+Arguments:
+  * `mask`:     address of the structure for the mask;
+  * `v`:        the unit vector (x,y,z) of the point, with the right ascension
+                and declination being the azimuth and elevation angles.
+Return:
+  Pointer to the polygon that contains the point; NULL if no polygon is found.
+******************************************************************************/
+POLYGON *mangle_query_vec(const MANGLE *mask, const double v[3]) {
+  /* Look up the pixel index, and check polygons only for boundary pixels. */
+  const int idx = mangle_query_pix_vec(mask->ires, mask->azi, v);
+  const int code = mask->pmap[idx];
+  if (code >= 0) return mask->poly + code;
+  if (code == MANGLE_PIX_OUT) return NULL;
+  return mangle_query_edge(mask, idx, v);
+}
+
+/******************************************************************************
+Function `mangle_pix_status`:
+  Classify a pixel of the `simple` pixelization scheme with respect to the
+  mask, using the internal pixel index.
+Arguments:
+  * `mask`:     address of the structure for the mask;
+  * `res`:      resolution for the pixelization;
+  * `idx`:      index of the pixel (starting from 0).
+Return:
+  MANGLE_CLS_IN if the pixel is fully inside the mask; MANGLE_CLS_OUT if the
+  pixel is fully outside the mask; MANGLE_CLS_EDGE otherwise, or if the
+  resolution is finer than that of the internal index.
+******************************************************************************/
+int mangle_pix_status(const MANGLE *mask, const int res, const int idx) {
+  if (res < 0 || res > mask->ires) return MANGLE_CLS_EDGE;
+
+  /* Sub-pixels in the index, which share the boundaries of the pixel. */
+  const int dres = mask->ires - res;
+  const int n = idx >> res;
+  const int m = idx & ((1 << res) - 1);
+  int nin = 0, nout = 0;
+  for (int i = n << dres; i < (n + 1) << dres; i++) {
+    for (int j = m << dres; j < (m + 1) << dres; j++) {
+      const int code = mask->pmap[(i << mask->ires) + j];
+      if (code >= 0) nin++;
+      else if (code == MANGLE_PIX_OUT) nout++;
+      else return MANGLE_CLS_EDGE;
+    }
+  }
+  if (!nout) return MANGLE_CLS_IN;
+  if (!nin) return MANGLE_CLS_OUT;
+  return MANGLE_CLS_EDGE;
 }
 
 /******************************************************************************
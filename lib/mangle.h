@@ -31,6 +31,8 @@
 #ifndef __MANGLE_H__
 #define __MANGLE_H__
 
+#include <stddef.h>
+
 /*******************************************************************************
   A simplified implementation of the `polyid` command of mangle:
   https://space.mit.edu/~molly/mangle/
@@ -51,20 +53,51 @@ typedef double POLYCAP[4];
 typedef struct {
   int polyid;           /* polygon ID            */
   int pixel;            /* pixel of the polygon  */
-  POLYCAP *cap;         /* caps of the polygon   */
+  size_t icap;          /* index of first cap    */
   int ncap;             /* number of caps        */
   double weight;        /* weight of the polygon */
   double area;          /* area of the polygon   */
 } POLYGON;
 
+/* Lookup table for the azimuthal pixel index of unit vectors. */
+typedef struct {
+  int nside;            /* number of pixels along the azimuth direction    */
+  int ncell;            /* number of cells of the table                    */
+  double scale;         /* number of cells per unit of the pseudo-angle    */
+  int *cell;            /* the pixel at the start of each cell             */
+  double *edge;         /* pseudo-angle of the starting edge of each pixel */
+} MANGLE_AZIDX;
+
 /* Data strucutre for a mask (a collection of polygons). */
 typedef struct {
   POLYGON *poly;        /* array of all valid polygons                  */
   int npoly;            /* number of valid polygons                     */
   int res;              /* resolution for the pixelization              */
-  int *pix;             /* indices of polygons with different pixel IDs */
+  int ires;             /* resolution of the internal pixel index       */
+  int *pmap;            /* polygon fully covering each pixel, or status */
+  int *pix;             /* offsets of polygon lists for boundary pixels */
+  int *plist;           /* indices of polygons for boundary pixels      */
+  double *nx;           /* x components of the axes of all caps         */
+  double *ny;           /* y components of the axes of all caps         */
+  double *nz;           /* z components of the axes of all caps         */
+  double *thres;        /* thresholds of the dot products for all caps  */
+  void *map;            /* memory mapped binary cache                   */
+  size_t msize;         /* size of the memory mapped cache              */
+  int cache;            /* status of the binary cache                   */
+  MANGLE_AZIDX *azi;    /* azimuthal lookup table of the internal index */
 } MANGLE;
 
+/* Status of the binary cache. */
+#define MANGLE_CACHE_NONE       0       /* cache is disabled         */
+#define MANGLE_CACHE_LOADED     1       /* mask is loaded from cache */
+#define MANGLE_CACHE_SAVED      2       /* cache is created          */
+#define MANGLE_CACHE_FAILED     3       /* failed to create cache    */
+
+/* Classification of polygons, caps, or masks with respect to pixels. */
+#define MANGLE_CLS_OUT          0
+#define MANGLE_CLS_IN           1
+#define MANGLE_CLS_EDGE         2
+
 
 /*============================================================================*\
                      Interfaces for applying polygon masks
@@ -76,11 +109,13 @@ Function `mangle_init`:
 Arguments:
   * `fname`:    name of the mangle polygon-format mask file;
   * `wmin`:     minimum weight of polygons to be kept;
+  * `fcache`:   name of the binary cache file, NULL for disabling the cache;
   * `err`:      an integer for indicating error messages.
 Return:
   Address of the structure for the mask.
 ******************************************************************************/
-MANGLE *mangle_init(const char *fname, const double wmin, int *err);
+MANGLE *mangle_init(const char *fname, const double wmin, const char *fcache,
+    int *err);
 
 /******************************************************************************
 Function `mangle_destroy`:
@@ -102,6 +137,64 @@ Return:
 ******************************************************************************/
 POLYGON *mangle_query(const MANGLE *mask, const double ra, const double dec);
 
+/******************************************************************************
+Function `mangle_query_vec`:
+  Find a polygon that contains a given point, specified by a unit vector.
+Arguments:
+  * `mask`:     address of the structure for the mask;
+  * `v`:        the unit vector (x,y,z) of the point, with the right ascension
+                and declination being the azimuth and elevation angles.
+Return:
+  Pointer to the polygon that contains the point; NULL if no polygon is found.
+******************************************************************************/
+POLYGON *mangle_query_vec(const MANGLE *mask, const double v[3]);
+
+/******************************************************************************
+Function `mangle_pix_status`:
+  Classify a pixel of the `simple` pixelization scheme with respect to the
+  mask, using the internal pixel index.
+Arguments:
+  * `mask`:     address of the structure for the mask;
+  * `res`:      resolution for the pixelization;
+  * `idx`:      index of the pixel (starting from 0).
+Return:
+  MANGLE_CLS_IN if the pixel is fully inside the mask; MANGLE_CLS_OUT if the
+  pixel is fully outside the mask; MANGLE_CLS_EDGE otherwise, or if the
+  resolution is finer than that of the internal index.
+******************************************************************************/
+int mangle_pix_status(const MANGLE *mask, const int res, const int idx);
+
+/******************************************************************************
+Function `mangle_azidx_init`:
+  Create the lookup table for the azimuthal pixel index of unit vectors,
+  following the `simple` pixelization scheme.
+Arguments:
+  * `res`:      resolution for the pixelization.
+Return:
+  Address of the lookup table; NULL if memory allocation fails.
+******************************************************************************/
+MANGLE_AZIDX *mangle_azidx_init(const int res);
+
+/******************************************************************************
+Function `mangle_azidx_destroy`:
+  Deconstruct the lookup table for the azimuthal pixel index.
+Arguments:
+  * `azi`:      address of the lookup table.
+******************************************************************************/
+void mangle_azidx_destroy(MANGLE_AZIDX *azi);
+
+/******************************************************************************
+Function `mangle_azidx_pix`:
+  Find the azimuthal pixel index of a unit vector, without trigonometric
+  functions.
+Arguments:
+  * `azi`:      address of the lookup table;
+  * `v`:        the unit vector of the point.
+Return:
+  Index of the pixel along the azimuth direction (starting from 0).
+******************************************************************************/
+int mangle_azidx_pix(const MANGLE_AZIDX *azi, const double *v);
+
 /******************************************************************************
 Function `mangle_errmsg`:
   Produce error message for a given error code.
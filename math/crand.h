@@ -0,0 +1,144 @@
+/*******************************************************************************
+* crand.h: this file is part of the cutsky program.
+
+* cutsky: cutsky catalogue generator.
+
+* Github repository:
+        https://github.com/cheng-zhao/cutsky
+
+* Copyright (c) 2023-2025 Cheng Zhao <zhaocheng03@gmail.com>
+ 
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+ 
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+ 
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+*******************************************************************************/
+
+#ifndef __CRAND_H__
+#define __CRAND_H__
+
+#include <stdint.h>
+
+/*******************************************************************************
+  Counter-based random number generator, for which each number is a pure
+  function of a seed and a counter, i.e., a key identifying the random number.
+  The generator is SplitMix64, evaluated directly at the position of the key.
+  ref: https://doi.org/10.1145/2714064.2660195
+*******************************************************************************/
+
+/*============================================================================*\
+                    Definitions for the random number keys
+\*============================================================================*/
+
+/* Number of bits for the replica index along each direction. */
+#define CRAND_REP_BITS          8
+/* Maximum number of box duplications for each side. */
+#define CRAND_MAX_NDUP          (1 << (CRAND_REP_BITS - 1))
+/* Maximum index of input objects. */
+#define CRAND_MAX_INDEX         ((UINT64_C(1) << (64 - 3 * CRAND_REP_BITS)) - 1)
+
+
+/*============================================================================*\
+                   Interfaces for the random number generation
+\*============================================================================*/
+
+/******************************************************************************
+Function `crand_mix`:
+  Scramble the bits of a 64-bit integer, with the SplitMix64 finalizer.
+Arguments:
+  * `x`:        the integer to be scrambled.
+Return:
+  The scrambled integer.
+******************************************************************************/
+static inline uint64_t crand_mix(uint64_t x) {
+  x ^= x >> 30;
+  x *= UINT64_C(0xbf58476d1ce4e5b9);
+  x ^= x >> 27;
+  x *= UINT64_C(0x94d049bb133111eb);
+  x ^= x >> 31;
+  return x;
+}
+
+/******************************************************************************
+Function `crand_key`:
+  Combine the index of an input object and the index of a box replica into a
+  key for random number generation.
+Arguments:
+  * `idx`:      index of the input object, no larger than `CRAND_MAX_INDEX`;
+  * `i`, `j`, `k`: indices of the box replica along different directions,
+                in the range of [-`CRAND_MAX_NDUP`, `CRAND_MAX_NDUP`).
+Return:
+  The key for random number generation.
+******************************************************************************/
+static inline uint64_t crand_key(const uint64_t idx, const int i, const int j,
+    const int k) {
+  return (idx << (3 * CRAND_REP_BITS)) |
+      ((uint64_t) (i + CRAND_MAX_NDUP) << (2 * CRAND_REP_BITS)) |
+      ((uint64_t) (j + CRAND_MAX_NDUP) << CRAND_REP_BITS) |
+      (uint64_t) (k + CRAND_MAX_NDUP);
+}
+
+/******************************************************************************
+Function `crand_key_shift`:
+  Shift the object index encoded in a key for random number generation.
+Arguments:
+  * `key`:      the key for random number generation;
+  * `offset`:   offset to be added to the index of the input object.
+Return:
+  The key with the shifted index.
+******************************************************************************/
+static inline uint64_t crand_key_shift(const uint64_t key,
+    const uint64_t offset) {
+  return key + (offset << (3 * CRAND_REP_BITS));
+}
+
+/******************************************************************************
+Function `crand_seed_split`:
+  Derive the seed of an independent stream of random numbers from a seed,
+  with the 0-th stream given by the seed itself.
+Arguments:
+  * `seed`:     the random seed;
+  * `idx`:      index of the stream.
+Return:
+  The seed of the stream.
+******************************************************************************/
+static inline uint64_t crand_seed_split(const uint64_t seed, const int idx) {
+  if (!idx) return seed;
+  /* Scrambled, so that streams of nearby seeds do not overlap. */
+  return crand_mix(seed + (uint64_t) idx * UINT64_C(0x9e3779b97f4a7c15));
+}
+
+/******************************************************************************
+Function `crand_double`:
+  Generate a double-precision random number uniformly distributed in [0,1),
+  for a given seed and key.
+Arguments:
+  * `seed`:     the random seed;
+  * `key`:      the key identifying the random number.
+Return:
+  The random number.
+******************************************************************************/
+static inline double crand_double(const uint64_t seed, const uint64_t key) {
+  /* The key-th output of SplitMix64, with the state initialised by the seed.
+     0x9e3779b97f4a7c15 is the golden ratio increment of SplitMix64. */
+  const uint64_t x = crand_mix(crand_mix(seed) +
+      (key + 1) * UINT64_C(0x9e3779b97f4a7c15));
+  /* 0x1p-53 = 2^-53 */
+  return (x >> 11) * 0x1p-53;
+}
+
+#endif
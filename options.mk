@@ -2,6 +2,8 @@ CC = gcc
 CFLAGS = -std=c99 -O3 -Wall -flto=auto
 
 USE_OMP = T
+USE_MPI = F     # T for the multi-node build with the MPI compiler wrapper
+MPICC = mpicc
 WITH_FITS = T  # T for enabling FITS-format outputs
 
 # Directory for CFITSIO (>=4.2) library
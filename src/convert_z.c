@@ -242,6 +242,92 @@ static int read_zsample(const CONF *conf, ZCVT *cvt, const double zmin,
 }
 
 
+/******************************************************************************
+Function `fill_index`:
+  Record the last sample below each cell of the uniform index, with cell edges
+  extended for rounding errors.
+Arguments:
+  * `cvt`:      structure for redshift conversion;
+  * `h`:        width of the cells.
+Return:
+  Maximum number of samples inside a cell.
+******************************************************************************/
+static int fill_index(ZCVT *cvt, const double h) {
+  const int n = cvt->n;
+  const double margin = h * CUTSKY_ZCNVT_IDX_TOL;
+  int lo = 0, hi = 0, nmax = 0;
+  for (int c = 0; c < cvt->ncell; c++) {
+    const double dlo = cvt->dist0 + c * h - margin;
+    const double dhi = cvt->dist0 + (c + 1) * h + margin;
+    while (lo < n - 2 && sqrt(cvt->d2[lo + 1]) <= dlo) lo++;
+    if (hi < lo) hi = lo;
+    while (hi < n - 2 && sqrt(cvt->d2[hi + 1]) <= dhi) hi++;
+    cvt->idx[c] = lo;
+    if (hi - lo > nmax) nmax = hi - lo;
+  }
+  return nmax;
+}
+
+/******************************************************************************
+Function `create_index`:
+  Create the uniform index in comoving distance for locating spline intervals.
+  If the samples are too unevenly spaced for the index, the intervals are
+  located by bisection instead.
+Arguments:
+  * `cvt`:      structure for redshift conversion.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int create_index(ZCVT *cvt) {
+  const int n = cvt->n;
+  if (n < 2) {
+    P_ERR("too few samples for redshift conversion\n");
+    return CUTSKY_ERR_ZCVT;
+  }
+
+  /* Cells are made narrower than the minimum sample spacing in distance,
+     so that each cell contains at most one sample in general. */
+  double wmin = HUGE_VAL;
+  for (int i = 1; i < n; i++) {
+    double w = sqrt(cvt->d2[i]) - sqrt(cvt->d2[i - 1]);
+    if (w < wmin) wmin = w;
+  }
+  cvt->dist0 = sqrt(cvt->d2[0]);
+  const double range = sqrt(cvt->d2[n - 1]) - cvt->dist0;
+  double ncell = ceil(range * CUTSKY_ZCNVT_IDX_DENS / wmin);
+  if (!(ncell >= 1)) ncell = 1;
+  if (ncell > CUTSKY_ZCNVT_MAX_CELL) ncell = CUTSKY_ZCNVT_MAX_CELL;
+  cvt->ncell = ncell;
+
+  if (!(cvt->idx = malloc(CUTSKY_ZCNVT_MAX_CELL * sizeof(int)))) {
+    P_ERR("failed to allocate memory for redshift conversion\n");
+    return CUTSKY_ERR_MEMORY;
+  }
+
+  /* Refine the cells until the number of steps of the lookup is enough. */
+  for (;;) {
+    const double h = range / cvt->ncell;
+    cvt->dinv = 1 / h;
+    if (fill_index(cvt, h) <= CUTSKY_ZCNVT_IDX_STEP) break;
+    if (cvt->ncell >= CUTSKY_ZCNVT_MAX_CELL) {
+      free(cvt->idx);
+      cvt->idx = NULL;
+      cvt->ncell = 0;
+      return 0;
+    }
+    cvt->ncell = (cvt->ncell > CUTSKY_ZCNVT_MAX_CELL / 2) ?
+        CUTSKY_ZCNVT_MAX_CELL : cvt->ncell * 2;
+  }
+
+  /* Reduce memory cost if applicable. */
+  if (cvt->ncell < CUTSKY_ZCNVT_MAX_CELL) {
+    int *tmp = realloc(cvt->idx, cvt->ncell * sizeof(int));
+    if (tmp) cvt->idx = tmp;
+  }
+  return 0;
+}
+
+
 /*============================================================================*\
                       Interface for coordinate conversion
 \*============================================================================*/
@@ -279,6 +365,7 @@ ZCVT *zcvt_init(const CONF *conf) {
     return NULL;
   }
   cvt->z = cvt->d2 = cvt->zpp = NULL;
+  cvt->idx = NULL;
 
   if (conf->fzcnvt) {
     if (read_zsample(conf, cvt, zmin, zmax)) {
@@ -312,35 +399,76 @@ ZCVT *zcvt_init(const CONF *conf) {
     create_zsample(conf, cvt, zmin, dz);
   }
 
+  /* Create the uniform index for the interpolation. */
+  if (create_index(cvt)) {
+    zcvt_destroy(cvt);
+    return NULL;
+  }
+
   /* Number of box duplications needed for each side. */
   cvt->ndup = ceil(sqrt(cvt->d2max) / conf->Lbox);
   cvt->Lbox = conf->Lbox;
   cvt->zmin = conf->zmin;
   cvt->zmax = conf->zmax;
 
-  if (conf->verbose)
-    printf("  Interpolation sample created with %d points\n", cvt->n);
+  if (conf->verbose) {
+    if (cvt->idx)
+      printf("  Interpolation sample created with %d points, "
+          "indexed by %d cells\n", cvt->n, cvt->ncell);
+    else
+      printf("  Interpolation sample created with %d points, "
+          "which are too unevenly spaced for the index\n", cvt->n);
+  }
 
   printf(FMT_DONE);
   return cvt;
 }
 
 /******************************************************************************
-Function `convert_z`:
-  Convert a squared radial comoving distance to redshift.
+Function `zcvt_shell`:
+  Compute the range of squared comoving distances of objects that may be
+  shifted into the redshift range of interest by peculiar velocities, given
+  the maximum speed of the objects. The range is never wider than the one
+  for the maximum velocity of the redshift conversion.
 Arguments:
   * `cvt`:      structure for redshift conversion;
-  * `dist2`:    the input squared radial comoving distance.
-Return:
-  The corresponding redshift on success; HUGE_VAL on error.
+  * `vmax`:     the maximum speed of the objects;
+  * `d2min`:    the minimum squared distance of interest;
+  * `d2max`:    the maximum squared distance of interest.
 ******************************************************************************/
-double convert_z(const ZCVT *cvt, const double dist2) {
-  int idx = bin_search(cvt->d2, cvt->n, dist2);
-  if (idx == INT_MAX) return HUGE_VAL;
-
-  double z = (idx == cvt->n - 1) ? cvt->z[idx] :
-      cspline_eval(cvt->d2, cvt->z, cvt->zpp, dist2, idx);
-  return z;
+void zcvt_shell(const ZCVT *cvt, const double vmax, double *d2min,
+    double *d2max) {
+  *d2min = cvt->d2min;
+  *d2max = cvt->d2max;
+
+  /* Redshift range of objects that may be shifted into [zmin, zmax], with
+     zs = zr + v * (1 + zr) / c, and a margin for rounding errors. */
+  const double b = vmax / SPEED_OF_LIGHT + DOUBLE_TOL;
+  if (!(b < 1)) return;
+  const double zlo = (cvt->zmin - b) / (1 + b);
+  const double zhi = (cvt->zmax + b) / (1 - b);
+
+  /* Bisections, with the monotonicity of the interpolation. */
+  if (convert_z(cvt, *d2min) < zlo) {
+    double lo = *d2min;
+    double hi = *d2max;
+    for (int i = 0; i < CUTSKY_ZCNVT_SHELL_ITER; i++) {
+      const double mid = (lo + hi) * 0.5;
+      if (convert_z(cvt, mid) < zlo) lo = mid;
+      else hi = mid;
+    }
+    *d2min = lo;
+  }
+  if (convert_z(cvt, *d2max) > zhi) {
+    double lo = *d2min;
+    double hi = *d2max;
+    for (int i = 0; i < CUTSKY_ZCNVT_SHELL_ITER; i++) {
+      const double mid = (lo + hi) * 0.5;
+      if (convert_z(cvt, mid) > zhi) hi = mid;
+      else lo = mid;
+    }
+    *d2max = hi;
+  }
 }
 
 /******************************************************************************
@@ -357,5 +485,6 @@ void zcvt_destroy(ZCVT *cvt) {
   if (cvt->z) free(cvt->z);
   if (cvt->d2) free(cvt->d2);
   if (cvt->zpp) free(cvt->zpp);
+  if (cvt->idx) free(cvt->idx);
   free(cvt);
 }
@@ -32,6 +32,7 @@
 #define __CONVERT_Z_H__
 
 #include "load_conf.h"
+#include <math.h>
 
 /*============================================================================*\
                      Data structure for redshift conversion
@@ -48,6 +49,10 @@ typedef struct {
   double *z;            /* array for redshift values                */
   double *d2;           /* array for squared comoving distances     */
   double *zpp;          /* second derivative of redshift            */
+  int ncell;            /* number of cells for the uniform index    */
+  double dist0;         /* comoving distance of the first sample    */
+  double dinv;          /* inverse cell size of the uniform index   */
+  int *idx;             /* first sample in each cell, or NULL       */
 } ZCVT;
 
 
@@ -66,16 +71,102 @@ Return:
 ******************************************************************************/
 ZCVT *zcvt_init(const CONF *conf);
 
+/******************************************************************************
+Function `zcvt_spline`:
+  Evaluate the cubic spline interpolation of redshift on a given interval.
+Arguments:
+  * `cvt`:      structure for redshift conversion;
+  * `dist2`:    the input squared radial comoving distance;
+  * `i`:        index of the spline interval containing the distance.
+Return:
+  The corresponding redshift on success; HUGE_VAL on error.
+******************************************************************************/
+static inline double zcvt_spline(const ZCVT *cvt, const double dist2,
+    const int i) {
+  const double *x = cvt->d2;
+  const double *y = cvt->z;
+  const double *ypp = cvt->zpp;
+  const int j = i + 1;
+  const double ba = x[j] - x[i];
+  const double xa = dist2 - x[i];
+  const double bx = x[j] - dist2;
+  const double ba2 = ba * ba;
+  const double lower = xa * y[j] + bx * y[i];
+  const double c = (xa * xa - ba2) * xa * ypp[j];
+  const double d = (bx * bx - ba2) * bx * ypp[i];
+
+  /* 1/6 = 0x1.5555555555555p-3 */
+  const double z = (lower + 0x1.5555555555555p-3 * (c + d)) / ba;
+  return ((dist2 >= x[0]) & (dist2 <= x[cvt->n - 1])) ? z : HUGE_VAL;
+}
+
+/******************************************************************************
+Function `convert_z_index`:
+  Convert a squared radial comoving distance to redshift, with the spline
+  interval located through the uniform index in comoving distance, with a
+  fixed number of steps, so that the function is free of branches and can be
+  vectorized. It requires the index, i.e., `cvt->idx` is not NULL.
+Arguments:
+  * `cvt`:      structure for redshift conversion;
+  * `dist2`:    the input squared radial comoving distance.
+Return:
+  The corresponding redshift on success; HUGE_VAL on error.
+******************************************************************************/
+static inline double convert_z_index(const ZCVT *cvt, const double dist2) {
+  const double *x = cvt->d2;
+  const int n = cvt->n;
+
+  /* Locate the cell of the uniform index. */
+  double t = (sqrt(dist2) - cvt->dist0) * cvt->dinv;
+  t = (t >= 0) ? t : 0;         /* NaN is also mapped to the first cell */
+  t = (t > cvt->ncell - 1) ? cvt->ncell - 1 : t;
+  int i = cvt->idx[(int) t];
+
+  /* Move to the spline interval containing the distance. */
+  for (int k = 0; k < CUTSKY_ZCNVT_IDX_STEP; k++)
+    i += (i < n - 2) & (x[i + 1] <= dist2);
+
+  return zcvt_spline(cvt, dist2, i);
+}
+
 /******************************************************************************
 Function `convert_z`:
-  Convert a squared radial comoving distance to redshift.
+  Convert a squared radial comoving distance to redshift, through the uniform
+  index if it is available, or by bisecting the samples otherwise.
 Arguments:
   * `cvt`:      structure for redshift conversion;
   * `dist2`:    the input squared radial comoving distance.
 Return:
   The corresponding redshift on success; HUGE_VAL on error.
 ******************************************************************************/
-double convert_z(const ZCVT *cvt, const double dist2);
+static inline double convert_z(const ZCVT *cvt, const double dist2) {
+  if (cvt->idx) return convert_z_index(cvt, dist2);
+
+  /* Find the last sample not above the distance. */
+  const double *x = cvt->d2;
+  int l = 0, u = cvt->n - 2;
+  while (l < u) {
+    const int m = (l + u + 1) >> 1;
+    if (x[m] <= dist2) l = m;
+    else u = m - 1;
+  }
+  return zcvt_spline(cvt, dist2, l);
+}
+
+/******************************************************************************
+Function `zcvt_shell`:
+  Compute the range of squared comoving distances of objects that may be
+  shifted into the redshift range of interest by peculiar velocities, given
+  the maximum speed of the objects. The range is never wider than the one
+  for the maximum velocity of the redshift conversion.
+Arguments:
+  * `cvt`:      structure for redshift conversion;
+  * `vmax`:     the maximum speed of the objects;
+  * `d2min`:    the minimum squared distance of interest;
+  * `d2max`:    the maximum squared distance of interest.
+******************************************************************************/
+void zcvt_shell(const ZCVT *cvt, const double vmax, double *d2min,
+    double *d2max);
 
 /******************************************************************************
 Function `zcvt_destroy`:
@@ -17,13 +17,43 @@
 #include "proc_cat.h"
 #include <stdio.h>
 
+#ifdef MPI
+#include <mpi.h>
+
+/* Terminate all ranks on error, as the others may wait for collectives. */
+#define CUTSKY_QUIT(x)  do {                                            \
+  if (x) MPI_Abort(MPI_COMM_WORLD, x);                                  \
+  MPI_Finalize();                                                       \
+  return x;                                                             \
+} while (0)
+#else
+#define CUTSKY_QUIT(x)  return x
+#endif
+
 int main(int argc, char *argv[]) {
+#ifdef MPI
+  MPI_Init(&argc, &argv);
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  /* Only the root rank reports the progress. */
+  if (rank && !freopen("/dev/null", "w", stdout))
+    P_WRN("failed to suppress the standard output of rank %d\n", rank);
+#endif
+
   /* Load configuration. */
   CONF *conf;
   if (!(conf = load_conf(argc, argv))) {
     printf(FMT_FAIL);
     P_EXT("failed to load configuration parameters\n");
-    return CUTSKY_ERR_CFG;
+    CUTSKY_QUIT(CUTSKY_ERR_CFG);
+  }
+
+  /* Entries of the batch list share the setup with the first one. */
+  if (conf->nbatch && conf_batch(conf, 0)) {
+    printf(FMT_FAIL);
+    P_EXT("failed to setup the batch list\n");
+    conf_destroy(conf);
+    CUTSKY_QUIT(CUTSKY_ERR_CFG);
   }
 
   /* Prepare for redshift conversion. */
@@ -32,7 +62,7 @@ int main(int argc, char *argv[]) {
     printf(FMT_FAIL);
     P_EXT("failed to setup distance to redshift conversion\n");
     conf_destroy(conf);
-    return CUTSKY_ERR_ZCVT;
+    CUTSKY_QUIT(CUTSKY_ERR_ZCVT);
   }
 
   /* Prepare for survey geometry application. */
@@ -42,21 +72,56 @@ int main(int argc, char *argv[]) {
     P_EXT("failed to setup survey geometry\n");
     conf_destroy(conf);
     zcvt_destroy(zcvt);
-    return CUTSKY_ERR_GEOM;
+    CUTSKY_QUIT(CUTSKY_ERR_GEOM);
   }
 
   /* Run the cut-sky procedure. */
-  if (process(conf, zcvt, geom)) {
-    printf(FMT_FAIL);
-    P_EXT("failed to generate the cut-sky catalog\n");
-    conf_destroy(conf);
-    zcvt_destroy(zcvt);
-    geom_destroy(geom);
-    return CUTSKY_ERR_CUTSKY;
+  if (!conf->nbatch) {
+    if (process(conf, zcvt, geom, NULL)) {
+      printf(FMT_FAIL);
+      P_EXT("failed to generate the cut-sky catalog\n");
+      conf_destroy(conf);
+      zcvt_destroy(zcvt);
+      geom_destroy(geom);
+      CUTSKY_QUIT(CUTSKY_ERR_CUTSKY);
+    }
+  }
+  else {
+    /* Reuse the buffers for all entries of the batch list. */
+    PBUF *pbuf;
+    if (!(pbuf = pbuf_init(conf))) {
+      printf(FMT_FAIL);
+      P_EXT("failed to allocate memory for the batch list\n");
+      conf_destroy(conf);
+      zcvt_destroy(zcvt);
+      geom_destroy(geom);
+      CUTSKY_QUIT(CUTSKY_ERR_MEMORY);
+    }
+
+    for (int i = 0; i < conf->nbatch; i++) {
+      int ecode = conf_batch(conf, i) ? CUTSKY_ERR_CFG : 0;
+      if (!ecode) {
+        if (conf->fnz) geom_set_seed(geom, conf->seed, conf->ncat);
+        if (conf->verbose)
+          printf("Batch entry %d/%d: %s\n", i + 1, conf->nbatch, conf->input);
+        if (process(conf, zcvt, geom, pbuf)) ecode = CUTSKY_ERR_CUTSKY;
+      }
+      if (ecode) {
+        printf(FMT_FAIL);
+        P_EXT("failed to generate the cut-sky catalog for entry %d of the "
+            "batch list\n", i + 1);
+        pbuf_destroy(pbuf);
+        conf_destroy(conf);
+        zcvt_destroy(zcvt);
+        geom_destroy(geom);
+        CUTSKY_QUIT(ecode);
+      }
+    }
+    pbuf_destroy(pbuf);
   }
 
   conf_destroy(conf);
   zcvt_destroy(zcvt);
   geom_destroy(geom);
-  return 0;
+  CUTSKY_QUIT(0);
 }
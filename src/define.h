@@ -57,9 +57,14 @@
 #define DEFAULT_ASCII_COMMENT           '\0'
 #define DEFAULT_NDATA                   (-1)
 #define DEFAULT_DE_EOS_W                (-1)
-#define DEFAULT_RNG                     PRAND_RNG_MT19937
 #define DEFAULT_OVERWRITE               0
 #define DEFAULT_VERBOSE                 true
+#define DEFAULT_MASK_CACHE              false
+#define DEFAULT_INPUT_MMAP              false
+#define DEFAULT_INPUT_SPLIT             false
+#define DEFAULT_OUTPUT_STREAM           false
+#define DEFAULT_PRE_THINNING            false
+#define DEFAULT_NUM_SUBSAMPLE           1
 
 /* Priority of parameters from different sources. */
 #define CUTSKY_PRIOR_CMD                5
@@ -69,14 +74,21 @@
                             Definitions for file IO
 \*============================================================================*/
 #define CUTSKY_PATH_SEP         '/'     /* separator for file paths         */
+#define CUTSKY_MASK_CACHE_EXT   ".cache"        /* suffix of mask caches    */
 #define CUTSKY_FILE_CHUNK       4194304 /* chunk size for ASCII file IO     */
 #define CUTSKY_MAX_CHUNK        INT_MAX /* maximum allowed chunk size       */
+#define CUTSKY_MMAP_WINDOW      1073741824      /* window for memory mapping */
 #define CUTSKY_MAX_LINES        INT_MAX /* maximum line number read at once */
 #define CUTSKY_READ_COMMENT     '#'     /* comment symbol for reading       */
 #define CUTSKY_SAVE_COMMENT     '#'     /* comment symbol for writing       */
 #define CUTSKY_DATA_INIT_NUM    128     /* initial number of input data     */
 #define CUTSKY_SPACE_ESCAPE     '\\'    /* escape character for spaces      */
 #define CUTSKY_DATA_CHUNK       4096    /* number of data processed at once */
+#define CUTSKY_OMP_SUBCHUNK     512     /* number of data per OpenMP task   */
+#define CUTSKY_TRACER_NFIELD    4       /* number of fields for a tracer    */
+#define CUTSKY_OBSERVER_NFIELD  12      /* number of fields for an observer */
+#define CUTSKY_REGION_NFIELD    5       /* number of fields for a region    */
+#define CUTSKY_REGION_NOMASK    "-"     /* placeholder for no region mask   */
 
 /* Enumeration of formats for input files. */
 typedef enum {
@@ -97,12 +109,29 @@ typedef enum {
 #define CUTSKY_ZCNVT_ORDER      10      /* order for Gauss integration of z */
 #define CUTSKY_ZCNVT_EXT        10      /* number of bins extended on edges */
 #define CUTSKY_ZCNVT_MAX_V      3000    /* maximum peculiar velocity        */
+#define CUTSKY_ZCNVT_IDX_DENS   2       /* index cells per minimum spacing  */
+#define CUTSKY_ZCNVT_IDX_TOL    1e-3    /* relative margin of index cells   */
+#define CUTSKY_ZCNVT_IDX_STEP   2       /* maximum samples in an index cell */
+#define CUTSKY_ZCNVT_MAX_CELL   1048576 /* maximum number of index cells    */
+#define CUTSKY_ZCNVT_SHELL_ITER 40      /* bisections for the shell bounds  */
+#define CUTSKY_MAX_OBSERVER     4       /* maximum number of observers      */
+#define CUTSKY_ROTATION_TOL     1e-6    /* tolerance of rotation matrices   */
 
 /* Parameters for survey geometry */
 #define CUTSKY_BITCODE_INFOOT   1       /* code for inside the current foot */
 #define CUTSKY_BITCODE_RAD_SEL  2       /* code for passing n(z) selection  */
+#define CUTSKY_MAX_SUBSAMPLE    7       /* maximum number of subsamples     */
 #define CUTSKY_WMIN_FOOT_ALL    0       /* minimum weight for entire foot   */
 #define CUTSKY_WMIN_FOOT        0       /* minimum weight for current foot  */
+#define CUTSKY_MAX_TRACER       4       /* maximum number of tracers        */
+#define CUTSKY_MAX_REGION       8       /* maximum number of sky regions    */
+#define CUTSKY_REGION_RES       7       /* resolution of the region map     */
+#define CUTSKY_REGION_TOL       1e-9    /* margin of pixels in the map      */
+/* Maximum number of outputs, for all sky regions, tracers, and observers. */
+#define CUTSKY_MAX_NCAT         (CUTSKY_MAX_REGION * CUTSKY_MAX_TRACER *      \
+    CUTSKY_MAX_OBSERVER)
+/* Shift of right ascension for the box rotation. */
+#define CUTSKY_RA_SHIFT         60
 /* Right ascension range that distinguishes NGC and SGC. */
 #define DESI_NGC_RA_MIN         90
 #define DESI_NGC_RA_MAX         300
@@ -110,6 +139,13 @@ typedef enum {
 /* Threshold for throwing the warning of data number mismatch. */
 #define CUTSKY_NDATA_MISMATCH   0.1
 
+/* Hint for vectorizing loops over batches of objects. */
+#if defined(OMP) || defined(OMP_SIMD)
+#define CUTSKY_SIMD             _Pragma("omp simd")
+#else
+#define CUTSKY_SIMD
+#endif
+
 /*============================================================================*\
                      Definitions for the format of outputs
 \*============================================================================*/
@@ -136,6 +172,7 @@ typedef enum {
 #define CUTSKY_ERR_CUTSKY       (-10)
 #define CUTSKY_ERR_ASCII        (-11)
 #define CUTSKY_ERR_SAVE         (-12)
+#define CUTSKY_ERR_MPI          (-13)
 #define CUTSKY_ERR_UNKNOWN      (-99)
 
 /*============================================================================*\
@@ -13,7 +13,6 @@
 #include "define.h"
 #include "load_conf.h"
 #include "libcfg.h"
-#include "prand.h"
 #include "read_data.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -76,14 +75,22 @@ Generate the cutsky catalogue from a cubic mock catalogue.\n\
         Specify the configuration file (default: `%s')\n\
   -i, --input           " FMT_KEY(INPUT) "           String\n\
         Specify the filename of the input catalog\n\
+      --batch-list      " FMT_KEY(BATCH_LIST) "      String\n\
+        Specify the list of inputs, seeds, and outputs for multiple catalogs\n\
   -f, --input-format    " FMT_KEY(INPUT_FORMAT) "    Integer\n\
         Specify the format of the input catalog\n\
       --comment         " FMT_KEY(COMMENT) "         Character\n\
         Specify the comment symbol for ASCII-format input catalog\n\
+      --input-mmap      " FMT_KEY(INPUT_MMAP) "      Boolean\n\
+        Indicate whether to memory map the ASCII-format input catalog\n\
+      --input-split     " FMT_KEY(INPUT_SPLIT) "     Boolean\n\
+        Indicate whether to read byte ranges of the input in parallel\n\
   -b, --box             " FMT_KEY(BOX_SIZE) "        Double\n\
         Set the side length of the cubic simulation box\n\
   -n, --number          " FMT_KEY(NUMBER) "          Long integer\n\
         Set the number of objects in the input catalog\n\
+      --observer-list   " FMT_KEY(OBSERVER_LIST) "   String\n\
+        Specify the list of positions and rotations of observers\n\
   -m, --omega-m         " FMT_KEY(OMEGA_M) "         Double\n\
         Set the density parameter of matter at z = 0\n\
       --omega-l         " FMT_KEY(OMEGA_LAMBDA) "    Double\n\
@@ -96,22 +103,34 @@ Generate the cutsky catalogue from a cubic mock catalogue.\n\
         Set the Mangle polygon file for the footprint to be trimmed\n\
   -A, --foot-mark       " FMT_KEY(FOOTPRINT_MARK) "      String\n\
         Set the Mangle polygon file for the footprint to be marked\n\
+      --mask-cache      " FMT_KEY(MASK_CACHE) "      Boolean\n\
+        Indicate whether to use binary caches for the polygon files\n\
+      --mask-cache-dir  " FMT_KEY(MASK_CACHE_DIR) "  String\n\
+        Specify the directory for binary caches of the polygon files\n\
   -C, --cap             " FMT_KEY(GALACTIC_CAP) "    Character array\n\
         Specify the galactic caps ('N' or 'S') to be produced\n\
+      --region-list     " FMT_KEY(REGION_LIST) "     String\n\
+        Specify the list of sky regions to be produced instead of the caps\n\
   -N, --nz-file         " FMT_KEY(NZ_FILE) "         String\n\
         Specify the file for radial number density distribution\n\
   -z, --z-min           " FMT_KEY(ZMIN) "            Double\n\
         Set the minimum redshift of the output catalog\n\
   -Z, --z-max           " FMT_KEY(ZMAX) "            Double\n\
         Set the maximum redshift of the output catalog\n\
-  -r, --rng             " FMT_KEY(RAND_GENERATOR) "  Integer\n\
-        Specify the random number generation algorithm\n\
+      --tracer-list     " FMT_KEY(TRACER_LIST) "     String\n\
+        Specify the list of footprints, n(z), and redshift ranges of tracers\n\
   -s, --seed            " FMT_KEY(RAND_SEED) "       Long integer array\n\
         Set seeds for random number generation in different galactic caps\n\
+      --subsample       " FMT_KEY(NUM_SUBSAMPLE) "   Integer\n\
+        Set the number of independent subsamples of the radial selection\n\
+      --pre-thin        " FMT_KEY(PRE_THINNING) "    Boolean\n\
+        Indicate whether to discard objects never passing radial selection\n\
   -o, --output          " FMT_KEY(OUTPUT) "          String array\n\
         Specify the output catalogs for different galactic caps\n\
   -F, --output-format   " FMT_KEY(OUTPUT_FORMAT) "   Integer\n\
         Specify the format of output catalogs\n\
+      --output-stream   " FMT_KEY(OUTPUT_STREAM) "   Boolean\n\
+        Indicate whether to save objects on the fly in bounded memory\n\
   -w, --overwrite       " FMT_KEY(OVERWRITE) "       Integer\n\
         Indicate whether to overwrite existing output files\n\
   -v, --verbose         " FMT_KEY(VERBOSE) "         Boolean\n\
@@ -133,8 +152,6 @@ static void conf_template(void *args) {
 # Format: keyword = value # comment\n\
 #     or: keyword = [element1, element2]\n\
 #    see: https://github.com/cheng-zhao/libcfg for details.\n\
-# For supported random number generation algorithms, see\n\
-#         https://github.com/cheng-zhao/prand\n\
 # NOTE that command line options have priority over this file.\n\
 # Unnecessary entries can be left unset.\n\
 \n\
@@ -144,6 +161,14 @@ static void conf_template(void *args) {
 \n\
 INPUT           = \n\
     # String, filename of the input cubic simulation catalog.\n\
+BATCH_LIST      = \n\
+    # String, filename of an ASCII file for processing multiple catalogs with\n\
+    # the same settings. Each line lists `INPUT`, followed by `RAND_SEED` and\n\
+    # `OUTPUT` for all galactic caps (and tracers), separated by whitespaces,\n\
+    # e.g.\n\
+    # \"box.dat 1 2 ngc.dat sgc.dat\" with `GALACTIC_CAP` = [N,S].\n\
+    # If it is set, `INPUT`, `RAND_SEED`, and `OUTPUT` are omitted.\n\
+    # Lines starting with '%c' are omitted.\n\
 INPUT_FORMAT    = \n\
     # Integer, format of the input catalog (unset: %d). Allowed values are:\n\
     # * %d: ASCII file, with the leading 6 columns being (x,y,z,vx,vy,vz);\n\
@@ -153,6 +178,13 @@ INPUT_FORMAT    = \n\
 COMMENT         = \n\
     # Character, indicate comments of ASCII-format `INPUT` (unset: '%c%s.\n\
     # Empty character ('') means disabling comments.\n\
+INPUT_MMAP      = \n\
+    # Boolean option, indicate whether to read ASCII-format `INPUT` through\n\
+    # memory mapping, without copying the file content (unset: %c).\n\
+INPUT_SPLIT     = \n\
+    # Boolean option, indicate whether to split ASCII-format `INPUT` into\n\
+    # byte ranges that are read and processed by OpenMP threads in parallel\n\
+    # (unset: %c).\n\
 BOX_SIZE        = \n\
     # Double-precision number, side length of the periodic box.\n\
 NUMBER          = \n\
@@ -160,6 +192,16 @@ NUMBER          = \n\
     # If unset, the number will be read from file.\n\
     # It is used only if radial selection is enabled (when `NZ_FILE` is set).\n\
     # Set this to the number of data objects when generating a random catalog.\n\
+OBSERVER_LIST   = \n\
+    # String, filename of an ASCII file for generating catalogs of multiple\n\
+    # observers with a single pass of the input catalog. Each line lists the\n\
+    # position of an observer in the box, followed by the 9 elements of a\n\
+    # rotation matrix (row by row) applied to the observed directions,\n\
+    # separated by whitespaces. If it is unset, there is a single observer\n\
+    # at the origin without rotation. Otherwise `RAND_SEED` and `OUTPUT` list\n\
+    # all catalogs of the first observer, followed by those of the second\n\
+    # observer, etc. At most %d observers.\n\
+    # Lines starting with '%c' are omitted.\n\
 \n\n\
 ##################################################\n\
 #  Fiducial cosmology for coordinate conversion  #\n\
@@ -190,8 +232,26 @@ FOOTPRINT_MARK  = \n\
     # String, filename of the polygon file for the footprint to be marked.\n\
     # If set, objects inside this footprint will be indicated by bitcode %d\n\
     # in the \"STATUS\" column.\n\
+MASK_CACHE      = \n\
+    # Boolean option, indicate whether to use binary caches of the polygon\n\
+    # files, which are created at the first run, and memory mapped later on\n\
+    # as long as they are newer than the polygon files (unset: %c).\n\
+MASK_CACHE_DIR  = \n\
+    # String, directory for the binary caches of the polygon files.\n\
+    # If unset, caches are saved alongside the polygon files. Otherwise the\n\
+    # cache names contain a hash of the full paths of the polygon files.\n\
 GALACTIC_CAP    = \n\
     # Character array, 'N' for northern galactic cap and 'S' for southern cap.\n\
+REGION_LIST     = \n\
+    # String, filename of an ASCII file for splitting the outputs into sky\n\
+    # regions other than the galactic caps. Each line lists `RA_MIN`,\n\
+    # `RA_MAX`, `DEC_MIN`, and `DEC_MAX` (in degrees) of a region, followed\n\
+    # by a polygon file (or '%s' for none), separated by whitespaces.\n\
+    # Objects of a region are inside both the coordinate ranges and the\n\
+    # polygons, and regions may overlap. `RA_MIN` > `RA_MAX` indicates a\n\
+    # range across RA = 0. If it is set, `GALACTIC_CAP` is omitted, and the\n\
+    # regions take the place of galactic caps for `RAND_SEED` and `OUTPUT`.\n\
+    # At most %d regions. Lines starting with '%c' are omitted.\n\
 NZ_FILE         = \n\
     # String, filename of the ASCII file for the radial selection function.\n\
     # The first two columns must be (redshift, comoving number density).\n\
@@ -201,15 +261,32 @@ NZ_FILE         = \n\
 ZMIN            = \n\
 ZMAX            = \n\
     # Double-precision numbers, minimum and maximum redshifts of the outputs.\n\
-RAND_GENERATOR  = \n\
-    # Random number generation algorithm (unset: %d).\n\
-    # Integer, allowed values are:\n\
-    # * 0: MRG32k3a\n\
-    # * 1: Mersenne Twister 19937\n\
-    # See https://github.com/cheng-zhao/prand for details.\n\
+TRACER_LIST     = \n\
+    # String, filename of an ASCII file for generating catalogs of multiple\n\
+    # tracers with a single pass of the input catalog. Each line lists\n\
+    # `FOOTPRINT_TRIM`, `NZ_FILE`, `ZMIN`, and `ZMAX` of a tracer, separated\n\
+    # by whitespaces. If it is set, these four parameters are omitted, and\n\
+    # `RAND_SEED` and `OUTPUT` list all galactic caps of the first tracer,\n\
+    # followed by those of the second tracer, etc. At most %d tracers.\n\
+    # Lines starting with '%c' are omitted.\n\
 RAND_SEED       = \n\
     # Long integer array, random seeds for different galactic caps.\n\
-    # Same dimension as `GALACTIC_CAP`.\n\
+    # Random numbers for radial selection are determined by the seed, the\n\
+    # index of the input object, and the index of the box replica.\n\
+    # Same dimension as `GALACTIC_CAP`, for each tracer and observer.\n\
+NUM_SUBSAMPLE   = \n\
+    # Integer, number of independent random subsamples of the radial\n\
+    # selection (unset: %d), at most %d. The first subsample is drawn with\n\
+    # `RAND_SEED`, and the seeds of the others are derived from it. Objects\n\
+    # selected in the i-th subsample (i = 0, 1, ...) are indicated by\n\
+    # bitcode %d * 2^i in the \"STATUS\" column, while `RAN_NUM_0_1` is the\n\
+    # random number of the first subsample.\n\
+PRE_THINNING    = \n\
+    # Boolean option, indicate whether to discard objects that never pass the\n\
+    # radial selection before the footprint test (unset: %c).\n\
+    # It speeds up the generation of random catalogs. Only objects with\n\
+    # random numbers below the maximum selection probability are saved, and\n\
+    # the selected objects are the same as those without pre-thinning.\n\
 \n\n\
 ##############################\n\
 #  Settings for the outputs  #\n\
@@ -217,11 +294,18 @@ RAND_SEED       = \n\
 \n\
 OUTPUT          = \n\
     # String array, name of the output catalogues.\n\
-    # Same dimension as `GALACTIC_CAP`. One catalogue per galactic cap.\n\
+    # Same dimension as `GALACTIC_CAP`, for each tracer and observer.\n\
+    # One catalogue per galactic cap.\n\
 OUTPUT_FORMAT   = \n\
     # Integer, format of the output catalog (unset: %d). Allowed values are:\n\
     # * %d: ASCII file;\n\
     # * %d: FITS table.\n\
+OUTPUT_STREAM   = \n\
+    # Boolean option, indicate whether to select and save objects on the fly,\n\
+    # with a single pass of the input catalog (unset: %c).\n\
+    # With `NZ_FILE`, the number of objects in the box is taken from `NUMBER`\n\
+    # if it is set, and counted from the input catalog beforehand otherwise.\n\
+    # Rows are not ordered with multiple OpenMP threads.\n\
 OVERWRITE       = \n\
     # Integer, indicate whether to overwrite existing files (unset: %d).\n\
     # Allowed values are:\n\
@@ -230,12 +314,19 @@ OVERWRITE       = \n\
     # * negative: notify at most this number of times for existing files.\n\
 VERBOSE         = \n\
     # Boolean option, indicate whether to show detailed outputs (unset: %c).\n",
-  DEFAULT_CONF_FILE, DEFAULT_INPUT_FORMAT, CUTSKY_FFMT_ASCII, CUTSKY_FFMT_FITS,
+  DEFAULT_CONF_FILE, CUTSKY_READ_COMMENT, DEFAULT_INPUT_FORMAT,
+  CUTSKY_FFMT_ASCII, CUTSKY_FFMT_FITS,
   CUTSKY_FFMT_FITS_LIST, DEFAULT_ASCII_COMMENT ? DEFAULT_ASCII_COMMENT : '\'',
-  DEFAULT_ASCII_COMMENT ? "')" : ")", (double) DEFAULT_DE_EOS_W,
-  CUTSKY_READ_COMMENT, CUTSKY_BITCODE_INFOOT, CUTSKY_BITCODE_RAD_SEL,
-  CUTSKY_READ_COMMENT, DEFAULT_RNG, DEFAULT_OUTPUT_FORMAT,
-  CUTSKY_FFMT_ASCII, CUTSKY_FFMT_FITS, DEFAULT_OVERWRITE,
+  DEFAULT_ASCII_COMMENT ? "')" : ")", DEFAULT_INPUT_MMAP ? 'T' : 'F',
+  DEFAULT_INPUT_SPLIT ? 'T' : 'F', CUTSKY_MAX_OBSERVER, CUTSKY_READ_COMMENT,
+  (double) DEFAULT_DE_EOS_W,
+  CUTSKY_READ_COMMENT, CUTSKY_BITCODE_INFOOT, DEFAULT_MASK_CACHE ? 'T' : 'F',
+  CUTSKY_REGION_NOMASK, CUTSKY_MAX_REGION, CUTSKY_READ_COMMENT,
+  CUTSKY_BITCODE_RAD_SEL, CUTSKY_READ_COMMENT, CUTSKY_MAX_TRACER,
+  CUTSKY_READ_COMMENT, DEFAULT_NUM_SUBSAMPLE, CUTSKY_MAX_SUBSAMPLE,
+  CUTSKY_BITCODE_RAD_SEL, DEFAULT_PRE_THINNING ? 'T' : 'F',
+  DEFAULT_OUTPUT_FORMAT, CUTSKY_FFMT_ASCII, CUTSKY_FFMT_FITS,
+  DEFAULT_OUTPUT_STREAM ? 'T' : 'F', DEFAULT_OVERWRITE,
   DEFAULT_VERBOSE ? 'T' : 'F');
   exit(0);
 }
@@ -255,8 +346,19 @@ static CONF *conf_init(void) {
   CONF *conf = calloc(1, sizeof *conf);
   if (!conf) return NULL;
   conf->fconf = conf->input = conf->fzcnvt = conf->fnz = NULL;
-  conf->foot_all = conf->foot = NULL;
+  conf->fbatch = NULL;
+  conf->batch = NULL;
+  conf->bseed = NULL;
+  conf->fobs = NULL;
+  conf->obs = NULL;
+  conf->ftrc = NULL;
+  conf->trc = NULL;
+  conf->tzlim = NULL;
+  conf->foot_all = conf->foot = conf->mcdir = NULL;
   conf->gcap = NULL;
+  conf->freg = NULL;
+  conf->reg = NULL;
+  conf->rlim = NULL;
   conf->seed = NULL;
   conf->inputs = conf->output = NULL;
   return conf;
@@ -290,24 +392,34 @@ static cfg_t *conf_read(CONF *conf, const int argc, char *const *argv) {
   const cfg_param_t params[] = {
     {'c', "conf"         , "CONFIG_FILE"    , CFG_DTYPE_STR , &conf->fconf   },
     {'i', "input"        , "INPUT"          , CFG_DTYPE_STR , &conf->input   },
+    { 0 , "batch-list"   , "BATCH_LIST"     , CFG_DTYPE_STR , &conf->fbatch  },
     {'f', "input-format" , "INPUT_FORMAT"   , CFG_DTYPE_INT , &conf->ifmt    },
     { 0 , "comment"      , "COMMENT"        , CFG_DTYPE_CHAR, &conf->comment },
+    { 0 , "input-mmap"   , "INPUT_MMAP"     , CFG_DTYPE_BOOL, &conf->immap   },
+    { 0 , "input-split"  , "INPUT_SPLIT"    , CFG_DTYPE_BOOL, &conf->isplit  },
     {'b', "box"          , "BOX_SIZE"       , CFG_DTYPE_DBL , &conf->Lbox    },
     {'n', "number"       , "NUMBER"         , CFG_DTYPE_LONG, &conf->ndata   },
+    { 0 , "observer-list", "OBSERVER_LIST"  , CFG_DTYPE_STR , &conf->fobs    },
     {'m', "omega-m"      , "OMEGA_M"        , CFG_DTYPE_DBL , &conf->omega_m },
     { 0 , "omega-l"      , "OMEGA_LAMBDA"   , CFG_DTYPE_DBL , &conf->omega_l },
     { 0 , "de-w"         , "DE_EOS_W"       , CFG_DTYPE_DBL , &conf->eos_w   },
     { 0 , "cmvdst-file"  , "Z_CMVDST_CNVT"  , CFG_DTYPE_STR , &conf->fzcnvt  },
     {'a', "foot-trim"    , "FOOTPRINT_TRIM" , CFG_DTYPE_STR , &conf->foot_all},
     {'A', "foot-mark"    , "FOOTPRINT_MARK" , CFG_DTYPE_STR , &conf->foot    },
+    { 0 , "mask-cache"   , "MASK_CACHE"     , CFG_DTYPE_BOOL, &conf->mcache  },
+    { 0 , "mask-cache-dir","MASK_CACHE_DIR" , CFG_DTYPE_STR , &conf->mcdir   },
     {'C', "cap"          , "GALACTIC_CAP"   , CFG_ARRAY_CHAR, &conf->gcap    },
+    { 0 , "region-list"  , "REGION_LIST"    , CFG_DTYPE_STR , &conf->freg    },
     {'N', "nz-file"      , "NZ_FILE"        , CFG_DTYPE_STR , &conf->fnz     },
     {'z', "z-min"        , "ZMIN"           , CFG_DTYPE_DBL , &conf->zmin    },
     {'Z', "z-max"        , "ZMAX"           , CFG_DTYPE_DBL , &conf->zmax    },
-    {'r', "rng"          , "RAND_GENERATOR" , CFG_DTYPE_INT , &conf->rng     },
+    { 0 , "tracer-list"  , "TRACER_LIST"    , CFG_DTYPE_STR , &conf->ftrc    },
     {'s', "seed"         , "RAND_SEED"      , CFG_ARRAY_LONG, &conf->seed    },
+    { 0 , "subsample"    , "NUM_SUBSAMPLE"  , CFG_DTYPE_INT , &conf->nsub    },
+    { 0 , "pre-thin"     , "PRE_THINNING"   , CFG_DTYPE_BOOL, &conf->thin    },
     {'o', "output"       , "OUTPUT"         , CFG_ARRAY_STR , &conf->output  },
     {'F', "output-format", "OUTPUT_FORMAT"  , CFG_DTYPE_INT , &conf->ofmt    },
+    { 0 , "output-stream", "OUTPUT_STREAM"  , CFG_DTYPE_BOOL, &conf->ostream },
     {'w', "overwrite"    , "OVERWRITE"      , CFG_DTYPE_INT , &conf->ovwrite },
     {'v', "verbose"      , "VERBOSE"        , CFG_DTYPE_BOOL, &conf->verbose }
   };
@@ -481,6 +593,313 @@ static int check_cosmo(const cfg_t *cfg, CONF *conf) {
   return 0;
 }
 
+/******************************************************************************
+Function `conf_inputs`:
+  Setup the list of FITS-format input catalogs given `INPUT`.
+Arguments:
+  * `conf`:     structure for storing configurations.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int conf_inputs(CONF *conf) {
+#ifdef WITH_CFITSIO
+  if (conf->inputs) {
+    if (*(conf->inputs)) free(*(conf->inputs));
+    free(conf->inputs);
+    conf->inputs = NULL;
+  }
+
+  if (conf->ifmt == CUTSKY_FFMT_FITS) {
+    /* Allocate memory for the list anyway. */
+    if (!(conf->inputs = malloc(sizeof(char *)))) {
+      P_ERR("failed to allocate memory for the input catalog\n");
+      return CUTSKY_ERR_MEMORY;
+    }
+    size_t len = strlen(conf->input) + 1;
+    if (!(conf->inputs[0] = malloc(sizeof(char) * len))) {
+      P_ERR("failed to allocate memory for the input catalog\n");
+      return CUTSKY_ERR_MEMORY;
+    }
+    strncpy(conf->inputs[0], conf->input, len);
+    conf->ninput = 1;
+  }
+  else if (conf->ifmt == CUTSKY_FFMT_FITS_LIST) {
+    /* Read filenames from list. */
+    if (read_filelist(conf->input, &conf->inputs, &conf->ninput))
+      return CUTSKY_ERR_FILE;
+
+    int e;
+    for (int i = 0; i < conf->ninput; i++) {
+      if ((e = check_input(conf->inputs[i], "INPUT"))) return e;
+    }
+  }
+#else
+  (void) conf;
+#endif
+  return 0;
+}
+
+/******************************************************************************
+Function `check_batch`:
+  Read and verify entries of the batch list.
+Arguments:
+  * `cfg`:      interface of libcfg;
+  * `conf`:     structure for storing configurations.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int check_batch(const cfg_t *cfg, CONF *conf) {
+  /* Omit the parameters superseded by the batch list. */
+  if (cfg_is_set(cfg, &conf->input)) {
+    P_WRN(FMT_KEY(INPUT) " is omitted with " FMT_KEY(BATCH_LIST) "\n");
+    free(conf->input);
+  }
+  if (cfg_is_set(cfg, &conf->seed)) {
+    P_WRN(FMT_KEY(RAND_SEED) " is omitted with " FMT_KEY(BATCH_LIST) "\n");
+    free(conf->seed);
+  }
+  if (cfg_is_set(cfg, &conf->output)) {
+    P_WRN(FMT_KEY(OUTPUT) " is omitted with " FMT_KEY(BATCH_LIST) "\n");
+    if (*(conf->output)) free(*(conf->output));
+    free(conf->output);
+  }
+  conf->input = NULL;
+  conf->seed = NULL;
+  conf->output = NULL;
+
+  /* Each entry consists of INPUT, RAND_SEED and OUTPUT for all catalogs. */
+  const int nfield = 1 + 2 * conf->ncat;
+  if (read_fieldlist(conf->fbatch, nfield, &conf->batch, &conf->nbatch))
+    return CUTSKY_ERR_FILE;
+  if (!(conf->bseed = malloc(sizeof(long) * conf->nbatch * conf->ncat))) {
+    P_ERR("failed to allocate memory for the batch list\n");
+    return CUTSKY_ERR_MEMORY;
+  }
+
+  int e;
+  for (int i = 0; i < conf->nbatch; i++) {
+    char **entry = conf->batch + (size_t) i * nfield;
+    if ((e = check_input(entry[0], "BATCH_LIST"))) return e;
+    for (int j = 0; j < conf->ncat; j++) {
+      char *end;
+      long seed = strtol(entry[1 + j], &end, 10);
+      if (*end != '\0' || seed <= 0) {
+        P_ERR("invalid seed in " FMT_KEY(BATCH_LIST) ": `%s'\n",
+            entry[1 + j]);
+        return CUTSKY_ERR_CFG;
+      }
+      conf->bseed[(size_t) i * conf->ncat + j] = seed;
+    }
+    for (int j = 0; j < conf->ncat; j++) {
+      if ((e = check_output(entry[1 + conf->ncat + j], "BATCH_LIST",
+          conf->ovwrite))) return e;
+    }
+  }
+  return 0;
+}
+
+/******************************************************************************
+Function `check_observer`:
+  Read and verify entries of the observer list.
+Arguments:
+  * `conf`:     structure for storing configurations.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int check_observer(CONF *conf) {
+  /* Each entry consists of the position and the rotation matrix. */
+  char **list = NULL;
+  if (read_fieldlist(conf->fobs, CUTSKY_OBSERVER_NFIELD, &list, &conf->nobs))
+    return CUTSKY_ERR_FILE;
+  if (conf->nobs > CUTSKY_MAX_OBSERVER) {
+    P_ERR("at most %d observers in " FMT_KEY(OBSERVER_LIST) "\n",
+        CUTSKY_MAX_OBSERVER);
+    free(*list); free(list);
+    return CUTSKY_ERR_CFG;
+  }
+  const size_t num = (size_t) conf->nobs * CUTSKY_OBSERVER_NFIELD;
+  if (!(conf->obs = malloc(sizeof(double) * num))) {
+    P_ERR("failed to allocate memory for the observer list\n");
+    free(*list); free(list);
+    return CUTSKY_ERR_MEMORY;
+  }
+  for (size_t i = 0; i < num; i++) {
+    char *end;
+    conf->obs[i] = strtod(list[i], &end);
+    if (*end != '\0') {
+      P_ERR("invalid number in " FMT_KEY(OBSERVER_LIST) ": `%s'\n", list[i]);
+      free(*list); free(list);
+      return CUTSKY_ERR_CFG;
+    }
+  }
+  free(*list); free(list);
+
+  for (int i = 0; i < conf->nobs; i++) {
+    const double *pos = conf->obs + (size_t) i * CUTSKY_OBSERVER_NFIELD;
+    const double *rot = pos + 3;
+
+    /* Observers are inside the periodic box. */
+    for (int k = 0; k < 3; k++) {
+      if (pos[k] < 0 || pos[k] >= conf->Lbox) {
+        P_ERR("position of observer %d must be in [0, " FMT_KEY(BOX_SIZE)
+            ") in " FMT_KEY(OBSERVER_LIST) "\n", i + 1);
+        return CUTSKY_ERR_CFG;
+      }
+    }
+
+    /* Rotation matrices are orthonormal, without reflection. */
+    bool valid = true;
+    for (int j = 0; j < 3; j++) {
+      for (int k = 0; k < 3; k++) {
+        const double dot = rot[3 * j] * rot[3 * k] +
+            rot[3 * j + 1] * rot[3 * k + 1] + rot[3 * j + 2] * rot[3 * k + 2];
+        if (fabs(dot - (j == k)) > CUTSKY_ROTATION_TOL) valid = false;
+      }
+    }
+    const double det = rot[0] * (rot[4] * rot[8] - rot[5] * rot[7]) -
+        rot[1] * (rot[3] * rot[8] - rot[5] * rot[6]) +
+        rot[2] * (rot[3] * rot[7] - rot[4] * rot[6]);
+    if (!valid || det <= 0) {
+      P_ERR("invalid rotation matrix of observer %d in "
+          FMT_KEY(OBSERVER_LIST) "\n", i + 1);
+      return CUTSKY_ERR_CFG;
+    }
+  }
+  return 0;
+}
+
+/******************************************************************************
+Function `check_tracer`:
+  Read and verify entries of the tracer list.
+Arguments:
+  * `cfg`:      interface of libcfg;
+  * `conf`:     structure for storing configurations.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int check_tracer(const cfg_t *cfg, CONF *conf) {
+  /* Omit the parameters superseded by the tracer list. */
+  if (cfg_is_set(cfg, &conf->foot_all)) {
+    P_WRN(FMT_KEY(FOOTPRINT_TRIM) " is omitted with " FMT_KEY(TRACER_LIST)
+        "\n");
+    free(conf->foot_all);
+  }
+  if (cfg_is_set(cfg, &conf->fnz)) {
+    P_WRN(FMT_KEY(NZ_FILE) " is omitted with " FMT_KEY(TRACER_LIST) "\n");
+    free(conf->fnz);
+  }
+  if (cfg_is_set(cfg, &conf->zmin) || cfg_is_set(cfg, &conf->zmax)) {
+    P_WRN(FMT_KEY(ZMIN) " and " FMT_KEY(ZMAX) " are omitted with "
+        FMT_KEY(TRACER_LIST) "\n");
+  }
+  conf->foot_all = conf->fnz = NULL;
+
+  /* Each entry consists of FOOTPRINT_TRIM, NZ_FILE, ZMIN, and ZMAX. */
+  if (read_fieldlist(conf->ftrc, CUTSKY_TRACER_NFIELD, &conf->trc,
+      &conf->ntrc)) return CUTSKY_ERR_FILE;
+  if (conf->ntrc > CUTSKY_MAX_TRACER) {
+    P_ERR("at most %d tracers in " FMT_KEY(TRACER_LIST) "\n",
+        CUTSKY_MAX_TRACER);
+    return CUTSKY_ERR_CFG;
+  }
+  if (!(conf->tzlim = malloc(sizeof(double) * 2 * conf->ntrc))) {
+    P_ERR("failed to allocate memory for the tracer list\n");
+    return CUTSKY_ERR_MEMORY;
+  }
+
+  int e;
+  for (int i = 0; i < conf->ntrc; i++) {
+    char **entry = conf->trc + (size_t) i * CUTSKY_TRACER_NFIELD;
+    if ((e = check_input(entry[0], "TRACER_LIST")) ||
+        (e = check_input(entry[1], "TRACER_LIST"))) return e;
+    for (int j = 0; j < 2; j++) {
+      char *end;
+      conf->tzlim[2 * i + j] = strtod(entry[2 + j], &end);
+      if (*end != '\0') {
+        P_ERR("invalid redshift in " FMT_KEY(TRACER_LIST) ": `%s'\n",
+            entry[2 + j]);
+        return CUTSKY_ERR_CFG;
+      }
+    }
+    const double zmin = conf->tzlim[2 * i];
+    const double zmax = conf->tzlim[2 * i + 1];
+    if (zmin < 0 || zmin >= zmax) {
+      P_ERR("ZMIN must be >= 0 and < ZMAX in " FMT_KEY(TRACER_LIST) "\n");
+      return CUTSKY_ERR_CFG;
+    }
+
+    /* The redshift range of interest covers all tracers. */
+    if (!i || zmin < conf->zmin) conf->zmin = zmin;
+    if (!i || zmax > conf->zmax) conf->zmax = zmax;
+  }
+
+  /* Radial selection is applied to all tracers. */
+  conf->fnz = conf->trc[1];
+  return 0;
+}
+
+/******************************************************************************
+Function `check_region`:
+  Read and verify entries of the sky region list.
+Arguments:
+  * `cfg`:      interface of libcfg;
+  * `conf`:     structure for storing configurations.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int check_region(const cfg_t *cfg, CONF *conf) {
+  /* Omit the galactic caps superseded by the region list. */
+  if (cfg_is_set(cfg, &conf->gcap)) {
+    P_WRN(FMT_KEY(GALACTIC_CAP) " is omitted with " FMT_KEY(REGION_LIST)
+        "\n");
+    free(conf->gcap);
+  }
+  conf->gcap = NULL;
+  conf->ncap = 0;
+
+  /* Each entry consists of RA_MIN, RA_MAX, DEC_MIN, DEC_MAX, and polygons. */
+  if (read_fieldlist(conf->freg, CUTSKY_REGION_NFIELD, &conf->reg,
+      &conf->nreg)) return CUTSKY_ERR_FILE;
+  if (conf->nreg > CUTSKY_MAX_REGION) {
+    P_ERR("at most %d regions in " FMT_KEY(REGION_LIST) "\n",
+        CUTSKY_MAX_REGION);
+    return CUTSKY_ERR_CFG;
+  }
+  if (!(conf->rlim = malloc(sizeof(double) * 4 * conf->nreg))) {
+    P_ERR("failed to allocate memory for the region list\n");
+    return CUTSKY_ERR_MEMORY;
+  }
+
+  int e;
+  for (int i = 0; i < conf->nreg; i++) {
+    char **entry = conf->reg + (size_t) i * CUTSKY_REGION_NFIELD;
+    double *lim = conf->rlim + 4 * i;
+    for (int j = 0; j < 4; j++) {
+      char *end;
+      lim[j] = strtod(entry[j], &end);
+      if (*end != '\0') {
+        P_ERR("invalid coordinate in " FMT_KEY(REGION_LIST) ": `%s'\n",
+            entry[j]);
+        return CUTSKY_ERR_CFG;
+      }
+    }
+    if (lim[0] < 0 || lim[0] >= 360 || lim[1] <= 0 || lim[1] > 360 ||
+        lim[0] == lim[1]) {
+      P_ERR("RA_MIN must be in [0,360), and RA_MAX must be in (0,360] and "
+          "differ from RA_MIN in " FMT_KEY(REGION_LIST) "\n");
+      return CUTSKY_ERR_CFG;
+    }
+    if (lim[2] < -90 || lim[2] >= lim[3] || lim[3] > 90) {
+      P_ERR("DEC_MIN must be >= -90 and < DEC_MAX, and DEC_MAX must be "
+          "<= 90 in " FMT_KEY(REGION_LIST) "\n");
+      return CUTSKY_ERR_CFG;
+    }
+    if (strcmp(entry[4], CUTSKY_REGION_NOMASK) &&
+        (e = check_input(entry[4], "REGION_LIST"))) return e;
+  }
+  return 0;
+}
+
 /******************************************************************************
 Function `conf_verify`:
   Verify configuration parameters.
@@ -493,9 +912,15 @@ Return:
 static int conf_verify(const cfg_t *cfg, CONF *conf) {
   int e;
 
-  /* Check INPUT. */
-  CHECK_EXIST_PARAM(INPUT, cfg, &conf->input);
-  if ((e = check_input(conf->input, "INPUT"))) return e;
+  /* Check INPUT, which is superseded by BATCH_LIST. */
+  const bool batch = cfg_is_set(cfg, &conf->fbatch);
+  if (batch) {
+    if ((e = check_input(conf->fbatch, "BATCH_LIST"))) return e;
+  }
+  else {
+    CHECK_EXIST_PARAM(INPUT, cfg, &conf->input);
+    if ((e = check_input(conf->input, "INPUT"))) return e;
+  }
 
   /* Check INPUT_FORMAT. */
   if (!cfg_is_set(cfg, &conf->ifmt)) conf->ifmt = DEFAULT_INPUT_FORMAT;
@@ -504,21 +929,13 @@ static int conf_verify(const cfg_t *cfg, CONF *conf) {
       /* Check COMMENT. */
       if (!cfg_is_set(cfg, &conf->comment))
         conf->comment = DEFAULT_ASCII_COMMENT;
+      /* Check INPUT_MMAP. */
+      if (!cfg_is_set(cfg, &conf->immap)) conf->immap = DEFAULT_INPUT_MMAP;
+      /* Check INPUT_SPLIT. */
+      if (!cfg_is_set(cfg, &conf->isplit)) conf->isplit = DEFAULT_INPUT_SPLIT;
       break;
     case CUTSKY_FFMT_FITS:
 #ifdef WITH_CFITSIO
-      /* Allocate memory for the list anyway. */
-      if (!(conf->inputs = malloc(sizeof(char *)))) {
-        P_ERR("failed to allocate memory for the input catalog\n");
-        return CUTSKY_ERR_MEMORY;
-      }
-      size_t len = strlen(conf->input) + 1;
-      if (!(conf->inputs[0] = malloc(sizeof(char) * len))) {
-        P_ERR("failed to allocate memory for the input catalog\n");
-        return CUTSKY_ERR_MEMORY;
-      }
-      strncpy(conf->inputs[0], conf->input, len);
-      conf->ninput = 1;
       break;
 #else
       P_ERR("FITS format is not enabled\n"
@@ -527,15 +944,6 @@ static int conf_verify(const cfg_t *cfg, CONF *conf) {
 #endif
     case CUTSKY_FFMT_FITS_LIST:
 #ifdef WITH_CFITSIO
-      /* Read filenames from list. */
-      if (conf->ifmt == CUTSKY_FFMT_FITS_LIST) {
-        if (read_filelist(conf->input, &conf->inputs, &conf->ninput))
-          return CUTSKY_ERR_FILE;
-
-        for (int i = 0; i < conf->ninput; i++) {
-          if ((e = check_input(conf->inputs[i], "INPUT"))) return e;
-        }
-      }
       break;
 #else
       P_ERR("FITS format is not enabled\n"
@@ -546,6 +954,8 @@ static int conf_verify(const cfg_t *cfg, CONF *conf) {
       P_ERR("invalid " FMT_KEY(INPUT_FORMAT) ": %d\n", conf->ifmt);
       return CUTSKY_ERR_CFG;
   }
+  /* Inputs of the batch list are set up before processing each entry. */
+  if (!batch && (e = conf_inputs(conf))) return e;
 
   /* Check BOX_SIZE. */
   CHECK_EXIST_PARAM(BOX_SIZE, cfg, &conf->Lbox);
@@ -554,96 +964,149 @@ static int conf_verify(const cfg_t *cfg, CONF *conf) {
     return CUTSKY_ERR_CFG;
   }
 
+  /* Check OBSERVER_LIST. */
+  if (cfg_is_set(cfg, &conf->fobs)) {
+    if ((e = check_input(conf->fobs, "OBSERVER_LIST")) ||
+        (e = check_observer(conf))) return e;
+  }
+  else conf->nobs = 1;
+
   /* Check the fidual cosmology */
   if (cfg_is_set(cfg, &conf->fzcnvt)) {
     if ((e = check_input(conf->fzcnvt, "Z_CMVDST_CNVT"))) return e;
   }
   else if ((e = check_cosmo(cfg, conf))) return e;
 
-  /* Check FOOTPRINT_TRIM. */
-  CHECK_EXIST_PARAM(FOOTPRINT_TRIM, cfg, &conf->foot_all);
-  if ((e = check_input(conf->foot_all, "FOOTPRINT_TRIM"))) return e;
+  /* Check TRACER_LIST, or FOOTPRINT_TRIM. */
+  const bool tracer = cfg_is_set(cfg, &conf->ftrc);
+  if (tracer) {
+    if ((e = check_input(conf->ftrc, "TRACER_LIST")) ||
+        (e = check_tracer(cfg, conf))) return e;
+  }
+  else {
+    CHECK_EXIST_PARAM(FOOTPRINT_TRIM, cfg, &conf->foot_all);
+    if ((e = check_input(conf->foot_all, "FOOTPRINT_TRIM"))) return e;
+    conf->ntrc = 1;
+  }
 
   /* Check FOOTPRINT_MASK. */
   if (cfg_is_set(cfg, &conf->foot)) {
     if ((e = check_input(conf->foot, "FOOTPRINT_MASK"))) return e;
   }
 
-  /* Check GALACTIC_CAP. */
-  CHECK_EXIST_ARRAY(GALACTIC_CAP, cfg, &conf->gcap, conf->ncap);
-  if (conf->ncap > 2) {
-    P_ERR("at most 2 elements for " FMT_KEY(GALACTIC_CAP) "\n");
-    return CUTSKY_ERR_CFG;
+  /* Check MASK_CACHE and MASK_CACHE_DIR. */
+  if (!cfg_is_set(cfg, &conf->mcache)) conf->mcache = DEFAULT_MASK_CACHE;
+  if (conf->mcache && cfg_is_set(cfg, &conf->mcdir)) {
+    if (access(conf->mcdir, W_OK | X_OK)) {
+      P_ERR("cannot write to " FMT_KEY(MASK_CACHE_DIR) ": `%s'\n",
+          conf->mcdir);
+      return CUTSKY_ERR_FILE;
+    }
   }
-  for (int i = 0; i < conf->ncap; i++) {
-    if (conf->gcap[i] != 'N' && conf->gcap[i] != 'S') {
-      P_ERR(FMT_KEY(GALACTIC_CAP) " must be 'N' or 'S'\n");
+
+  /* Check REGION_LIST, or GALACTIC_CAP. */
+  const bool region = cfg_is_set(cfg, &conf->freg);
+  if (region) {
+    if ((e = check_input(conf->freg, "REGION_LIST")) ||
+        (e = check_region(cfg, conf))) return e;
+  }
+  else {
+    CHECK_EXIST_ARRAY(GALACTIC_CAP, cfg, &conf->gcap, conf->ncap);
+    if (conf->ncap > 2) {
+      P_ERR("at most 2 elements for " FMT_KEY(GALACTIC_CAP) "\n");
       return CUTSKY_ERR_CFG;
     }
+    for (int i = 0; i < conf->ncap; i++) {
+      if (conf->gcap[i] != 'N' && conf->gcap[i] != 'S') {
+        P_ERR(FMT_KEY(GALACTIC_CAP) " must be 'N' or 'S'\n");
+        return CUTSKY_ERR_CFG;
+      }
+    }
+    if (conf->ncap == 2 && conf->gcap[0] == conf->gcap[1]) {
+      P_ERR("duplicate " FMT_KEY(GALACTIC_CAP) " element: '%c'\n",
+          conf->gcap[0]);
+      return CUTSKY_ERR_CFG;
+    }
+    conf->nreg = conf->ncap;
   }
-  if (conf->ncap == 2 && conf->gcap[0] == conf->gcap[1]) {
-    P_ERR("duplicate " FMT_KEY(GALACTIC_CAP) " element: '%c'\n", conf->gcap[0]);
-    return CUTSKY_ERR_CFG;
-  }
+  conf->ncat = conf->nobs * conf->ntrc * conf->nreg;
 
-  /* Check NZ_FILE. */
-  if (cfg_is_set(cfg, &conf->fnz)) {
-    if ((e = check_input(conf->fnz, "NZ_FILE"))) return e;
+  /* Check NZ_FILE, which is given by TRACER_LIST for multiple tracers. */
+  if (tracer || cfg_is_set(cfg, &conf->fnz)) {
+    if (!tracer && (e = check_input(conf->fnz, "NZ_FILE"))) return e;
 
     /* Check NUMBER. */
     if (!cfg_is_set(cfg, &conf->ndata)) conf->ndata = DEFAULT_NDATA;
 
-    /* Check RAND_GENERATOR. */
-    if (!cfg_is_set(cfg, &conf->rng)) conf->rng = DEFAULT_RNG;
-    switch (conf->rng) {
-      case PRAND_RNG_MT19937:
-      case PRAND_RNG_MRG32K3A:
-        break;
-      default:
-        P_ERR("invalid " FMT_KEY(RAND_GENERATOR) ": %d\n", conf->rng);
-        return CUTSKY_ERR_CFG;
-    }
-
     /* Check RAND_SEED. */
-    int num = cfg_get_size(cfg, &conf->seed);
-    if (num < conf->ncap) {
+    int num = batch ? conf->ncat : cfg_get_size(cfg, &conf->seed);
+    if (num < conf->ncat) {
       P_ERR("too few elements of " FMT_KEY(RAND_SEED) "\n");
       return CUTSKY_ERR_CFG;
     }
-    if (num > conf->ncap) {
+    if (num > conf->ncat) {
       P_WRN("omitting the following " FMT_KEY(RAND_SEED) ":");
-      for (int i = conf->ncap; i < num; i++)
+      for (int i = conf->ncat; i < num; i++)
         fprintf(stderr, " %ld", conf->seed[i]);
       fprintf(stderr, "\n");
     }
-    for (int i = 0; i < conf->ncap; i++) {
-      if (conf->seed <= 0) {
+    for (int i = 0; !batch && i < conf->ncat; i++) {
+      if (conf->seed[i] <= 0) {
         P_ERR(FMT_KEY(RAND_SEED) " must be > 0\n");
         return CUTSKY_ERR_CFG;
       }
     }
+
+    /* Check NUM_SUBSAMPLE. */
+    if (!cfg_is_set(cfg, &conf->nsub)) conf->nsub = DEFAULT_NUM_SUBSAMPLE;
+    else if (conf->nsub <= 0 || conf->nsub > CUTSKY_MAX_SUBSAMPLE) {
+      P_ERR(FMT_KEY(NUM_SUBSAMPLE) " must be > 0 and <= %d\n",
+          CUTSKY_MAX_SUBSAMPLE);
+      return CUTSKY_ERR_CFG;
+    }
+
+    /* Check PRE_THINNING. */
+    if (!cfg_is_set(cfg, &conf->thin)) conf->thin = DEFAULT_PRE_THINNING;
+  }
+  else {
+    conf->fnz = NULL;
+    conf->nsub = 0;
+    conf->thin = false;
   }
-  else conf->fnz = NULL;
 
   /* Check ZMIN and ZMAX. */
-  CHECK_EXIST_PARAM(ZMIN, cfg, &conf->zmin);
-  CHECK_EXIST_PARAM(ZMAX, cfg, &conf->zmax);
-  if (conf->zmin < 0 || conf->zmin >= conf->zmax) {
-    P_ERR(FMT_KEY(ZMIN) " must be >= 0 and < " FMT_KEY(ZMAX) "\n");
-    return CUTSKY_ERR_CFG;
+  if (!tracer) {
+    CHECK_EXIST_PARAM(ZMIN, cfg, &conf->zmin);
+    CHECK_EXIST_PARAM(ZMAX, cfg, &conf->zmax);
+    if (conf->zmin < 0 || conf->zmin >= conf->zmax) {
+      P_ERR(FMT_KEY(ZMIN) " must be >= 0 and < " FMT_KEY(ZMAX) "\n");
+      return CUTSKY_ERR_CFG;
+    }
   }
 
   /* Check OVERWRITE. */
   if (!cfg_is_set(cfg, &conf->ovwrite)) conf->ovwrite = DEFAULT_OVERWRITE;
 
-  /* Check OUTPUT. */
-  if (cfg_get_size(cfg, &conf->output) != conf->ncap) {
-    P_ERR("Lengths of " FMT_KEY(GALACTIC_CAP) " and " FMT_KEY(OUTPUT)
-        " must be equal\n");
-    return CUTSKY_ERR_CFG;
+  /* Check BATCH_LIST, or OUTPUT. */
+  if (batch) {
+    if ((e = check_batch(cfg, conf))) return e;
   }
-  for (int i = 0; i < conf->ncap; i++) {
-    if ((e = check_output(conf->output[i], "OUTPUT", conf->ovwrite))) return e;
+  else {
+    if (cfg_get_size(cfg, &conf->output) != conf->ncat) {
+      if (region) P_ERR("Length of " FMT_KEY(OUTPUT) " must be %d, for all "
+          "regions of " FMT_KEY(REGION_LIST) ", tracers, and observers\n",
+          conf->ncat);
+      else if (tracer) P_ERR("Length of " FMT_KEY(OUTPUT) " must be the "
+          "product of those of " FMT_KEY(GALACTIC_CAP) " and "
+          FMT_KEY(TRACER_LIST) "\n");
+      else P_ERR("Lengths of " FMT_KEY(GALACTIC_CAP) " and " FMT_KEY(OUTPUT)
+          " must be equal\n");
+      return CUTSKY_ERR_CFG;
+    }
+    for (int i = 0; i < conf->ncat; i++) {
+      if ((e = check_output(conf->output[i], "OUTPUT", conf->ovwrite)))
+        return e;
+    }
   }
 
   /* Check OUTPUT_FORMAT. */
@@ -664,6 +1127,9 @@ static int conf_verify(const cfg_t *cfg, CONF *conf) {
       return CUTSKY_ERR_CFG;
   }
 
+  /* Check OUTPUT_STREAM. */
+  if (!cfg_is_set(cfg, &conf->ostream)) conf->ostream = DEFAULT_OUTPUT_STREAM;
+
   /* Check VERBOSE. */
   if (!cfg_is_set(cfg, &conf->verbose)) conf->verbose = DEFAULT_VERBOSE;
 
@@ -697,16 +1163,22 @@ static void conf_print(const CONF *conf) {
     printf("\n  CONFIG_FILE     = %s", DEFAULT_CONF_FILE);
 
   /* Input settings. */
-  printf("\n  INPUT           = %s", conf->input);
+  if (conf->batch) printf("\n  BATCH_LIST      = %s (%d entries)",
+      conf->fbatch, conf->nbatch);
+  else printf("\n  INPUT           = %s", conf->input);
   const char *fmt_name[3] = {"ASCII", "FITS", "FITS_LIST"};
   printf("\n  INPUT_FORMAT    = %d (%s)", conf->ifmt, fmt_name[conf->ifmt]);
   if (conf->ifmt == CUTSKY_FFMT_ASCII) {
     if (conf->comment == '\0') printf("\n  COMMENT         = ''");
     else printf("\n  COMMENT         = '%c'", conf->comment);
+    printf("\n  INPUT_MMAP      = %c", conf->immap ? 'T' : 'F');
+    printf("\n  INPUT_SPLIT     = %c", conf->isplit ? 'T' : 'F');
   }
   printf("\n  BOX_SIZE        = " OFMT_DBL, conf->Lbox);
   if (conf->fnz && conf->ndata != DEFAULT_NDATA)
     printf("\n  NUMBER          = %ld", conf->ndata);
+  if (conf->obs) printf("\n  OBSERVER_LIST   = %s (%d observers)",
+      conf->fobs, conf->nobs);
 
   /* Fiducial cosmology. */
   if (conf->fzcnvt) printf("\n  Z_CMVDST_CNVT   = %s", conf->fzcnvt);
@@ -718,28 +1190,45 @@ static void conf_print(const CONF *conf) {
   }
 
   /* Survey geometry. */
-  printf("\n  FOOTPRINT_TRIM  = %s", conf->foot_all);
+  if (conf->trc) printf("\n  TRACER_LIST     = %s (%d tracers)",
+      conf->ftrc, conf->ntrc);
+  else printf("\n  FOOTPRINT_TRIM  = %s", conf->foot_all);
   if (conf->foot) printf("\n  FOOTPRINT_MASK  = %s", conf->foot);
-  if (conf->ncap == 1)
+  printf("\n  MASK_CACHE      = %c", conf->mcache ? 'T' : 'F');
+  if (conf->mcache && conf->mcdir)
+    printf("\n  MASK_CACHE_DIR  = %s", conf->mcdir);
+  if (conf->reg) printf("\n  REGION_LIST     = %s (%d regions)",
+      conf->freg, conf->nreg);
+  else if (conf->ncap == 1)
     printf("\n  GALACTIC_CAP    = %c", conf->gcap[0]);
   else
     printf("\n  GALACTIC_CAP    = [%c,%c]", conf->gcap[0], conf->gcap[1]);
-  if (conf->fnz) printf("\n  NZ_FILE         = %s", conf->fnz);
-  printf("\n  ZMIN            = " OFMT_DBL, conf->zmin);
-  printf("\n  ZMAX            = " OFMT_DBL, conf->zmax);
+  if (!conf->trc) {
+    if (conf->fnz) printf("\n  NZ_FILE         = %s", conf->fnz);
+    printf("\n  ZMIN            = " OFMT_DBL, conf->zmin);
+    printf("\n  ZMAX            = " OFMT_DBL, conf->zmax);
+  }
   if (conf->fnz) {
-    const char *rng_name[2] = {"MRG32K3A", "MT19937"};
-    printf("\n  RAND_GENERATOR  = %d (%s)", conf->rng, rng_name[conf->rng]);
-    if (conf->ncap == 1)
+    if (conf->batch) ;          /* seeds are given by the batch list */
+    else if (conf->ncat == 1)
       printf("\n  RAND_SEED       = %ld", conf->seed[0]);
-    else
-      printf("\n  RAND_SEED       = [%ld,%ld]", conf->seed[0], conf->seed[1]);
+    else {
+      printf("\n  RAND_SEED       = [%ld", conf->seed[0]);
+      for (int i = 1; i < conf->ncat; i++) printf(",%ld", conf->seed[i]);
+      printf("]");
+    }
+    printf("\n  NUM_SUBSAMPLE   = %d", conf->nsub);
+    printf("\n  PRE_THINNING    = %c", conf->thin ? 'T' : 'F');
   }
 
   /* Output. */
-  printf("\n  OUTPUT          = %s", conf->output[0]);
-  if (conf->ncap == 2) printf("\n                    %s", conf->output[1]);
+  if (!conf->batch) {
+    printf("\n  OUTPUT          = %s", conf->output[0]);
+    for (int i = 1; i < conf->ncat; i++)
+      printf("\n                    %s", conf->output[i]);
+  }
   printf("\n  OUTPUT_FORMAT   = %d (%s)", conf->ofmt, fmt_name[conf->ofmt]);
+  printf("\n  OUTPUT_STREAM   = %c", conf->ostream ? 'T' : 'F');
   printf("\n  OVERWRITE       = %d\n", conf->ovwrite);
 #ifdef OMP
   printf("  OMP_NUM_THREADS = %d\n", conf->nthread);
@@ -789,6 +1278,28 @@ CONF *load_conf(const int argc, char *const *argv) {
   return conf;
 }
 
+/******************************************************************************
+Function `conf_batch`:
+  Set `INPUT`, `RAND_SEED`, and `OUTPUT` to those of an entry of the batch
+  list.
+Arguments:
+  * `conf`:     the structure for storing configurations;
+  * `idx`:      index of the entry.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+int conf_batch(CONF *conf, const int idx) {
+  if (!conf || !conf->batch || idx < 0 || idx >= conf->nbatch) {
+    P_ERR("invalid entry of the batch list\n");
+    return CUTSKY_ERR_ARG;
+  }
+  const size_t pos = (size_t) idx * (1 + 2 * conf->ncat);
+  conf->input = conf->batch[pos];
+  conf->seed = conf->bseed + (size_t) idx * conf->ncat;
+  conf->output = conf->batch + pos + 1 + conf->ncat;
+  return conf_inputs(conf);
+}
+
 /******************************************************************************
 Function `conf_destroy`:
   Release memory allocated for the configurations.
@@ -797,6 +1308,32 @@ Arguments:
 ******************************************************************************/
 void conf_destroy(CONF *conf) {
   if (!conf) return;
+  if (conf->batch) {
+    /* INPUT, RAND_SEED, and OUTPUT refer to entries of the batch list. */
+    conf->input = NULL;
+    conf->seed = NULL;
+    conf->output = NULL;
+    if (*(conf->batch)) free(*(conf->batch));
+    free(conf->batch);
+  }
+  if (conf->bseed) free(conf->bseed);
+  if (conf->fbatch) free(conf->fbatch);
+  if (conf->trc) {
+    /* NZ_FILE refers to an entry of the tracer list. */
+    conf->fnz = NULL;
+    if (*(conf->trc)) free(*(conf->trc));
+    free(conf->trc);
+  }
+  if (conf->tzlim) free(conf->tzlim);
+  if (conf->reg) {
+    if (*(conf->reg)) free(*(conf->reg));
+    free(conf->reg);
+  }
+  if (conf->rlim) free(conf->rlim);
+  if (conf->freg) free(conf->freg);
+  if (conf->obs) free(conf->obs);
+  if (conf->fobs) free(conf->fobs);
+  if (conf->ftrc) free(conf->ftrc);
   if (conf->input) free(conf->input);
   if (conf->inputs) {
     if (*(conf->inputs)) free(*(conf->inputs));
@@ -806,6 +1343,7 @@ void conf_destroy(CONF *conf) {
   if (conf->fnz) free(conf->fnz);
   if (conf->foot_all) free(conf->foot_all);
   if (conf->foot) free(conf->foot);
+  if (conf->mcdir) free(conf->mcdir);
   if (conf->gcap) free(conf->gcap);
   if (conf->seed) free(conf->seed);
   if (conf->output) {
@@ -40,12 +40,21 @@
 typedef struct {
   char *fconf;          /* name of the configuration file */
   char *input;          /* INPUT           */
+  char *fbatch;         /* BATCH_LIST      */
+  char **batch;         /* fields of the batch list */
+  long *bseed;          /* random seeds of the batch list */
+  int nbatch;           /* number of entries of the batch list */
   int ifmt;             /* INPUT_FORMAT    */
   char **inputs;        /* Input catalogues. */
   int ninput;           /* number of input catalogues */
   char comment;         /* COMMENT         */
+  bool immap;           /* INPUT_MMAP      */
+  bool isplit;          /* INPUT_SPLIT     */
   double Lbox;          /* BOX_SIZE        */
   long ndata;           /* NUMBER          */
+  char *fobs;           /* OBSERVER_LIST   */
+  double *obs;          /* positions and rotations of the observers */
+  int nobs;             /* number of observers */
   double omega_m;       /* OMEGA_M         */
   double omega_l;       /* OMEGA_LAMBDA    */
   double omega_k;       /* 1 - OMEGA_M - OMEGA_LAMBDA */
@@ -53,15 +62,28 @@ typedef struct {
   char *fzcnvt;         /* Z_CMVDST_CNVT   */
   char *foot_all;       /* DESI_ALL_TILES  */
   char *foot;           /* DESI_TILES      */
+  bool mcache;          /* MASK_CACHE      */
+  char *mcdir;          /* MASK_CACHE_DIR  */
   char *gcap;           /* GALACTIC_CAP    */
   int ncap;             /* number of galactic caps */
+  char *freg;           /* REGION_LIST     */
+  char **reg;           /* fields of the region list */
+  double *rlim;         /* coordinate ranges of the regions */
+  int nreg;             /* number of sky regions, or galactic caps */
   char *fnz;            /* NZ_FILE         */
   double zmin;          /* ZMIN            */
   double zmax;          /* ZMAX            */
-  int rng;              /* RAND_GENERATOR  */
+  char *ftrc;           /* TRACER_LIST     */
+  char **trc;           /* fields of the tracer list */
+  double *tzlim;        /* redshift ranges of the tracers */
+  int ntrc;             /* number of tracers */
+  int ncat;             /* number of output catalogs for all observers */
   long *seed;           /* RAND_SEED       */
+  int nsub;             /* NUM_SUBSAMPLE   */
+  bool thin;            /* PRE_THINNING    */
   char **output;        /* OUTPUT          */
   int ofmt;             /* OUTPUT_FORMAT   */
+  bool ostream;         /* OUTPUT_STREAM   */
   int ovwrite;          /* OVERWRITE       */
   bool verbose;         /* VERBOSE         */
 #ifdef OMP
@@ -85,6 +107,18 @@ Return:
 ******************************************************************************/
 CONF *load_conf(const int argc, char *const *argv);
 
+/******************************************************************************
+Function `conf_batch`:
+  Set `INPUT`, `RAND_SEED`, and `OUTPUT` to those of an entry of the batch
+  list.
+Arguments:
+  * `conf`:     the structure for storing configurations;
+  * `idx`:      index of the entry.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+int conf_batch(CONF *conf, const int idx);
+
 /******************************************************************************
 Function `conf_destroy`:
   Release memory allocated for the configurations.
@@ -14,119 +14,235 @@
 #include "proc_cat.h"
 #include "read_file.h"
 #include "write_file.h"
+#include "crand.h"
 #include <stdlib.h>
 #include <ctype.h>
 #include <inttypes.h>
 #include <math.h>
 #include <string.h>
 
+#ifdef MPI
+#include <mpi.h>
+#endif
+
+/* Workspace for processing objects in batches, with structure-of-arrays
+   buffers for the input data and candidates in box replicas. */
+typedef struct {
+  size_t nin;           /* number of buffered input objects             */
+  size_t ncand;         /* number of candidates in box replicas         */
+  double *in[6];        /* buffers for input coordinates and velocities */
+  size_t *idx;          /* indices of input objects for candidates      */
+  uint64_t *key;        /* keys of random numbers for candidates        */
+  double *pos[3];       /* comoving coordinates of candidates           */
+  double *d2;           /* squared radial distances of candidates       */
+  double *dinv;         /* inverse radial distances of candidates       */
+  double *vel;          /* line-of-sight velocities of candidates       */
+  double *zr;           /* real-space redshifts of candidates           */
+  double *zs;           /* redshift-space redshifts of candidates       */
+  double *pass;         /* 1 for candidates passing the cuts, 0 if not  */
+  double pthin[CUTSKY_MAX_TRACER];      /* thresholds for pre-thinning  */
+  bool thin;            /* indicate whether all tracers are pre-thinned */
+} BATCH;
+
+/* Pool of buffers that are reused for processing multiple catalogs. */
+struct cutsky_pbuf {
+  int ndata;            /* number of pooled cut-sky catalogs            */
+  int nbat;             /* number of pooled batch workspaces            */
+  int max;              /* capacity of the pool for each kind           */
+  DATA **data;          /* pooled cut-sky catalogs                      */
+  BATCH **bat;          /* pooled batch workspaces                      */
+};
+
+/* Interface for writing the cut-sky catalogue. */
+typedef struct {
+  CUTSKY_FFMT fmt;      /* format of the output file                    */
+  int ncol;             /* number of columns                            */
+  size_t n;             /* number of saved objects                      */
+  OFILE *ofile;         /* interface for ASCII files                    */
+#ifdef WITH_CFITSIO
+  OFFILE *offile;       /* interface for FITS files                     */
+#endif
+} OCAT;
+
+/* Shortcut for garbage collection. */
+#define DATA_CLEAN_SERIAL                                               \
+  for (int ii = 0; ii < CUTSKY_MAX_NCAT; ii++)                          \
+    cutsky_release(pbuf, data[ii]);                                     \
+  for (int ii = 0; ii < CUTSKY_MAX_NCAT; ii++) ocat_close(ocat[ii]);
+
 #ifdef OMP
 
 #include <omp.h>
-#include <limits.h>
 
-/* Data structure for maintaining the order of the data for reproductivity. */
+/* Ranges of the cut-sky catalogs produced by a sub-chunk of the input, which
+   is processed by an arbitrary thread. */
 typedef struct {
-  size_t n;             /* number of data chunks                           */
-  size_t max;           /* capacity of this structure                      */
-  size_t *start;        /* starting index of each chunk in private catalog */
-  size_t *length;       /* length of each chunk in private catalog         */
-  size_t *iglobal;      /* global starting index of the current chunk      */
-} DATA_CHUNK;
+  int tid;              /* ID of the thread processing the sub-chunk */
+  size_t *start;        /* indices of the first objects, for all catalogs */
+  size_t *end;          /* indices after the last objects */
+} SEG;
 
 /* Shortcut for garbage collection. */
 #define DATA_CLEAN_OMP                                                  \
-  for (int ii = 0; ii < conf->ncap; ii++) {                             \
-    for (int jj = 0; jj < conf->nthread; jj++) {                        \
-      cutsky_destroy(pdata[ii][jj]); chunk_destroy(pchunk[ii][jj]);     \
-    }                                                                   \
-    free(pdata[ii]); free(pchunk[ii]);                                  \
-  }
+  for (int ii = 0; ii < conf->ncat; ii++) {                             \
+    for (int jj = 0; jj < conf->nthread; jj++)                          \
+      cutsky_release(pbuf, pdata[ii][jj]);                              \
+    free(pdata[ii]);                                                    \
+  }                                                                     \
+  if (pbatch) {                                                         \
+    for (int jj = 0; jj < conf->nthread; jj++)                          \
+      batch_release(pbuf, pbatch[jj]);                                  \
+    free(pbatch);                                                       \
+  }                                                                     \
+  if (ioff) free(ioff);                                                 \
+  if (seg) free(seg);                                                   \
+  if (segpos) free(segpos);                                             \
+  for (int ii = 0; ii < CUTSKY_MAX_NCAT; ii++) ocat_close(ocat[ii]);
+
+#endif          /* OMP */
 
 /*============================================================================*\
-              Functions for processing the data chunk information
+                   Functions for locating records in the input
 \*============================================================================*/
 
 /******************************************************************************
-Function `chunk_destroy`:
-  Deconstruct the instance for storing data chunk information.
+Function `record_start`:
+  Locate the record in a line of the ASCII-format input catalog.
 Arguments:
-  * `chunk`:    instance of the data chunk structure.
+  * `line`:     the line to be checked;
+  * `comment`:  the comment symbol.
+Return:
+  Address of the first non-whitespace character on success; NULL if the line
+  is empty or commented.
 ******************************************************************************/
-static void chunk_destroy(DATA_CHUNK *chunk) {
-  if (!chunk) return;
-  if (chunk->start) free(chunk->start);
-  if (chunk->length) free(chunk->length);
-  if (chunk->iglobal) free(chunk->iglobal);
-  free(chunk);
+static inline const char *record_start(const char *line, const char comment) {
+  /* Omit leading whitespaces; mapped lines are ending with '\n'. */
+  while (*line != '\n' && isspace(*line)) ++line;
+  if (*line == comment || *line == '\0' || *line == '\n') return NULL;
+  return line;
 }
 
+#ifdef OMP
+
 /******************************************************************************
-Function `chunk_init`:
-  Initialise the structures for storing data chunk information.
-Argument:
-  * `nthread`:  number of threads to be run in parallel.
-Return:
-  Instances of the structures for each thread on success; NULL on error.
+Function `chunk_index`:
+  Compute the indices of the first input objects in sub-chunks of the lines,
+  so that each object is identified by its order in the input catalog,
+  regardless of the threads processing the sub-chunks.
+Arguments:
+  * `conf`:     structure for storing configurations;
+  * `ifile`:    interface for file reading, with lines to be processed;
+  * `start`:    index of the first object in the lines;
+  * `ibase`:    indices of the first objects for each sub-chunk, and the
+                index of the first object after the lines.
 ******************************************************************************/
-static DATA_CHUNK **chunk_init(const int nthread) {
-  DATA_CHUNK **chunk = malloc(nthread * sizeof(DATA_CHUNK *));
-  if (!chunk) {
-    P_ERR("failed to allocate memory for data chunks\n");
-    return NULL;
-  }
-  for (int i = 0; i < nthread; i++) {
-    if (!(chunk[i] = malloc(sizeof(DATA_CHUNK)))) {
-      P_ERR("failed to allocate memory for data chunks\n");
-      for (int j = 0; j < i; j++) chunk_destroy(chunk[j]);
-      free(chunk);
-      return NULL;
-    }
-    chunk[i]->start = chunk[i]->length = chunk[i]->iglobal = NULL;
-    chunk[i]->n = 0;
-    chunk[i]->max = CUTSKY_DATA_INIT_NUM;
-
-    if (!(chunk[i]->start = malloc(chunk[i]->max * sizeof(size_t)))) {
-      P_ERR("failed to allocate memory for data chunks\n");
-      for (int j = 0; j < i; j++) chunk_destroy(chunk[j]);
-      free(chunk);
-      return NULL;
+static void chunk_index(const CONF *conf, const IFILE *ifile, size_t start,
+    size_t *ibase) {
+  const size_t nsub = (ifile->nline + CUTSKY_OMP_SUBCHUNK - 1) /
+      CUTSKY_OMP_SUBCHUNK;
+  for (size_t s = 0; s < nsub; s++) {
+    const size_t istart = s * CUTSKY_OMP_SUBCHUNK;
+    size_t iend = istart + CUTSKY_OMP_SUBCHUNK;
+    if (iend > ifile->nline) iend = ifile->nline;
+    ibase[s] = start;
+    for (size_t i = istart; i < iend; i++) {
+      if (record_start(ifile->chunk + ifile->lines[i], conf->comment))
+        start++;
     }
   }
+  ibase[nsub] = start;
+}
 
-  return chunk;
+/******************************************************************************
+Function `next_subchunk`:
+  Claim the next sub-chunk to be processed, for dynamic load balancing.
+Arguments:
+  * `next`:     index of the next unclaimed sub-chunk, shared by threads;
+  * `nsub`:     number of sub-chunks;
+  * `num`:      number of records (lines) in all the sub-chunks;
+  * `istart`:   index of the first record of the claimed sub-chunk;
+  * `iend`:     index of the record next to the last one of the sub-chunk.
+Return:
+  Index of the claimed sub-chunk; `nsub` if all sub-chunks are claimed.
+******************************************************************************/
+static inline size_t next_subchunk(size_t *next, const size_t nsub,
+    const size_t num, size_t *istart, size_t *iend) {
+  size_t s;
+#pragma omp atomic capture
+  s = (*next)++;
+  if (s >= nsub) return nsub;
+  *istart = s * CUTSKY_OMP_SUBCHUNK;
+  *iend = (*istart + CUTSKY_OMP_SUBCHUNK < num) ?
+      *istart + CUTSKY_OMP_SUBCHUNK : num;
+  return s;
 }
 
+#endif          /* OMP */
+
+/*============================================================================*\
+                Functions for the batched coordinate conversion
+\*============================================================================*/
+
 /******************************************************************************
-Function `chunk_append`:
-  Append information of a chunk to the structure storing chunk information.
+Function `batch_destroy`:
+  Deconstruct the workspace for batched coordinate conversion.
 Arguments:
-  * `chunk`:    interface of the data chunks;
-  * `start`:    starting index of the current chunk.
+  * `bat`:      the workspace for batched coordinate conversion.
+******************************************************************************/
+static void batch_destroy(BATCH *bat) {
+  if (!bat) return;
+  for (int i = 0; i < 6; i++) if (bat->in[i]) free(bat->in[i]);
+  for (int i = 0; i < 3; i++) if (bat->pos[i]) free(bat->pos[i]);
+  if (bat->idx) free(bat->idx);
+  if (bat->key) free(bat->key);
+  if (bat->d2) free(bat->d2);
+  if (bat->dinv) free(bat->dinv);
+  if (bat->vel) free(bat->vel);
+  if (bat->zr) free(bat->zr);
+  if (bat->zs) free(bat->zs);
+  if (bat->pass) free(bat->pass);
+  free(bat);
+}
+
+/******************************************************************************
+Function `batch_init`:
+  Initialise the workspace for batched coordinate conversion.
 Return:
-  Zero on success; non-zero on error.
+  Instance of the workspace on success; NULL on error.
 ******************************************************************************/
-static int chunk_append(DATA_CHUNK *chunk, const size_t start) {
-  /* Enlarge the memory if necessary. */
-  if (chunk->n == chunk->max) {
-    if (INT_MAX / 2 < chunk->max) {
-      P_ERR("too many data chunks\n");
-      return CUTSKY_ERR_CUTSKY;
-    }
-    chunk->max <<= 1;
-    size_t *tmp;
-    if (!(tmp = realloc(chunk->start, chunk->max * sizeof(size_t)))) {
-      P_ERR("failed to allocate memory for data chunks\n");
-      return CUTSKY_ERR_MEMORY;
-    }
-    chunk->start = tmp;
+static BATCH *batch_init(void) {
+  BATCH *bat = calloc(1, sizeof *bat);
+  if (!bat) {
+    P_ERR("failed to allocate memory for batched coordinate conversion\n");
+    return NULL;
   }
 
-  chunk->start[chunk->n++] = start;
-  return 0;
+  const size_t n = CUTSKY_DATA_CHUNK;
+  bool fail = false;
+  for (int i = 0; i < 6; i++) {
+    if (!(bat->in[i] = malloc(n * sizeof(double)))) fail = true;
+  }
+  for (int i = 0; i < 3; i++) {
+    if (!(bat->pos[i] = malloc(n * sizeof(double)))) fail = true;
+  }
+  if (fail || !(bat->idx = malloc(n * sizeof(size_t))) ||
+      !(bat->key = malloc(n * sizeof(uint64_t))) ||
+      !(bat->d2 = malloc(n * sizeof(double))) ||
+      !(bat->dinv = malloc(n * sizeof(double))) ||
+      !(bat->vel = malloc(n * sizeof(double))) ||
+      !(bat->zr = malloc(n * sizeof(double))) ||
+      !(bat->zs = malloc(n * sizeof(double))) ||
+      !(bat->pass = malloc(n * sizeof(double)))) {
+    P_ERR("failed to allocate memory for batched coordinate conversion\n");
+    batch_destroy(bat);
+    return NULL;
+  }
+  /* No pre-thinning by default. */
+  for (int i = 0; i < CUTSKY_MAX_TRACER; i++) bat->pthin[i] = HUGE_VAL;
+  bat->thin = false;
+  return bat;
 }
 
-#endif          /* OMP */
 
 /*============================================================================*\
                  Functions for processing the cut-sky catalogue
@@ -135,10 +251,12 @@ static int chunk_append(DATA_CHUNK *chunk, const size_t start) {
 /******************************************************************************
 Function `cutsky_init`:
   Initialise the cut-sky catalogue.
+Arguments:
+  * `with_key`: true for recording keys of random numbers.
 Return:
   Instance of the cut-sky catalogue on success; NULL on error.
 ******************************************************************************/
-static DATA *cutsky_init(void) {
+static DATA *cutsky_init(const bool with_key) {
   DATA *data = malloc(sizeof *data);
   if (!data) {
     P_ERR("failed to allocate memory for the cut-sky catalog\n");
@@ -146,6 +264,7 @@ static DATA *cutsky_init(void) {
   }
   data->x[0] = data->x[1] = data->x[2] = data->x[3] = NULL;
   data->nz = data->ran = NULL;
+  data->key = NULL;
   data->status = NULL;
   data->n = 0;
   data->max = CUTSKY_DATA_CHUNK;
@@ -159,6 +278,12 @@ static DATA *cutsky_init(void) {
         return NULL;
       }
     }
+    if (with_key && !(data->key = malloc(data->max * sizeof(uint64_t)))) {
+      P_ERR("failed to allocate memory for the cut-sky catalog\n");
+      for (int j = 0; j < 4; j++) free(data->x[j]);
+      free(data);
+      return NULL;
+    }
   }
 
   return data;
@@ -177,6 +302,7 @@ static void cutsky_destroy(DATA *data) {
   }
   if (data->nz) free(data->nz);
   if (data->ran) free(data->ran);
+  if (data->key) free(data->key);
   if (data->status) free(data->status);
   free(data);
 }
@@ -189,12 +315,13 @@ Arguments:
   * `ra`:       the right-acension of the tracer;
   * `dec`:      the declination of the tracer;
   * `z`:        the redshift-space redshift of the tracer;
-  * `z_cosmo`:  the real-space redshift of the tracer.
+  * `z_cosmo`:  the real-space redshift of the tracer;
+  * `key`:      key of the random number for radial selection.
 Return:
   Zero on success; non-zero on error.
 ******************************************************************************/
 static int cutsky_append(DATA *data, const float ra, const float dec,
-    const float z, const float z_cosmo) {
+    const float z, const float z_cosmo, const uint64_t key) {
   /* Enlarge the catalogue if necessary. */
   if (data->n == data->max) {
     if (SIZE_MAX / 2 < data->max) {
@@ -210,8 +337,17 @@ static int cutsky_append(DATA *data, const float ra, const float dec,
       }
       data->x[i] = tmp;
     }
+    if (data->key) {
+      uint64_t *tmp = realloc(data->key, data->max * sizeof(uint64_t));
+      if (!tmp) {
+        P_ERR("failed to allocate memory for the cut-sky catalog\n");
+        return CUTSKY_ERR_MEMORY;
+      }
+      data->key = tmp;
+    }
   }
 
+  if (data->key) data->key[data->n] = key;
   data->x[0][data->n] = ra;
   data->x[1][data->n] = dec;
   data->x[2][data->n] = z;
@@ -221,465 +357,1171 @@ static int cutsky_append(DATA *data, const float ra, const float dec,
 }
 
 /******************************************************************************
-Function `cutsky_infoot`:
-  Push objects passing the survey geometry test to the cut-sky catalogs.
+Function `replica_range`:
+  Compute the range of replica indices along one axis, for which the shifted
+  coordinate falls inside a given interval.
+Arguments:
+  * `lo`, `hi`: bounds of the interval, relative to the original coordinate;
+  * `ndup`:     number of box duplications for each side;
+  * `Linv`:     inverse of the box size;
+  * `imin`:     the minimum admissible replica index;
+  * `imax`:     the maximum admissible replica index.
+******************************************************************************/
+static inline void replica_range(const double lo, const double hi,
+    const int ndup, const double Linv, int *imin, int *imax) {
+  /* The range is widened slightly, so no replica is lost due to rounding. */
+  double min = ceil(lo * Linv - DOUBLE_TOL);
+  double max = floor(hi * Linv + DOUBLE_TOL);
+  *imin = (min < -ndup) ? -ndup : min;
+  *imax = (max > ndup - 1) ? ndup - 1 : max;
+}
+
+/******************************************************************************
+Function `thin_keep`:
+  Check if a candidate survives the pre-thinning for a catalog, i.e., its
+  random number for radial selection is below the threshold for any of the
+  subsamples.
 Arguments:
-  * `zcvt`:     interface for distance to redshift conversion;
   * `geom`:     interface for survey geometry;
-  * `x`, `y`, `z`:      comoving coordinates;
-  * `vx`, `vy`, `vz`:   peculiar velocities;
-  * `ncap`:     number of galactic caps to be considered;
-  * `ra_shift`: shift of right ascension for box rotation;
-  * `is_ngc`:   indicate if the test is for ngc;
-  * `data`:     cut-sky catalogs.
+  * `icat`:     index of the catalog;
+  * `pthin`:    threshold of random numbers for pre-thinning;
+  * `key`:      key of the random number for radial selection.
 Return:
-  True if the object is inside the footprint; false otherwise.
+  True if the candidate may pass the radial selection.
 ******************************************************************************/
-static inline int cutsky_infoot(const ZCVT *zcvt, const GEOM *geom,
-    const double x, const double y, const double z, const double vx,
-    const double vy, const double vz, const int ncap, const double ra_shift[2],
-    const bool is_ngc[2], DATA *data[2]) {
-  /* Loops for box duplicates. */
-  for (int i = -zcvt->ndup; i < zcvt->ndup; i++) {
-    double xx = x + i * zcvt->Lbox;
-    for (int j = -zcvt->ndup; j < zcvt->ndup; j++) {
-      double yy = y + j * zcvt->Lbox;
-      for (int k = -zcvt->ndup; k < zcvt->ndup; k++) {
-        double zz = z + k * zcvt->Lbox;
-
-        /* Compute the trim and radial distance with tolerance for RSD. */
-        double d2 = xx * xx + yy * yy + zz * zz;
-        if (d2 > zcvt->d2max || d2 < zcvt->d2min) continue;
-
-        /* Compute the line-of-sight velocity. */
-        double d_inv = 1 / sqrt(d2);
-        double vel = (vx * xx + vy * yy + vz * zz) * d_inv;
-
-        /* Convert squared distance to redshift. */
-        double z_real = convert_z(zcvt, d2);
-        double z_red = z_real + vel * (1 + z_real) / SPEED_OF_LIGHT;
-        if (z_red < zcvt->zmin || z_red > zcvt->zmax) continue;
-
-        /* Compute sky coordinates. */
-        for (int n = 0; n < ncap; n++) {
-          double ra, dec;
-          if (d_inv > 1 / DOUBLE_TOL) ra = dec = 0;
-          else {
-            dec = asin(zz * d_inv) * RAD_2_DEGREE;
-            ra = atan2(yy, xx) * RAD_2_DEGREE + ra_shift[n];
-            if (ra < 0) ra += 360;
-          }
-
-          /* Pre-select NGC/SGC. */
-          if ((ra > DESI_NGC_RA_MIN && ra < DESI_NGC_RA_MAX) != is_ngc[n])
-            continue;
-
-          /* Trim survey footprint. */
-          if (geom_infoot(geom->foot[0], ra, dec)) {
-            if (cutsky_append(data[n], ra, dec, z_red, z_real))
-              return CUTSKY_ERR_CUTSKY;
-          }
-        }
-      }
-    }
+static inline bool thin_keep(const GEOM *geom, const int icat,
+    const double pthin, const uint64_t key) {
+  /* Random numbers are compared in single precision, as in the selection. */
+  for (int k = 0; k < geom->nsub; k++) {
+    if ((float) crand_double(geom->seed[k][icat], key) < pthin) return true;
   }
-
-  return 0;
+  return false;
 }
 
 /******************************************************************************
-Function `cutsky_save`:
-  Save the cut-sky catalogue to an output file.
+Function `cutsky_flush`:
+  Convert coordinates of candidates in box replicas, and push those passing
+  the survey geometry test to the cut-sky catalogs.
 Arguments:
-  * `fname`:    name of the output file;
-  * `fmt`:      format of the output file;
-  * `data`:     array of cut-sky catalogues to be saved;
-  * `ncat`:     number of cut-sky catalogues.
+  * `zcvt`:     interface for distance to redshift conversion;
+  * `geom`:     interface for survey geometry;
+  * `bat`:      workspace with the candidates;
+  * `in`:       coordinates and velocities of the input objects;
+  * `iobs`:     index of the observer;
+  * `data`:     cut-sky catalogs of all observers, tracers, and sky regions.
 Return:
   Zero on success; non-zero on error.
 ******************************************************************************/
-static int cutsky_save(const char *fname, const CUTSKY_FFMT fmt,
-    DATA **data, const int ncat) {
-#ifdef WITH_CFITSIO
-  if (fmt == CUTSKY_FFMT_ASCII) {        /* ASCII file */
-#endif
+static int cutsky_flush(const ZCVT *zcvt, const GEOM *geom, BATCH *bat,
+    double *const in[6], const int iobs, DATA *const *data) {
+  const size_t n = bat->ncand;
+  const size_t *idx = bat->idx;
+  const double *xx = bat->pos[0];
+  const double *yy = bat->pos[1];
+  const double *zz = bat->pos[2];
+  const double *vx = in[3];
+  const double *vy = in[4];
+  const double *vz = in[5];
+  double *d2 = bat->d2;
+  double *dinv = bat->dinv;
+  double *vel = bat->vel;
+  double *zr = bat->zr;
+  double *zs = bat->zs;
+  double *pass = bat->pass;
+  bat->ncand = 0;
+
+  /* Compute radial distances and line-of-sight velocities. */
+  CUTSKY_SIMD
+  for (size_t i = 0; i < n; i++) {
+    d2[i] = xx[i] * xx[i] + yy[i] * yy[i] + zz[i] * zz[i];
+    dinv[i] = 1 / sqrt(d2[i]);
+    vel[i] = (vx[idx[i]] * xx[i] + vy[idx[i]] * yy[i] + vz[idx[i]] * zz[i]) *
+        dinv[i];
+  }
 
-    /* Open the output file for writing. */
-    OFILE *ofile = output_init();
-    if (!ofile || output_newfile(ofile, fname)) {
-      output_destroy(ofile);
-      return CUTSKY_ERR_FILE;
+  /* Convert squared distances to redshifts, with the vectorized lookup if
+     the uniform index is available. */
+  if (zcvt->idx) {
+    CUTSKY_SIMD
+    for (size_t i = 0; i < n; i++) zr[i] = convert_z_index(zcvt, d2[i]);
+  }
+  else {
+    for (size_t i = 0; i < n; i++) zr[i] = convert_z(zcvt, d2[i]);
+  }
+
+  /* Apply RSD, and check the radial distance and redshift ranges.
+     The distance check guards only against rounding errors of the ranges. */
+  const double d2min = zcvt->d2min;
+  const double d2max = zcvt->d2max;
+  const double zmin = zcvt->zmin;
+  const double zmax = zcvt->zmax;
+  CUTSKY_SIMD
+  for (size_t i = 0; i < n; i++) {
+    zs[i] = zr[i] + vel[i] * (1 + zr[i]) / SPEED_OF_LIGHT;
+    /* Flags are saved as doubles, as narrowing the masks of double
+       comparisons is not vectorized without AVX. */
+    pass[i] = ((d2[i] <= d2max) & (d2[i] >= d2min) & (zs[i] >= zmin) &
+        (zs[i] <= zmax)) ? 1 : 0;
+  }
+
+  /* Rotation for the right ascension shift. */
+  const double rot[2] = {cos(CUTSKY_RA_SHIFT * DEGREE_2_RAD),
+      sin(CUTSKY_RA_SHIFT * DEGREE_2_RAD)};
+
+  /* Push candidates inside the footprints to the catalogs. The coordinates
+     are shared by tracers and regions, with their own redshift ranges and
+     footprints. */
+  const OBSERVER *obs = geom->obs + iobs;
+  const int ntrc = geom->ntrc;
+  const int nreg = geom->nreg;
+  const int icat = iobs * ntrc * nreg;
+  data += icat;
+  for (size_t i = 0; i < n; i++) {
+    if (!pass[i]) continue;
+
+    bool inz[CUTSKY_MAX_TRACER];
+    bool any = false;
+    for (int t = 0; t < ntrc; t++) {
+      inz[t] = zs[i] >= geom->trc[t].zmin && zs[i] <= geom->trc[t].zmax;
+      any |= inz[t];
+    }
+    if (!any) continue;
+
+    /* Rotate the sky of the observer; distances and velocities are kept. */
+    double px = xx[i];
+    double py = yy[i];
+    double pz = zz[i];
+    if (obs->rotate) {
+      px = obs->rot[0][0] * xx[i] + obs->rot[0][1] * yy[i] +
+          obs->rot[0][2] * zz[i];
+      py = obs->rot[1][0] * xx[i] + obs->rot[1][1] * yy[i] +
+          obs->rot[1][2] * zz[i];
+      pz = obs->rot[2][0] * xx[i] + obs->rot[2][1] * yy[i] +
+          obs->rot[2][2] * zz[i];
     }
 
-    if (!data[0]->status && !data[0]->nz) {     /* no bitcode and nz */
-      /* Header. */
-      if (output_writeline(ofile, "%c RA(1) DEC(2) Z(3) Z_COSMO(4)\n",
-          CUTSKY_SAVE_COMMENT)) return CUTSKY_ERR_FILE;
+    /* Rotate the unit vector, with the origin mapped to (ra,dec) = (0,0). */
+    double v[3] = {1, 0, 0};
+    if (dinv[i] <= 1 / DOUBLE_TOL) {
+      const double ux = px * dinv[i];
+      const double uy = py * dinv[i];
+      v[0] = rot[0] * ux - rot[1] * uy;
+      v[1] = rot[1] * ux + rot[0] * uy;
+      v[2] = pz * dinv[i];
+    }
 
-      for (int i = 0; i < ncat; i++) {
-        for (size_t j = 0; j < data[i]->n; j++) {
-          if (output_writeline(ofile, OFMT_FLT " " OFMT_FLT " " OFMT_FLT " "
-              OFMT_FLT "\n", data[i]->x[0][j], data[i]->x[1][j],
-              data[i]->x[2][j], data[i]->x[3][j]))
-            return CUTSKY_ERR_FILE;
+    /* Route the direction to the sky regions with the pixel map. */
+    const unsigned int reg = geom_region(geom, v);
+    if (!reg) continue;
+
+    /* Trim survey footprints, with each footprint tested only once for all
+       the regions. */
+    const MANGLE *foot[CUTSKY_MAX_TRACER];
+    bool infoot[CUTSKY_MAX_TRACER];
+    int nfoot = 0;
+    double ra = 0;
+    double dec = HUGE_VAL;
+    for (int r = 0; r < nreg; r++) {
+      if (!(reg >> r & 1)) continue;
+
+      bool sel[CUTSKY_MAX_TRACER];
+      any = false;
+      for (int t = 0; t < ntrc; t++) {
+        sel[t] = inz[t] && (bat->pthin[t] >= 1 ||
+            thin_keep(geom, icat + t * nreg + r, bat->pthin[t], bat->key[i]));
+        if (!sel[t]) continue;
+
+        int k = 0;
+        while (k < nfoot && foot[k] != geom->trc[t].foot) k++;
+        if (k == nfoot) {
+          foot[nfoot] = geom->trc[t].foot;
+          infoot[nfoot++] = geom_infoot_vec(geom->trc[t].foot, v) != NULL;
         }
+        sel[t] = infoot[k];
+        any |= sel[t];
       }
-    }
-    else if (!data[0]->nz) {                    /* bitcode only */
-      /* Header. */
-      if (output_writeline(ofile, "%c RA(1) DEC(2) Z(3) Z_COSMO(4) "
-          "STATUS(5)\n", CUTSKY_SAVE_COMMENT)) return CUTSKY_ERR_FILE;
-
-      for (int i = 0; i < ncat; i++) {
-        for (size_t j = 0; j < data[i]->n; j++) {
-          if (output_writeline(ofile, OFMT_FLT " " OFMT_FLT " " OFMT_FLT " "
-              OFMT_FLT " %" PRId8 "\n", data[i]->x[0][j], data[i]->x[1][j],
-              data[i]->x[2][j], data[i]->x[3][j], data[i]->status[j]))
-            return CUTSKY_ERR_FILE;
+      if (!any) continue;
+
+      /* Compute the sky coordinates once for all regions. */
+      if (dec == HUGE_VAL) {
+        if (dinv[i] > 1 / DOUBLE_TOL) dec = 0;
+        else {
+          ra = atan2(py, px) * RAD_2_DEGREE + CUTSKY_RA_SHIFT;
+          if (ra < 0) ra += 360;
+          dec = asin(pz * dinv[i]) * RAD_2_DEGREE;
         }
       }
-    }
-    else {                                      /* both bitcode and nz */
-      /* Header. */
-      if (output_writeline(ofile, "%c RA(1) DEC(2) Z(3) Z_COSMO(4) "
-          "NZ(5) STATUS(6) RAN_NUM_0_1(7)\n", CUTSKY_SAVE_COMMENT))
-        return CUTSKY_ERR_FILE;
 
-      for (int i = 0; i < ncat; i++) {
-        for (size_t j = 0; j < data[i]->n; j++) {
-          if (output_writeline(ofile, OFMT_FLT " " OFMT_FLT " " OFMT_FLT " "
-              OFMT_FLT " " OFMT_FLT " %" PRId8 " " OFMT_FLT "\n",
-              data[i]->x[0][j], data[i]->x[1][j], data[i]->x[2][j],
-              data[i]->x[3][j], data[i]->nz[j], data[i]->status[j],
-              data[i]->ran[j]))
-            return CUTSKY_ERR_FILE;
-        }
+      for (int t = 0; t < ntrc; t++) {
+        if (sel[t] && cutsky_append(data[t * nreg + r], ra, dec, zs[i], zr[i],
+            bat->key[i])) return CUTSKY_ERR_CUTSKY;
       }
     }
-
-    /* Close file. */
-    output_destroy(ofile);
-
-#ifdef WITH_CFITSIO
   }
-  else {                                        /* FITS file */
-
-    /* Allocate memory for the filename. */
-    const size_t len = strlen(fname) + 1;
-    char *fitsname = malloc(len + 1);
-    if (!fitsname) {
-      P_ERR("failed to allocate memory for catalog writing\n");
-      return CUTSKY_ERR_MEMORY;
-    }
-    fitsname[0] = '!';
-    strncpy(fitsname + 1, fname, len);
 
-    /* Open the output file for writing. */
-    OFFILE *ofile = ofits_init();
-    if (!ofile) {
-      free(fitsname);
-      return CUTSKY_ERR_FILE;
-    }
+  return 0;
+}
 
-    /* Setup columns. */
-    if (!data[0]->status && !data[0]->nz) {     /* no bitcode and nz */
-      const int ncol = 4;
-      char *names[] = {"RA", "DEC", "Z", "Z_COSMO"};
-      char *units[] = {"deg", "deg", NULL, NULL};
-      int dtypes[] = {TFLOAT, TFLOAT, TFLOAT, TFLOAT};
+/******************************************************************************
+Function `cutsky_infoot`:
+  Push objects passing the survey geometry test to the cut-sky catalogs.
+Arguments:
+  * `zcvt`:     interface for distance to redshift conversion;
+  * `geom`:     interface for survey geometry;
+  * `bat`:      workspace for batched coordinate conversion;
+  * `in`:       coordinates and velocities of the objects: (x,y,z,vx,vy,vz);
+  * `num`:      number of objects;
+  * `ibase`:    index of the first object in the input catalog;
+  * `data`:     cut-sky catalogs of all observers, tracers, and sky regions.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int cutsky_infoot(const ZCVT *zcvt, const GEOM *geom, BATCH *bat,
+    double *const in[6], const size_t num, const size_t ibase,
+    DATA *const *data) {
+  const double Linv = 1 / zcvt->Lbox;
+  if (num && ibase + num - 1 > CRAND_MAX_INDEX) {
+    P_ERR("too many objects in the input catalog\n");
+    return CUTSKY_ERR_CUTSKY;
+  }
 
-      if (ofits_newfile(ofile, fitsname, ncol, names, units, dtypes)) {
-        free(fitsname);
-        return CUTSKY_ERR_FILE;
+  /* Tighten the shell of interest with the maximum speed of the objects, so
+     that candidates surely outside the redshift range are never created. */
+  double v2max = 0;
+  for (size_t p = 0; p < num; p++) {
+    const double v2 = in[3][p] * in[3][p] + in[4][p] * in[4][p] +
+        in[5][p] * in[5][p];
+    if (v2 > v2max) v2max = v2;
+  }
+  double d2min, d2max;
+  zcvt_shell(zcvt, sqrt(v2max), &d2min, &d2max);
+
+  /* The chunk is processed by all observers while it is still in cache. */
+  for (int o = 0; o < geom->nobs; o++) {
+    const OBSERVER *obs = geom->obs + o;
+    const int icat = o * geom->ntrc * geom->nreg;
+
+    for (size_t p = 0; p < num; p++) {
+      /* Coordinates relative to the observer, wrapped into the box. */
+      double x = in[0][p];
+      double y = in[1][p];
+      double z = in[2][p];
+      if (obs->shift) {
+        if ((x -= obs->pos[0]) < 0) x += zcvt->Lbox;
+        if ((y -= obs->pos[1]) < 0) y += zcvt->Lbox;
+        if ((z -= obs->pos[2]) < 0) z += zcvt->Lbox;
       }
 
-      for (int i = 0; i < ncat; i++) {
-        for (size_t j = 0; j < data[i]->n; j++) {
-          if (ofits_writeline(ofile, data[i]->x[0][j], data[i]->x[1][j],
-              data[i]->x[2][j], data[i]->x[3][j])) {
-            free(fitsname);
-            return CUTSKY_ERR_FILE;
+      /* Loops for box duplicates, with the admissible ranges of replicas
+         along the y and z directions solved from d2min <= r^2 <= d2max, so
+         that replicas outside the shell of interest are never visited. */
+      for (int i = -zcvt->ndup; i < zcvt->ndup; i++) {
+        double xx = x + i * zcvt->Lbox;
+        double ry2 = d2max - xx * xx;
+        if (ry2 < 0) continue;
+
+        double ry = sqrt(ry2);
+        int jmin, jmax;
+        replica_range(-ry - y, ry - y, zcvt->ndup, Linv, &jmin, &jmax);
+
+        for (int j = jmin; j <= jmax; j++) {
+          double yy = y + j * zcvt->Lbox;
+          double r2 = xx * xx + yy * yy;
+          if (r2 > d2max) continue;
+
+          /* The admissible zz are in [-zout, -zin] and [zin, zout]. */
+          double zout = sqrt(d2max - r2);
+          double zin = (d2min > r2) ? sqrt(d2min - r2) : 0;
+          int kr[4];
+          replica_range(-zout - z, -zin - z, zcvt->ndup, Linv, kr, kr + 1);
+          replica_range(zin - z, zout - z, zcvt->ndup, Linv, kr + 2, kr + 3);
+          if (kr[2] <= kr[1]) kr[2] = kr[1] + 1;  /* overlapping ranges */
+
+          /* Record candidates, and process them once the buffer is full. */
+          for (int n = 0; n < 4; n += 2) {
+            for (int k = kr[n]; k <= kr[n + 1]; k++) {
+              const uint64_t key = crand_key(ibase + p, i, j, k);
+
+              /* Skip candidates that never pass the radial selection. */
+              if (bat->thin) {
+                bool keep = false;
+                for (int it = 0; !keep && it < geom->ntrc; it++) {
+                  for (int ir = 0; !keep && ir < geom->nreg; ir++) {
+                    keep = thin_keep(geom, icat + it * geom->nreg + ir,
+                        bat->pthin[it], key);
+                  }
+                }
+                if (!keep) continue;
+              }
+
+              const size_t c = bat->ncand++;
+              bat->idx[c] = p;
+              bat->key[c] = key;
+              bat->pos[0][c] = xx;
+              bat->pos[1][c] = yy;
+              bat->pos[2][c] = z + k * zcvt->Lbox;
+              if (bat->ncand == CUTSKY_DATA_CHUNK &&
+                  cutsky_flush(zcvt, geom, bat, in, o, data))
+                return CUTSKY_ERR_CUTSKY;
+            }
           }
         }
       }
     }
-    else if (!data[0]->nz) {                    /* bitcode only */
-      const int ncol = 5;
-      char *names[] = {"RA", "DEC", "Z", "Z_COSMO", "STATUS"};
-      char *units[] = {"deg", "deg", NULL, NULL, NULL};
-      int dtypes[] = {TFLOAT, TFLOAT, TFLOAT, TFLOAT, TBYTE};
 
-      if (ofits_newfile(ofile, fitsname, ncol, names, units, dtypes)) {
-        free(fitsname);
-        return CUTSKY_ERR_FILE;
-      }
+    /* Process the remaining candidates of the observer. */
+    if (bat->ncand && cutsky_flush(zcvt, geom, bat, in, o, data))
+      return CUTSKY_ERR_CUTSKY;
+  }
+  return 0;
+}
 
-      for (int i = 0; i < ncat; i++) {
-        for (size_t j = 0; j < data[i]->n; j++) {
-          if (ofits_writeline(ofile, data[i]->x[0][j], data[i]->x[1][j],
-              data[i]->x[2][j], data[i]->x[3][j], data[i]->status[j])) {
-            free(fitsname);
-            return CUTSKY_ERR_FILE;
-          }
-        }
-      }
+/******************************************************************************
+Function `cutsky_lines`:
+  Parse lines of the ASCII-format input catalog, and push objects passing the
+  survey geometry test to the cut-sky catalogs.
+Arguments:
+  * `conf`:     structure for storing configurations;
+  * `zcvt`:     interface for distance to redshift conversion;
+  * `geom`:     interface for survey geometry;
+  * `bat`:      workspace for batched coordinate conversion;
+  * `ifile`:    interface for file reading, with lines to be processed;
+  * `istart`:   index of the first line to be processed;
+  * `iend`:     index of the line next to the last one to be processed;
+  * `data`:     cut-sky catalogs of all observers, tracers, and sky regions;
+  * `nbox`:     index of the first object in the lines, to be increased by
+                the number of objects read from the lines.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int cutsky_lines(const CONF *conf, const ZCVT *zcvt, const GEOM *geom,
+    BATCH *bat, const IFILE *ifile, const size_t istart, const size_t iend,
+    DATA *const *data, size_t *nbox) {
+  bat->nin = 0;
+  for (size_t i = istart; i < iend; i++) {
+    const char *line = record_start(ifile->chunk + ifile->lines[i],
+        conf->comment);
+    if (!line) continue;
+
+    /* Parse the line. */
+    if (parse_dbl_fields(line, 6, bat->in, bat->nin) != 6) {
+      P_ERR("failed to read data from line: %.*s\n",
+          (int) strcspn(line, "\n"), line);
+      return CUTSKY_ERR_FILE;
     }
-    else {                                      /* both bitcode and nz */
-      const int ncol = 7;
-      char *names[] = {
-          "RA", "DEC", "Z", "Z_COSMO", "NZ", "STATUS", "RAN_NUM_0_1"};
-      char *units[] = {"deg", "deg", NULL, NULL, NULL, NULL, NULL};
-      int dtypes[] = {TFLOAT, TFLOAT, TFLOAT, TFLOAT, TFLOAT, TBYTE, TFLOAT};
-
-      if (ofits_newfile(ofile, fitsname, ncol, names, units, dtypes)) {
-        free(fitsname);
-        return CUTSKY_ERR_FILE;
-      }
+    *nbox += 1;
 
-      for (int i = 0; i < ncat; i++) {
-        for (size_t j = 0; j < data[i]->n; j++) {
-          if (ofits_writeline(ofile, data[i]->x[0][j], data[i]->x[1][j],
-              data[i]->x[2][j], data[i]->x[3][j], data[i]->nz[j],
-              data[i]->status[j], data[i]->ran[j])) {
-            free(fitsname);
-            return CUTSKY_ERR_FILE;
-          }
-        }
-      }
+    /* Apply coordinate conversion and survey geometry by batch. */
+    if (++bat->nin == CUTSKY_DATA_CHUNK) {
+      if (cutsky_infoot(zcvt, geom, bat, bat->in, bat->nin, *nbox - bat->nin,
+          data)) return CUTSKY_ERR_CUTSKY;
+      bat->nin = 0;
     }
-
-    free(fitsname);
-    /* Close file. */
-    ofits_destroy(ofile);
-
   }
-#endif
 
+  /* Process the remaining objects. */
+  if (bat->nin && cutsky_infoot(zcvt, geom, bat, bat->in, bat->nin,
+      *nbox - bat->nin, data))
+    return CUTSKY_ERR_CUTSKY;
+  bat->nin = 0;
   return 0;
 }
 
 /******************************************************************************
-Function `process_serial`:
-  Process the input data catalogue serially.
+Function `cutsky_select`:
+  Apply the radial selection and the footprint of interest to objects in the
+  cut-sky catalogue, and record the results as bitcodes.
 Arguments:
   * `conf`:     structure for storing configurations;
-  * `zcvt`:     interface for redshift conversion;
-  * `geom`:     interface for survey geometry.
+  * `geom`:     interface for survey geometry;
+  * `icat`:     index of the catalogue, for the observer, tracer, and region;
+  * `dens_sim`: comoving number density of the simulation box;
+  * `off`:      offset of object indices in the keys of random numbers;
+  * `data`:     the cut-sky catalogue.
 Return:
   Zero on success; non-zero on error.
 ******************************************************************************/
-static int process_serial(const CONF *conf, const ZCVT *zcvt, const GEOM *geom)
-{
-  /* Process NGC and SGC individually. */
-  DATA *data[2] = {NULL, NULL};
-  const double ra_shift[2] = {60, 60};
-  bool is_ngc[2] = {false, false};
-
-  for (int i = 0; i < conf->ncap; i++) {
-    is_ngc[i] = (conf->gcap[i] == 'N');
-    if (!(data[i] = cutsky_init())) return CUTSKY_ERR_CUTSKY;
+static int cutsky_select(const CONF *conf, const GEOM *geom, const int icat,
+    const double dens_sim, const size_t off, DATA *data) {
+  const size_t n = data->n;
+  if (!n || (!conf->fnz && !conf->foot)) return 0;
+  const TRACER *trc = geom->trc + (icat / conf->nreg) % conf->ntrc;
+
+  /* Allocate memory, which is reused if the catalogue is refilled. */
+  uint8_t *status = realloc(data->status, n * sizeof(uint8_t));
+  if (!status) {
+    P_ERR("failed to allocate memory for the cut-sky catalog\n");
+    return CUTSKY_ERR_MEMORY;
   }
+  data->status = status;
+  memset(status, 0, n * sizeof(uint8_t));
 
-  size_t nline = CUTSKY_DATA_CHUNK;
-  size_t nbox = 0;      /* number of objects in the simulation box */
-
-#ifdef WITH_CFITSIO
-  if (conf->ifmt == CUTSKY_FFMT_ASCII) {        /* ASCII file */
-#endif
-
-    /* Open the file for reading. */
-    IFILE *ifile = input_init();
-    if (!ifile || input_newfile(ifile, conf->input)) {
-      cutsky_destroy(data[0]); cutsky_destroy(data[1]); input_destroy(ifile);
-      return CUTSKY_ERR_FILE;
+  if (conf->fnz) {      /* add columns for radial selection */
+    float *nz = realloc(data->nz, n * sizeof(float));
+    if (nz) data->nz = nz;
+    float *ran = realloc(data->ran, n * sizeof(float));
+    if (ran) data->ran = ran;
+    if (!nz || !ran) {
+      P_ERR("failed to allocate memory for the cut-sky catalog\n");
+      return CUTSKY_ERR_MEMORY;
     }
 
-    /* Read the input file by chunk. */
-    for (;;) {
-      if (input_readlines(ifile, nline)) {
-        cutsky_destroy(data[0]); cutsky_destroy(data[1]); input_destroy(ifile);
-        return CUTSKY_ERR_FILE;
-      }
-      if (!ifile->nline) break;
-
-      for (size_t i = 0; i < ifile->nline; i++) {
-        char *line = ifile->chunk + ifile->lines[i];
-        if (!line) {
-          P_ERR("failed to read line from the input catalog\n");
-          cutsky_destroy(data[0]); cutsky_destroy(data[1]);
-          input_destroy(ifile);
-          return CUTSKY_ERR_FILE;
-        }
-
-        while (isspace(*line)) ++line;  /* omit leading whitespaces */
-        if (*line == conf->comment || *line == '\0') continue;
-
-        /* Parse the line. */
-        double x, y, z, vx, vy, vz;
-        if (sscanf(line, "%lf %lf %lf %lf %lf %lf", &x, &y, &z, &vx, &vy, &vz)
-            != 6) {
-          P_ERR("failed to read data from line: %s\n", line);
-          cutsky_destroy(data[0]); cutsky_destroy(data[1]);
-          input_destroy(ifile);
-          return CUTSKY_ERR_FILE;
-        }
-        nbox += 1;
-
-        /* Apply coordinate conversion and survey geometry. */
-        if (cutsky_infoot(zcvt, geom, x, y, z, vx, vy, vz, conf->ncap,
-            ra_shift, is_ngc, data)) {
-          cutsky_destroy(data[0]); cutsky_destroy(data[1]);
-          input_destroy(ifile);
-          return CUTSKY_ERR_CUTSKY;
-        }
+    /* Random numbers depend only on the objects, but not the threads. */
+    for (size_t j = 0; j < n; j++) {
+      nz[j] = geom_get_nz(trc, data->x[2][j]);
+      const uint64_t key = crand_key_shift(data->key[j], off);
+      ran[j] = crand_double(geom->seed[0][icat], key);
+      if (ran[j] < nz[j] / dens_sim) status[j] = geom->rad_sel;
+
+      /* Further subsamples are indicated by the higher bits. */
+      for (int k = 1; k < geom->nsub; k++) {
+        if ((float) crand_double(geom->seed[k][icat], key) < nz[j] / dens_sim)
+          status[j] |= geom->rad_sel << k;
       }
     }
-
-    /* Close the input file. */
-    input_destroy(ifile);
-
-#ifdef WITH_CFITSIO
   }
-  else {                                        /* FITS file(s) */
-
-    /* Open the file for reading. */
-    IFFILE *ifile = ifits_init();
-    if (!ifile ||
-        ifits_newfiles(ifile, (const char **) conf->inputs, conf->ninput)) {
-      cutsky_destroy(data[0]); cutsky_destroy(data[1]); ifits_destroy(ifile);
-      return CUTSKY_ERR_FILE;
-    }
-
-    /* Read the input file by chunk. */
-    for (;;) {
-      if (ifits_readlines(ifile, nline)) {
-        cutsky_destroy(data[0]); cutsky_destroy(data[1]); ifits_destroy(ifile);
-        return CUTSKY_ERR_FILE;
-      }
-      if (!ifile->ndata) break;
-      nbox += ifile->ndata;
 
-      /* Apply coordinate conversion and survey geometry. */
-      for (size_t i = 0; i < ifile->ndata; i++) {
-        if (cutsky_infoot(zcvt, geom, ifile->data[0][i], ifile->data[1][i],
-            ifile->data[2][i], ifile->data[3][i], ifile->data[4][i],
-            ifile->data[5][i], conf->ncap, ra_shift, is_ngc, data)) {
-          cutsky_destroy(data[0]); cutsky_destroy(data[1]);
-          ifits_destroy(ifile);
-          return CUTSKY_ERR_CUTSKY;
-        }
-      }
+  /* Apply the current footprint of interest. */
+  if (conf->foot) {
+    for (size_t j = 0; j < n; j++) {
+      if (geom_infoot(geom->foot, data->x[0][j], data->x[1][j]))
+        status[j] += geom->infoot;
     }
+  }
+  return 0;
+}
 
-    /* Close the input file. */
-    ifits_destroy(ifile);
-
+/******************************************************************************
+Function `cutsky_count`:
+  Count objects in the input catalog without parsing them, for streaming the
+  outputs with radial selection.
+Arguments:
+  * `conf`:     structure for storing configurations;
+  * `num`:      number of objects in the simulation box.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int cutsky_count(const CONF *conf, size_t *num) {
+  if (conf->ndata != DEFAULT_NDATA) {
+    *num = conf->ndata;
+    return 0;
   }
+
+  int ecode;
+#ifdef WITH_CFITSIO
+  if (conf->ifmt != CUTSKY_FFMT_ASCII)
+    ecode = ifits_count_rows((const char **) conf->inputs, conf->ninput, num);
+  else
 #endif
+    ecode = input_count_records(conf->input, 0, SIZE_MAX, conf->comment, num);
+  if (ecode) return CUTSKY_ERR_FILE;
 
-  if (!nbox) {
+  if (!*num) {
     P_ERR("no data in the input catalog\n");
-    cutsky_destroy(data[0]); cutsky_destroy(data[1]);
     return CUTSKY_ERR_FILE;
   }
+  if (conf->verbose)
+    printf("  %zu objects counted in the input catalog\n", *num);
+  return 0;
+}
 
-  if (conf->fnz && conf->ndata != DEFAULT_NDATA) {
-    if (fabs((double) conf->ndata - nbox) >
-        (double) nbox * CUTSKY_NDATA_MISMATCH) {
-      P_WRN("mismatched number of objects: %ld from the configuration, "
-          "while %zu in the catalog\n"
-          "Using the number in the configuration anyway\n",
-          conf->ndata, nbox);
+
+/******************************************************************************
+Function `thin_setup`:
+  Set the thresholds of random numbers for pre-thinning, which are the
+  maximum probabilities of the radial selection for the tracers.
+Arguments:
+  * `conf`:     structure for storing configurations;
+  * `geom`:     interface for survey geometry;
+  * `dens_sim`: comoving number density of the simulation box;
+  * `bat`:      workspaces for batched coordinate conversion;
+  * `nbat`:     number of workspaces.
+******************************************************************************/
+static void thin_setup(const CONF *conf, const GEOM *geom,
+    const double dens_sim, BATCH *const *bat, const int nbat) {
+  if (!conf->thin) return;
+
+  double pthin[CUTSKY_MAX_TRACER];
+  bool thin = true;
+  for (int i = 0; i < geom->ntrc; i++) {
+    const TRACER *trc = geom->trc + i;
+    /* Redshifts and n(z) are saved in single precision for the selection. */
+    const float nzmax = geom_max_nz(trc, (float) trc->zmin, (float) trc->zmax);
+    pthin[i] = nzmax / dens_sim;
+    if (pthin[i] >= 1) {
+      P_WRN("pre-thinning is disabled%s, as the maximum probability of the "
+          "radial selection is not below 1\n",
+          (geom->ntrc > 1) ? " for a tracer" : "");
+      thin = false;
+    }
+    else if (conf->verbose) {
+      if (geom->ntrc > 1) printf("  Pre-thinning objects of tracer %d with "
+          "probability %g\n", i + 1, pthin[i]);
+      else printf("  Pre-thinning objects with probability %g\n", pthin[i]);
     }
-    nbox = conf->ndata;
   }
-  if (conf->verbose)
-    printf("  %zu objects read from the input catalog\n", nbox);
 
-  /* Reduce memory cost if applicable. */
-  for (int i = 0; i < conf->ncap; i++) {
-    if (!data[i]->n) {
-      P_WRN("no data after footprint trimming for %cGC\n", conf->gcap[i]);
-      continue;
+  for (int j = 0; j < nbat; j++) {
+    for (int i = 0; i < geom->ntrc; i++) bat[j]->pthin[i] = pthin[i];
+    bat[j]->thin = thin;
+  }
+}
+
+
+/*============================================================================*\
+                   Functions for saving the cut-sky catalogue
+\*============================================================================*/
+
+/******************************************************************************
+Function `cutsky_ncol`:
+  Number of columns of the output catalogs.
+Arguments:
+  * `conf`:     structure for storing configurations.
+Return:
+  4 without bitcodes and nz; 5 with bitcodes only; 7 with both.
+******************************************************************************/
+static inline int cutsky_ncol(const CONF *conf) {
+  return conf->fnz ? 7 : (conf->foot ? 5 : 4);
+}
+
+/******************************************************************************
+Function `cat_label`:
+  Label of an output catalog for messages, i.e., the galactic cap or sky
+  region, followed by the indices of the tracer and observer if there are
+  multiple of them.
+Arguments:
+  * `conf`:     structure for storing configurations;
+  * `icat`:     index of the catalog.
+Return:
+  The label, which is overwritten by the next call.
+******************************************************************************/
+static const char *cat_label(const CONF *conf, const int icat) {
+  static char label[64];
+  const int ireg = icat % conf->nreg;
+  const int itrc = (icat / conf->nreg) % conf->ntrc;
+  const int iobs = icat / (conf->nreg * conf->ntrc);
+  int n = conf->reg ? snprintf(label, sizeof label, "region %d", ireg + 1) :
+      snprintf(label, sizeof label, "%cGC", conf->gcap[ireg]);
+  if (conf->ntrc > 1)
+    n += snprintf(label + n, sizeof label - n, " of tracer %d", itrc + 1);
+  if (conf->nobs > 1)
+    snprintf(label + n, sizeof label - n, " for observer %d", iobs + 1);
+  return label;
+}
+
+/******************************************************************************
+Function `ocat_close`:
+  Close the output catalogue and release the interface.
+Arguments:
+  * `ocat`:     interface for writing the cut-sky catalogue.
+******************************************************************************/
+static void ocat_close(OCAT *ocat) {
+  if (!ocat) return;
+  output_destroy(ocat->ofile);
+#ifdef WITH_CFITSIO
+  ofits_destroy(ocat->offile);
+#endif
+  free(ocat);
+}
+
+/******************************************************************************
+Function `ocat_header`:
+  Write the header of an ASCII-format output catalogue.
+Arguments:
+  * `ocat`:     interface for writing the cut-sky catalogue.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int ocat_header(OCAT *ocat) {
+  const char *header = (ocat->ncol == 4) ?
+      "%c RA(1) DEC(2) Z(3) Z_COSMO(4)\n" : ((ocat->ncol == 5) ?
+      "%c RA(1) DEC(2) Z(3) Z_COSMO(4) STATUS(5)\n" :
+      "%c RA(1) DEC(2) Z(3) Z_COSMO(4) NZ(5) STATUS(6) RAN_NUM_0_1(7)\n");
+  return output_writeline(ocat->ofile, header, CUTSKY_SAVE_COMMENT);
+}
+
+/******************************************************************************
+Function `ocat_open`:
+  Create an output catalogue and write the header.
+Arguments:
+  * `fname`:    name of the output file;
+  * `fmt`:      format of the output file;
+  * `ncol`:     number of columns, see `cutsky_ncol`.
+Return:
+  Interface for writing the cut-sky catalogue on success; NULL on error.
+******************************************************************************/
+static OCAT *ocat_open(const char *fname, const CUTSKY_FFMT fmt,
+    const int ncol) {
+  OCAT *ocat = calloc(1, sizeof *ocat);
+  if (!ocat) {
+    P_ERR("failed to allocate memory for catalog writing\n");
+    return NULL;
+  }
+  ocat->fmt = fmt;
+  ocat->ncol = ncol;
+
+#ifdef WITH_CFITSIO
+  if (fmt == CUTSKY_FFMT_ASCII) {        /* ASCII file */
+#endif
+
+    /* Open the output file for writing. */
+    if (!(ocat->ofile = output_init()) ||
+        output_newfile(ocat->ofile, fname)) {
+      ocat_close(ocat);
+      return NULL;
     }
-    if (data[i]->n < data[i]->max) {
-      for (int j = 0; j < 4; j++) {
-        float *tmp = realloc(data[i]->x[j], data[i]->n * sizeof(float));
-        if (tmp) data[i]->x[j] = tmp;
-      }
+
+    /* Header. */
+    if (ocat_header(ocat)) {
+      ocat_close(ocat);
+      return NULL;
     }
+
+#ifdef WITH_CFITSIO
   }
+  else {                                        /* FITS file */
 
-  if (conf->fnz) {      /* add columns for radial selection */
-    for (int i = 0; i < conf->ncap; i++) {
-      if (!data[i]->n) continue;
+    /* Allocate memory for the filename. */
+    const size_t len = strlen(fname) + 1;
+    char *fitsname = malloc(len + 1);
+    if (!fitsname) {
+      P_ERR("failed to allocate memory for catalog writing\n");
+      ocat_close(ocat);
+      return NULL;
+    }
+    fitsname[0] = '!';
+    strncpy(fitsname + 1, fname, len);
 
-      /* Allocate memory. */
-      if (!(data[i]->nz = malloc(data[i]->n * sizeof(float))) ||
-          !(data[i]->ran = malloc(data[i]->n * sizeof(float))) ||
-          !(data[i]->status = calloc(data[i]->n, sizeof(uint8_t)))) {
-        P_ERR("failed to allocate memory for the cut-sky catalog\n");
-        cutsky_destroy(data[0]); cutsky_destroy(data[1]);
-        return CUTSKY_ERR_MEMORY;
-      }
+    /* Setup columns, with STATUS in place of NZ for bitcodes only. */
+    char *names[] = {
+        "RA", "DEC", "Z", "Z_COSMO", "NZ", "STATUS", "RAN_NUM_0_1"};
+    char *units[] = {"deg", "deg", NULL, NULL, NULL, NULL, NULL};
+    int dtypes[] = {TFLOAT, TFLOAT, TFLOAT, TFLOAT, TFLOAT, TBYTE, TFLOAT};
+    if (ncol == 5) {
+      names[4] = "STATUS";
+      dtypes[4] = TBYTE;
+    }
+
+    /* Open the output file for writing. */
+    if (!(ocat->offile = ofits_init()) ||
+        ofits_newfile(ocat->offile, fitsname, ncol, names, units, dtypes)) {
+      free(fitsname);
+      ocat_close(ocat);
+      return NULL;
+    }
+    free(fitsname);
+
+  }
+#endif
+
+  return ocat;
+}
+
+/******************************************************************************
+Function `ocat_write`:
+  Write a range of objects of a cut-sky catalogue to the output catalogue.
+Arguments:
+  * `ocat`:     interface for writing the cut-sky catalogue;
+  * `data`:     the cut-sky catalogue to be saved;
+  * `istart`:   index of the first object to be saved;
+  * `iend`:     index of the object next to the last one to be saved.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int ocat_write(OCAT *ocat, const DATA *data, const size_t istart,
+    const size_t iend) {
+  float *const *x = data->x;
+  const float *nz = data->nz;
+  const float *ran = data->ran;
+  const uint8_t *status = data->status;
+  int err = 0;
+
+#ifdef WITH_CFITSIO
+  if (ocat->fmt == CUTSKY_FFMT_ASCII) {        /* ASCII file */
+#endif
+    OFILE *ofile = ocat->ofile;
+    if (ocat->ncol == 4) {                      /* no bitcode and nz */
+      for (size_t j = istart; !err && j < iend; j++)
+        err = output_writeline(ofile, OFMT_FLT " " OFMT_FLT " " OFMT_FLT " "
+            OFMT_FLT "\n", x[0][j], x[1][j], x[2][j], x[3][j]);
+    }
+    else if (ocat->ncol == 5) {                 /* bitcode only */
+      for (size_t j = istart; !err && j < iend; j++)
+        err = output_writeline(ofile, OFMT_FLT " " OFMT_FLT " " OFMT_FLT " "
+            OFMT_FLT " %" PRId8 "\n", x[0][j], x[1][j], x[2][j], x[3][j],
+            status[j]);
+    }
+    else {                                      /* both bitcode and nz */
+      for (size_t j = istart; !err && j < iend; j++)
+        err = output_writeline(ofile, OFMT_FLT " " OFMT_FLT " " OFMT_FLT " "
+            OFMT_FLT " " OFMT_FLT " %" PRId8 " " OFMT_FLT "\n", x[0][j],
+            x[1][j], x[2][j], x[3][j], nz[j], status[j], ran[j]);
+    }
+#ifdef WITH_CFITSIO
+  }
+  else {                                        /* FITS file */
+    OFFILE *ofile = ocat->offile;
+    if (ocat->ncol == 4) {                      /* no bitcode and nz */
+      for (size_t j = istart; !err && j < iend; j++)
+        err = ofits_writeline(ofile, x[0][j], x[1][j], x[2][j], x[3][j]);
+    }
+    else if (ocat->ncol == 5) {                 /* bitcode only */
+      for (size_t j = istart; !err && j < iend; j++)
+        err = ofits_writeline(ofile, x[0][j], x[1][j], x[2][j], x[3][j],
+            status[j]);
+    }
+    else {                                      /* both bitcode and nz */
+      for (size_t j = istart; !err && j < iend; j++)
+        err = ofits_writeline(ofile, x[0][j], x[1][j], x[2][j], x[3][j],
+            nz[j], status[j], ran[j]);
+    }
+  }
+#endif
+
+  if (err) return CUTSKY_ERR_FILE;
+  ocat->n += iend - istart;
+  return 0;
+}
+
+/******************************************************************************
+Function `cutsky_save`:
+  Save the cut-sky catalogue to an output file.
+Arguments:
+  * `conf`:     structure for storing configurations;
+  * `fname`:    name of the output file;
+  * `data`:     array of cut-sky catalogues to be saved;
+  * `ncat`:     number of cut-sky catalogues.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int cutsky_save(const CONF *conf, const char *fname, DATA **data,
+    const int ncat) {
+  OCAT *ocat = ocat_open(fname, conf->ofmt, cutsky_ncol(conf));
+  if (!ocat) return CUTSKY_ERR_FILE;
+  for (int i = 0; i < ncat; i++) {
+    if (ocat_write(ocat, data[i], 0, data[i]->n)) {
+      ocat_close(ocat);
+      return CUTSKY_ERR_FILE;
+    }
+  }
+  ocat_close(ocat);
+  return 0;
+}
+
+/******************************************************************************
+Function `cutsky_stream`:
+  Apply the selection to the buffered cut-sky catalogues, append them to the
+  output files, and empty the buffers.
+Arguments:
+  * `conf`:     structure for storing configurations;
+  * `geom`:     interface for survey geometry;
+  * `dens_sim`: comoving number density of the simulation box;
+  * `data`:     buffered cut-sky catalogs, with global object indices;
+  * `ocat`:     output catalogs, which are opened on the first write.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int cutsky_stream(const CONF *conf, const GEOM *geom,
+    const double dens_sim, DATA *const *data, OCAT **ocat) {
+  for (int i = 0; i < conf->ncat; i++) {
+    if (!data[i]->n) continue;
+    if (cutsky_select(conf, geom, i, dens_sim, 0, data[i]))
+      return CUTSKY_ERR_MEMORY;
+
+    int ecode = 0;
+#ifdef OMP
+#pragma omp critical (cutsky_stream)
+#endif
+    {
+      if (!ocat[i] && !(ocat[i] = ocat_open(conf->output[i], conf->ofmt,
+          cutsky_ncol(conf)))) ecode = CUTSKY_ERR_FILE;
+      else if (ocat_write(ocat[i], data[i], 0, data[i]->n))
+        ecode = CUTSKY_ERR_FILE;
+    }
+    if (ecode) return ecode;
+    data[i]->n = 0;
+  }
+  return 0;
+}
+
+#ifdef OMP
+/******************************************************************************
+Function `seg_reserve`:
+  Enlarge the array of sub-chunk segments if necessary.
+Arguments:
+  * `seg`:      address of the array of segments;
+  * `pos`:      address of the array for ranges of the segments;
+  * `max`:      capacity of the arrays;
+  * `num`:      number of segments to be stored;
+  * `ncat`:     number of cut-sky catalogs.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int seg_reserve(SEG **seg, size_t **pos, size_t *max, const size_t num,
+    const int ncat) {
+  if (num <= *max) return 0;
+  size_t size = *max ? *max : CUTSKY_DATA_CHUNK / CUTSKY_OMP_SUBCHUNK;
+  while (size < num) size <<= 1;
+  SEG *tmp = realloc(*seg, size * sizeof(SEG));
+  if (!tmp) {
+    P_ERR("failed to allocate memory for indices of the input\n");
+    return CUTSKY_ERR_MEMORY;
+  }
+  *seg = tmp;
+  /* Ranges are sized by the number of catalogs, rather than the maximum. */
+  size_t *ptmp = realloc(*pos, size * 2 * ncat * sizeof(size_t));
+  if (!ptmp) {
+    P_ERR("failed to allocate memory for indices of the input\n");
+    return CUTSKY_ERR_MEMORY;
+  }
+  *pos = ptmp;
+  for (size_t i = 0; i < size; i++) {
+    tmp[i].start = ptmp + 2 * ncat * i;
+    tmp[i].end = tmp[i].start + ncat;
+  }
+  *max = size;
+  return 0;
+}
+
+/******************************************************************************
+Function `seg_mark`:
+  Record the current sizes of the cut-sky catalogs of a thread.
+Arguments:
+  * `ncat`:     number of cut-sky catalogs;
+  * `data`:     cut-sky catalogs of the thread;
+  * `pos`:      the recorded sizes.
+******************************************************************************/
+static inline void seg_mark(const int ncat, DATA *const *data, size_t *pos) {
+  for (int i = 0; i < ncat; i++) pos[i] = data[i]->n;
+}
+
+/******************************************************************************
+Function `thread_data`:
+  Collect the cut-sky catalogs of a thread.
+Arguments:
+  * `ncat`:     number of cut-sky catalogs;
+  * `pdata`:    cut-sky catalogs of all threads;
+  * `tid`:      ID of the thread;
+  * `data`:     the collected cut-sky catalogs.
+******************************************************************************/
+static inline void thread_data(const int ncat, DATA **const *pdata,
+    const int tid, DATA **data) {
+  for (int i = 0; i < ncat; i++) data[i] = pdata[i][tid];
+}
+
+/******************************************************************************
+Function `cutsky_save_seg`:
+  Save the cut-sky catalogs produced by sub-chunks in the order of sequence
+  numbers of the sub-chunks, i.e., the order of the input catalog.
+Arguments:
+  * `conf`:     structure for storing configurations;
+  * `icat`:     index of the catalog, for the observer, tracer, and region;
+  * `data`:     cut-sky catalogs of all threads for the catalog;
+  * `seg`:      segments of the sub-chunks, indexed by sequence numbers;
+  * `nseg`:     number of segments;
+  * `ocat`:     the output catalog, which is opened if it is NULL.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int cutsky_save_seg(const CONF *conf, const int icat, DATA *const *data,
+    const SEG *seg, const size_t nseg, OCAT **ocat) {
+  if (!*ocat && !(*ocat = ocat_open(conf->output[icat], conf->ofmt,
+      cutsky_ncol(conf)))) return CUTSKY_ERR_FILE;
+  for (size_t i = 0; i < nseg; i++) {
+    if (seg[i].start[icat] < seg[i].end[icat] && ocat_write(*ocat,
+        data[seg[i].tid], seg[i].start[icat], seg[i].end[icat]))
+      return CUTSKY_ERR_FILE;
+  }
+  return 0;
+}
+
+/******************************************************************************
+Function `cutsky_stream_seg`:
+  Apply the selection to the buffered cut-sky catalogs of all threads, append
+  them to the output files in the order of sub-chunks, and empty the buffers.
+Arguments:
+  * `conf`:     structure for storing configurations;
+  * `pdata`:    buffered cut-sky catalogs of all threads, after selection;
+  * `seg`:      segments of the sub-chunks, indexed by sequence numbers;
+  * `nseg`:     number of segments;
+  * `ocat`:     output catalogs, which are opened on the first write.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int cutsky_stream_seg(const CONF *conf, DATA **const *pdata,
+    const SEG *seg, const size_t nseg, OCAT **ocat) {
+  for (int i = 0; i < conf->ncat; i++) {
+    size_t ndata = 0;
+    for (int j = 0; j < conf->nthread; j++) ndata += pdata[i][j]->n;
+    if (!ndata) continue;
+    if (cutsky_save_seg(conf, i, pdata[i], seg, nseg, ocat + i))
+      return CUTSKY_ERR_FILE;
+    for (int j = 0; j < conf->nthread; j++) pdata[i][j]->n = 0;
+  }
+  return 0;
+}
+#endif
+
+
+/*============================================================================*\
+                       Functions for reusing the buffers
+\*============================================================================*/
+
+/******************************************************************************
+Function `cutsky_acquire`:
+  Take an empty cut-sky catalogue from the pool, or create a new one.
+Arguments:
+  * `pbuf`:     the pool of reusable buffers, NULL for disabling reuse;
+  * `with_key`: true for recording keys of random numbers.
+Return:
+  Instance of the cut-sky catalogue on success; NULL on error.
+******************************************************************************/
+static DATA *cutsky_acquire(PBUF *pbuf, const bool with_key) {
+  if (!pbuf || !pbuf->ndata) return cutsky_init(with_key);
+  DATA *data = pbuf->data[--pbuf->ndata];
+  data->n = 0;
+  return data;
+}
+
+/******************************************************************************
+Function `cutsky_release`:
+  Return a cut-sky catalogue to the pool, or deconstruct it.
+Arguments:
+  * `pbuf`:     the pool of reusable buffers, NULL for disabling reuse;
+  * `data`:     instance of the cut-sky catalogue.
+******************************************************************************/
+static void cutsky_release(PBUF *pbuf, DATA *data) {
+  if (!data) return;
+  if (!pbuf || pbuf->ndata == pbuf->max) cutsky_destroy(data);
+  else pbuf->data[pbuf->ndata++] = data;
+}
 
-      /* Compute the comoving number density. */
-      double dens_sim = nbox / pow(conf->Lbox, 3);
-
-      /* Reset random number generator. */
-      int err = 0;
-      prand_t *rng = geom->rng;
-      rng->reset(rng->state, geom->seed[i], 0, &err);
-      if (PRAND_IS_ERROR(err) || PRAND_IS_WARN(err)) {
-        P_ERR("failed to set the random number generator\n");
-        cutsky_destroy(data[0]); cutsky_destroy(data[1]);
-        return CUTSKY_ERR_RAND;
+/******************************************************************************
+Function `batch_acquire`:
+  Take a batch workspace from the pool, or create a new one.
+Arguments:
+  * `pbuf`:     the pool of reusable buffers, NULL for disabling reuse.
+Return:
+  Instance of the workspace on success; NULL on error.
+******************************************************************************/
+static BATCH *batch_acquire(PBUF *pbuf) {
+  if (!pbuf || !pbuf->nbat) return batch_init();
+  BATCH *bat = pbuf->bat[--pbuf->nbat];
+  bat->nin = bat->ncand = 0;
+  for (int i = 0; i < CUTSKY_MAX_TRACER; i++) bat->pthin[i] = HUGE_VAL;
+  bat->thin = false;
+  return bat;
+}
+
+/******************************************************************************
+Function `batch_release`:
+  Return a batch workspace to the pool, or deconstruct it.
+Arguments:
+  * `pbuf`:     the pool of reusable buffers, NULL for disabling reuse;
+  * `bat`:      the workspace for batched coordinate conversion.
+******************************************************************************/
+static void batch_release(PBUF *pbuf, BATCH *bat) {
+  if (!bat) return;
+  if (!pbuf || pbuf->nbat == pbuf->max) batch_destroy(bat);
+  else pbuf->bat[pbuf->nbat++] = bat;
+}
+
+/******************************************************************************
+Function `process_serial`:
+  Process the input data catalogue serially.
+Arguments:
+  * `conf`:     structure for storing configurations;
+  * `zcvt`:     interface for redshift conversion;
+  * `geom`:     interface for survey geometry.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int process_serial(const CONF *conf, const ZCVT *zcvt, const GEOM *geom,
+    PBUF *pbuf) {
+  /* Process sky regions of each tracer individually. */
+  DATA *data[CUTSKY_MAX_NCAT] = {NULL};
+  OCAT *ocat[CUTSKY_MAX_NCAT] = {NULL}; /* outputs for streaming */
+  for (int i = 0; i < conf->ncat; i++) {
+    if (!(data[i] = cutsky_acquire(pbuf, conf->fnz != NULL))) {
+      DATA_CLEAN_SERIAL;
+      return CUTSKY_ERR_CUTSKY;
+    }
+  }
+
+  size_t nline = CUTSKY_DATA_CHUNK;
+  size_t nbox = 0;      /* number of objects in the simulation box */
+
+  /* The density of the box is needed beforehand for streaming and
+     pre-thinning. */
+  double dens_sim = 0;
+  if ((conf->ostream || conf->thin) && conf->fnz) {
+    size_t ntot;
+    if (cutsky_count(conf, &ntot)) {
+      DATA_CLEAN_SERIAL;
+      return CUTSKY_ERR_FILE;
+    }
+    dens_sim = ntot / pow(conf->Lbox, 3);
+  }
+
+  /* Workspace for processing objects in batches. */
+  BATCH *bat = batch_acquire(pbuf);
+  if (!bat) {
+    DATA_CLEAN_SERIAL;
+    return CUTSKY_ERR_MEMORY;
+  }
+  thin_setup(conf, geom, dens_sim, &bat, 1);
+
+#ifdef WITH_CFITSIO
+  if (conf->ifmt == CUTSKY_FFMT_ASCII) {        /* ASCII file */
+#endif
+
+    /* Open the file for reading. */
+    IFILE *ifile = input_init();
+    if (!ifile || (conf->immap ? input_newfile_mmap(ifile, conf->input) :
+        input_newfile(ifile, conf->input))) {
+      DATA_CLEAN_SERIAL; input_destroy(ifile);
+      batch_release(pbuf, bat);
+      return CUTSKY_ERR_FILE;
+    }
+
+    /* Read the input file by chunk. */
+    for (;;) {
+      if (input_readlines(ifile, nline)) {
+        DATA_CLEAN_SERIAL; input_destroy(ifile);
+        batch_release(pbuf, bat);
+        return CUTSKY_ERR_FILE;
       }
+      if (!ifile->nline) break;
 
-      /* Apply radial selection. */
-      for (size_t j = 0; j < data[i]->n; j++) {
-        data[i]->nz[j] = geom_get_nz(geom, data[i]->x[2][j]);
-        data[i]->ran[j] = rng->get_double(rng->state);
-        double prop = data[i]->nz[j] / dens_sim;
-        if (data[i]->ran[j] < prop) data[i]->status[j] = geom->rad_sel;
-
-        /* Apply the current footprint of interest. */
-        if (conf->foot &&
-            geom_infoot(geom->foot[1], data[i]->x[0][j], data[i]->x[1][j]))
-          data[i]->status[j] += geom->infoot;
+      int ecode;
+      if ((ecode = cutsky_lines(conf, zcvt, geom, bat, ifile, 0, ifile->nline,
+          data, &nbox)) || (conf->ostream &&
+          (ecode = cutsky_stream(conf, geom, dens_sim, data, ocat)))) {
+        DATA_CLEAN_SERIAL;
+        input_destroy(ifile); batch_release(pbuf, bat);
+        return ecode;
       }
     }
-  }     /* if (conf->fnz) */
-  else if (conf->foot) {        /* add bitcodes for footprint */
-    for (int i = 0; i < conf->ncap; i++) {
-      if (!data[i]->n) continue;
 
-      /* Allocate memory. */
-      if (!(data[i]->status = calloc(data[i]->n, sizeof(uint8_t)))) {
-        P_ERR("failed to allocate memory for the cut-sky catalog\n");
-        cutsky_destroy(data[0]); cutsky_destroy(data[1]);
-        return CUTSKY_ERR_MEMORY;
+    /* Close the input file. */
+    input_destroy(ifile);
+
+#ifdef WITH_CFITSIO
+  }
+  else {                                        /* FITS file(s) */
+
+    /* Open the file for reading. */
+    IFFILE *ifile = ifits_init();
+    if (!ifile ||
+        ifits_newfiles(ifile, (const char **) conf->inputs, conf->ninput)) {
+      DATA_CLEAN_SERIAL; ifits_destroy(ifile);
+      batch_release(pbuf, bat);
+      return CUTSKY_ERR_FILE;
+    }
+
+    /* Read the input file by chunk. */
+    for (;;) {
+      if (ifits_readlines(ifile, nline)) {
+        DATA_CLEAN_SERIAL; ifits_destroy(ifile);
+        batch_release(pbuf, bat);
+        return CUTSKY_ERR_FILE;
       }
+      if (!ifile->ndata) break;
 
-      /* Check footprint. */
-      for (size_t j = 0; j < data[i]->n; j++) {
-        if (geom_infoot(geom->foot[1], data[i]->x[0][j], data[i]->x[1][j]))
-          data[i]->status[j] = geom->infoot;
+      /* Apply coordinate conversion and survey geometry. */
+      int ecode;
+      if ((ecode = cutsky_infoot(zcvt, geom, bat, ifile->data, ifile->ndata,
+          nbox, data)) || (conf->ostream &&
+          (ecode = cutsky_stream(conf, geom, dens_sim, data, ocat)))) {
+        DATA_CLEAN_SERIAL;
+        ifits_destroy(ifile); batch_release(pbuf, bat);
+        return ecode;
       }
+      nbox += ifile->ndata;
+    }
+
+    /* Close the input file. */
+    ifits_destroy(ifile);
+
+  }
+#endif
+
+  batch_release(pbuf, bat);
+
+  if (!nbox) {
+    P_ERR("no data in the input catalog\n");
+    DATA_CLEAN_SERIAL;
+    return CUTSKY_ERR_FILE;
+  }
+
+  if (conf->fnz && conf->ndata != DEFAULT_NDATA) {
+    if (fabs((double) conf->ndata - nbox) >
+        (double) nbox * CUTSKY_NDATA_MISMATCH) {
+      P_WRN("mismatched number of objects: %ld from the configuration, "
+          "while %zu in the catalog\n"
+          "Using the number in the configuration anyway\n",
+          conf->ndata, nbox);
+    }
+    nbox = conf->ndata;
+  }
+  if (conf->verbose)
+    printf("  %zu objects read from the input catalog\n", nbox);
+
+  /* The catalogues are saved already with streaming. */
+  if (conf->ostream) {
+    for (int i = 0; i < conf->ncat; i++) {
+      if (!ocat[i])
+        P_WRN("no data after footprint trimming for %s\n",
+            cat_label(conf, i));
+      else if (conf->verbose)
+        printf("  %zu objects saved to the output for %s\n",
+            ocat[i]->n, cat_label(conf, i));
+    }
+    DATA_CLEAN_SERIAL;
+    return 0;
+  }
+
+  /* Compute the comoving number density. */
+  dens_sim = nbox / pow(conf->Lbox, 3);
+
+  for (int i = 0; i < conf->ncat; i++) {
+    if (!data[i]->n) {
+      P_WRN("no data after footprint trimming for %s\n", cat_label(conf, i));
+      continue;
+    }
+
+    /* Reduce memory cost if the buffers are not reused. */
+    if (!pbuf && data[i]->n < data[i]->max) {
+      for (int j = 0; j < 4; j++) {
+        float *tmp = realloc(data[i]->x[j], data[i]->n * sizeof(float));
+        if (tmp) data[i]->x[j] = tmp;
+      }
+    }
+
+    /* Apply radial selection and the footprint of interest. */
+    if (cutsky_select(conf, geom, i, dens_sim, 0, data[i])) {
+      DATA_CLEAN_SERIAL;
+      return CUTSKY_ERR_MEMORY;
+    }
+
+    /* The keys of random numbers are no longer needed. */
+    if (!pbuf && data[i]->key) {
+      free(data[i]->key);
+      data[i]->key = NULL;
     }
   }
 
   /* Save the catalogues. */
-  for (int i = 0; i < conf->ncap; i++) {
+  for (int i = 0; i < conf->ncat; i++) {
     if (!data[i]->n) continue;
-    if (cutsky_save(conf->output[i], conf->ofmt, &(data[i]), 1)) {
-      for (int j = i; j < conf->ncap; j++) cutsky_destroy(data[j]);
+    if (cutsky_save(conf, conf->output[i], &(data[i]), 1)) {
+      for (int j = i; j < conf->ncat; j++) cutsky_release(pbuf, data[j]);
       return CUTSKY_ERR_FILE;
     }
 
-    if (conf->verbose) printf("  %zu objects saved to the output for %cGC\n",
-        data[i]->n, conf->gcap[i]);
-    cutsky_destroy(data[i]);
+    if (conf->verbose) printf("  %zu objects saved to the output for %s\n",
+        data[i]->n, cat_label(conf, i));
+    cutsky_release(pbuf, data[i]);
   }
   return 0;
 }
@@ -696,49 +1538,51 @@ Arguments:
 Return:
   Zero on success; non-zero on error.
 ******************************************************************************/
-static int process_omp(const CONF *conf, const ZCVT *zcvt, const GEOM *geom) {
-  /* Allocate memory for NGC and SGC. */
-  DATA **pdata[2] = {NULL, NULL};
-  DATA_CHUNK **pchunk[2] = {NULL, NULL};
-  const double ra_shift[2] = {60, 60};
-  bool is_ngc[2] = {false, false};
-
-  for (int i = 0; i < conf->ncap; i++) {
-    is_ngc[i] = (conf->gcap[i] == 'N');
+static int process_omp(const CONF *conf, const ZCVT *zcvt, const GEOM *geom,
+    PBUF *pbuf) {
+  /* Allocate memory for sky regions of each tracer. */
+  DATA **pdata[CUTSKY_MAX_NCAT] = {NULL};
+  OCAT *ocat[CUTSKY_MAX_NCAT] = {NULL}; /* outputs for streaming */
+  size_t *ioff = NULL;  /* offsets of object indices for different threads */
+  SEG *seg = NULL;      /* segments of sub-chunks, in the order of input */
+  size_t *segpos = NULL;        /* ranges of catalogs for the segments */
+  size_t nseg = 0, maxseg = 0;
+  for (int i = 0; i < conf->ncat; i++) {
     if (!(pdata[i] = malloc(conf->nthread * sizeof(DATA *)))) {
       P_ERR("failed to allocate memory for the cut-sky catalog\n");
       for (int ii = 0; ii < i; ii++) {
-        for (int j = 0; j < conf->nthread; j++) cutsky_destroy(pdata[ii][j]);
+        for (int j = 0; j < conf->nthread; j++)
+          cutsky_release(pbuf, pdata[ii][j]);
         free(pdata[ii]);
       }
       return CUTSKY_ERR_MEMORY;
     }
 
     for (int j = 0; j < conf->nthread; j++) {
-      if (!(pdata[i][j]= cutsky_init())) {
+      if (!(pdata[i][j] = cutsky_acquire(pbuf, conf->fnz != NULL))) {
         P_ERR("failed to callocate memory for the cut-sky catalog\n");
         for (int ii = 0; ii < i; ii++) {
           for (int jj = 0; jj < conf->nthread; jj++)
-            cutsky_destroy(pdata[ii][jj]);
+            cutsky_release(pbuf, pdata[ii][jj]);
           free(pdata[ii]);
         }
-        for (int jj = 0; jj < j; jj++) cutsky_destroy(pdata[i][jj]);
+        for (int jj = 0; jj < j; jj++) cutsky_release(pbuf, pdata[i][jj]);
         free(pdata[i]);
         return CUTSKY_ERR_MEMORY;
       }
     }
   }
 
-  for (int i = 0; i < conf->ncap; i++) {
-    if (!(pchunk[i] = chunk_init(conf->nthread))) {
-      for (int ii = 0; ii < conf->ncap; ii++) {
-        for (int j = 0; j < conf->nthread; j++) cutsky_destroy(pdata[ii][j]);
-        free(pdata[ii]);
-      }
-      for (int ii = 0; ii < i; ii++) {
-        for (int j = 0; j < conf->nthread; j++) chunk_destroy(pchunk[ii][j]);
-        free(pchunk[ii]);
-      }
+  /* Allocate memory for the thread-private batch workspaces. */
+  BATCH **pbatch = calloc(conf->nthread, sizeof(BATCH *));
+  if (!pbatch) {
+    P_ERR("failed to allocate memory for the batch workspaces\n");
+    DATA_CLEAN_OMP;
+    return CUTSKY_ERR_MEMORY;
+  }
+  for (int i = 0; i < conf->nthread; i++) {
+    if (!(pbatch[i] = batch_acquire(pbuf))) {
+      DATA_CLEAN_OMP;
       return CUTSKY_ERR_MEMORY;
     }
   }
@@ -747,86 +1591,252 @@ static int process_omp(const CONF *conf, const ZCVT *zcvt, const GEOM *geom) {
   size_t nline = (size_t) conf->nthread * CUTSKY_DATA_CHUNK;
   size_t nbox = 0;      /* number of objects in the simulation box */
 
+  /* The density of the box is needed beforehand for streaming and
+     pre-thinning, and it is computed with the object indices of byte ranges
+     for split inputs. */
+  double dens_sim = 0;
+  const bool count = (conf->ostream || conf->thin) && conf->fnz;
+  bool split = conf->isplit;
 #ifdef WITH_CFITSIO
-  if (conf->ifmt == CUTSKY_FFMT_ASCII) {        /* ASCII file */
+  if (conf->ifmt != CUTSKY_FFMT_ASCII) split = false;
 #endif
-
-    /* Open the file for reading. */
-    IFILE *ifile = input_init();
-    if (!ifile || input_newfile(ifile, conf->input)) {
+  if (count && !split) {
+    size_t ntot;
+    if (cutsky_count(conf, &ntot)) {
       DATA_CLEAN_OMP;
       return CUTSKY_ERR_FILE;
     }
+    dens_sim = ntot / pow(conf->Lbox, 3);
+    thin_setup(conf, geom, dens_sim, pbatch, conf->nthread);
+  }
 
-    /* Read the input file by chunk. */
-    for (;;) {
-      if (input_readlines(ifile, nline)) {
-        DATA_CLEAN_OMP; input_destroy(ifile);
+#ifdef WITH_CFITSIO
+  if (conf->ifmt == CUTSKY_FFMT_ASCII) {        /* ASCII file */
+#endif
+
+    if (conf->isplit) {
+      /* Split the file into byte ranges aligned to line breaks. */
+      size_t *offset = malloc((conf->nthread + 1) * sizeof(size_t));
+      ioff = calloc(conf->nthread, sizeof(size_t));
+      if (!offset || !ioff) {
+        P_ERR("failed to allocate memory for byte ranges of the input\n");
+        DATA_CLEAN_OMP; if (offset) free(offset);
+        return CUTSKY_ERR_MEMORY;
+      }
+      if (input_ranges(conf->input, conf->nthread, offset)) {
+        DATA_CLEAN_OMP; free(offset);
         return CUTSKY_ERR_FILE;
       }
-      if (!ifile->nline) break;         /* reading completed */
 
-      /* Distribute lines to OpenMP threads. */
-      const size_t pnum = ifile->nline / conf->nthread;
-      const int rem = ifile->nline % conf->nthread;
+      /* Count objects in the ranges beforehand, for indexing objects. */
+      if (count) {
+        int cerr = 0;
+#pragma omp parallel for num_threads(conf->nthread) reduction(|:cerr)
+        for (int i = 0; i < conf->nthread; i++) {
+          cerr |= input_count_records(conf->input, offset[i], offset[i + 1],
+              conf->comment, ioff + i);
+        }
+        if (cerr) {
+          DATA_CLEAN_OMP; free(offset);
+          return CUTSKY_ERR_FILE;
+        }
+
+        size_t ntot = 0;
+        for (int i = 0; i < conf->nthread; i++) {
+          const size_t cnt = ioff[i];
+          ioff[i] = ntot;
+          ntot += cnt;
+        }
+        if (conf->ndata != DEFAULT_NDATA) ntot = conf->ndata;
+        else if (conf->verbose)
+          printf("  %zu objects counted in the input catalog\n", ntot);
+        if (!ntot) {
+          P_ERR("no data in the input catalog\n");
+          DATA_CLEAN_OMP; free(offset);
+          return CUTSKY_ERR_FILE;
+        }
+        dens_sim = ntot / pow(conf->Lbox, 3);
+        thin_setup(conf, geom, dens_sim, pbatch, conf->nthread);
+      }
 
 #pragma omp parallel num_threads(conf->nthread)
       {
         const int tid = omp_get_thread_num();
-        const size_t pcnt = (tid < rem) ? pnum + 1 : pnum;
-        const size_t istart = (tid < rem) ? pcnt * tid : pnum * tid + rem;
-        const size_t iend = istart + pcnt;
-        DATA *data[2] = {pdata[0][tid], NULL};
-        if (conf->ncap == 2) data[1] = pdata[1][tid];
-
-        /* Save the starting index of the chunk in the cut-sky catalog. */
-        for (int i = 0; i < conf->ncap; i++) {
-          if (chunk_append(pchunk[i][tid], pdata[i][tid]->n)) {
-            DATA_CLEAN_OMP; input_destroy(ifile);
-            exit(CUTSKY_ERR_FILE);
-          }
+        DATA *data[CUTSKY_MAX_NCAT];
+        thread_data(conf->ncat, pdata, tid, data);
+
+        /* Read and process the range of this thread independently. */
+        IFILE *ifile = input_init();
+        if (!ifile || input_newrange(ifile, conf->input, offset[tid],
+            offset[tid + 1], conf->immap)) {
+          DATA_CLEAN_OMP; input_destroy(ifile); free(offset);
+          exit(CUTSKY_ERR_FILE);
         }
 
-        size_t pnbox = 0;
-        for (size_t i = istart; i < iend; i++) {
-          char *line = ifile->chunk + ifile->lines[i];
-          if (!line) {
-            P_ERR("failed to read line from the input catalog\n");
-            DATA_CLEAN_OMP; input_destroy(ifile);
-            exit(CUTSKY_ERR_FILE);
+        /* Objects are indexed globally if the ranges are counted. */
+        size_t pnbox = ioff[tid];
+        int ecode;
+        do {
+          if ((ecode = input_readlines(ifile, CUTSKY_DATA_CHUNK)) ||
+              (ecode = cutsky_lines(conf, zcvt, geom, pbatch[tid], ifile, 0,
+              ifile->nline, data, &pnbox)) ||
+              (conf->ostream && (ecode = cutsky_stream(conf, geom, dens_sim,
+              data, ocat)))) {
+            DATA_CLEAN_OMP; input_destroy(ifile); free(offset);
+            exit(ecode);
           }
+        }
+        while (ifile->nline);
+        input_destroy(ifile);
+        if (count) {
+#pragma omp atomic
+          nbox += pnbox - ioff[tid];
+        }
+        else ioff[tid] = pnbox;
+      } /* omp parallel */
+
+      if (count) {
+        free(ioff);
+        ioff = NULL;
+      }
+      else {
+        /* Objects are indexed locally in each range, and shifted afterwards. */
+        for (int i = 0; i < conf->nthread; i++) {
+          const size_t cnt = ioff[i];
+          ioff[i] = nbox;
+          nbox += cnt;
+        }
+      }
+      free(offset);
 
-          while (isspace(*line)) ++line;        /* omit leading whitespaces */
-          if (*line == conf->comment || *line == '\0') continue;
+      /* Ranges of the threads are in the order of the input already. */
+      if (!conf->ostream) {
+        if (seg_reserve(&seg, &segpos, &maxseg, conf->nthread, conf->ncat)) {
+          DATA_CLEAN_OMP;
+          return CUTSKY_ERR_MEMORY;
+        }
+        for (int i = 0; i < conf->nthread; i++) {
+          DATA *data[CUTSKY_MAX_NCAT];
+          thread_data(conf->ncat, pdata, i, data);
+          seg[i].tid = i;
+          for (int j = 0; j < conf->ncat; j++) seg[i].start[j] = 0;
+          seg_mark(conf->ncat, data, seg[i].end);
+        }
+        nseg = conf->nthread;
+      }
+    }
+    else {
+      /* Open the file for reading, with double buffering. */
+      IFILE *ibuf[2];
+      size_t *ibase[2];         /* indices of the first objects of sub-chunks */
+      const size_t maxsub = (nline + CUTSKY_OMP_SUBCHUNK - 1) /
+          CUTSKY_OMP_SUBCHUNK;
+      ibuf[0] = input_init();
+      ibuf[1] = input_init();
+      ibase[0] = malloc((maxsub + 1) * sizeof(size_t));
+      ibase[1] = malloc((maxsub + 1) * sizeof(size_t));
+      if (!ibase[0] || !ibase[1]) {
+        P_ERR("failed to allocate memory for indices of the input\n");
+        DATA_CLEAN_OMP; input_destroy(ibuf[0]); input_destroy(ibuf[1]);
+        if (ibase[0]) free(ibase[0]);
+        if (ibase[1]) free(ibase[1]);
+        return CUTSKY_ERR_MEMORY;
+      }
+      if (!ibuf[0] || !ibuf[1] || (conf->immap ?
+          input_newfile_mmap(ibuf[0], conf->input) :
+          input_newfile(ibuf[0], conf->input)) ||
+          input_readlines(ibuf[0], nline)) {
+        DATA_CLEAN_OMP; input_destroy(ibuf[0]); input_destroy(ibuf[1]);
+        free(ibase[0]); free(ibase[1]);
+        return CUTSKY_ERR_FILE;
+      }
+      chunk_index(conf, ibuf[0], 0, ibase[0]);
+
+      /* Read the next chunk on an extra thread while processing the current,
+         and distribute sub-chunks to the other threads dynamically. */
+      int cur;
+      for (cur = 0; ibuf[cur]->nline; cur ^= 1) {
+        IFILE *ifile = ibuf[cur];
+        IFILE *inext = ibuf[cur ^ 1];
+        const size_t nsub = (ifile->nline + CUTSKY_OMP_SUBCHUNK - 1) /
+            CUTSKY_OMP_SUBCHUNK;
+        size_t next = 0;
+        int rerr = 0;
+        bool prefetched = false;
+
+        if (seg_reserve(&seg, &segpos, &maxseg, nseg + nsub, conf->ncat)) {
+          DATA_CLEAN_OMP; input_destroy(ibuf[0]); input_destroy(ibuf[1]);
+          free(ibase[0]); free(ibase[1]);
+          return CUTSKY_ERR_MEMORY;
+        }
 
-          /* Parse the line. */
-          double x, y, z, vx, vy, vz;
-          if (sscanf(line, "%lf %lf %lf %lf %lf %lf", &x, &y, &z,
-              &vx, &vy, &vz) != 6) {
-            P_ERR("failed to read data from line: %s\n", line);
-            DATA_CLEAN_OMP; input_destroy(ifile);
-            exit(CUTSKY_ERR_FILE);
+#pragma omp parallel num_threads(conf->nthread + 1)
+        {
+          const int tid = omp_get_thread_num();
+          if (tid == conf->nthread) {     /* reader thread */
+            if (input_transfer(inext, ifile) || input_readlines(inext, nline))
+              rerr = CUTSKY_ERR_FILE;
+            else chunk_index(conf, inext, ibase[cur][nsub], ibase[cur ^ 1]);
+            prefetched = true;
           }
-          pnbox += 1;
+          else {
+            DATA *data[CUTSKY_MAX_NCAT];
+            thread_data(conf->ncat, pdata, tid, data);
+
+            /* Claim sub-chunks until all of them are processed. */
+            size_t isub, istart, iend;
+            while ((isub = next_subchunk(&next, nsub, ifile->nline, &istart,
+                &iend)) < nsub) {
+              SEG *sg = seg + nseg + isub;
+              sg->tid = tid;
+              seg_mark(conf->ncat, data, sg->start);
+              size_t pnbox = ibase[cur][isub];
+              int ecode;
+              if ((ecode = cutsky_lines(conf, zcvt, geom, pbatch[tid], ifile,
+                  istart, iend, data, &pnbox))) {
+                DATA_CLEAN_OMP; input_destroy(ibuf[0]);
+                input_destroy(ibuf[1]);
+                exit(ecode);
+              }
+              seg_mark(conf->ncat, data, sg->end);
+            }
 
-          /* Apply coordinate conversion and survey geometry. */
-          if (cutsky_infoot(zcvt, geom, x, y, z, vx, vy, vz, conf->ncap,
-                            ra_shift, is_ngc, data)) {
-            DATA_CLEAN_OMP; input_destroy(ifile);
-            exit(CUTSKY_ERR_CUTSKY);
+            if (conf->ostream) {
+              for (int i = 0; i < conf->ncat; i++) {
+                if (cutsky_select(conf, geom, i, dens_sim, 0, data[i])) {
+                  DATA_CLEAN_OMP; input_destroy(ibuf[0]);
+                  input_destroy(ibuf[1]);
+                  exit(CUTSKY_ERR_MEMORY);
+                }
+              }
+            }
           }
-          pdata[0][tid] = data[0];
-          if (conf->ncap == 2) pdata[1][tid] = data[1];
+        } /* omp parallel */
+        nseg += nsub;
+
+        /* Read the next chunk here if the extra thread is not available. */
+        if (!prefetched) {
+          if (input_transfer(inext, ifile) || input_readlines(inext, nline))
+            rerr = CUTSKY_ERR_FILE;
+          else chunk_index(conf, inext, ibase[cur][nsub], ibase[cur ^ 1]);
+        }
+        if (!rerr && conf->ostream) {
+          rerr = cutsky_stream_seg(conf, pdata, seg, nseg, ocat);
+          nseg = 0;
+        }
+        if (rerr) {
+          DATA_CLEAN_OMP; input_destroy(ibuf[0]); input_destroy(ibuf[1]);
+          free(ibase[0]); free(ibase[1]);
+          return rerr;
         }
+      }
+      nbox = ibase[cur][0];
+      free(ibase[0]); free(ibase[1]);
 
-#pragma omp critical
-        nbox += pnbox;
-      } /* omp parallel */
+      /* Close the input file. */
+      input_destroy(ibuf[0]); input_destroy(ibuf[1]);
     }
 
-    /* Close the input file. */
-    input_destroy(ifile);
-
 #ifdef WITH_CFITSIO
   }
   else {                                        /* FITS file */
@@ -846,41 +1856,61 @@ static int process_omp(const CONF *conf, const ZCVT *zcvt, const GEOM *geom) {
         return CUTSKY_ERR_FILE;
       }
       if (!ifile->ndata) break;         /* reading completed */
-      nbox += ifile->ndata;
 
-      /* Distribute lines to OpenMP threads. */
-      const size_t pnum = ifile->ndata / conf->nthread;
-      const int rem = ifile->ndata % conf->nthread;
+      const size_t nsub = (ifile->ndata + CUTSKY_OMP_SUBCHUNK - 1) /
+          CUTSKY_OMP_SUBCHUNK;
+      if (seg_reserve(&seg, &segpos, &maxseg, nseg + nsub, conf->ncat)) {
+        DATA_CLEAN_OMP; ifits_destroy(ifile);
+        return CUTSKY_ERR_MEMORY;
+      }
 
 #pragma omp parallel num_threads(conf->nthread)
       {
         const int tid = omp_get_thread_num();
-        const size_t pcnt = (tid < rem) ? pnum + 1 : pnum;
-        const size_t istart = (tid < rem) ? pcnt * tid : pnum * tid + rem;
-        const size_t iend = istart + pcnt;
-        DATA *data[2] = {pdata[0][tid], NULL};
-        if (conf->ncap == 2) data[1] = pdata[1][tid];
-
-        /* Save the starting index of the chunk in the cut-sky catalog. */
-        for (int i = 0; i < conf->ncap; i++) {
-          if (chunk_append(pchunk[i][tid], pdata[i][tid]->n)) {
+        DATA *data[CUTSKY_MAX_NCAT];
+        thread_data(conf->ncat, pdata, tid, data);
+
+        /* Distribute sub-chunks to OpenMP threads dynamically. */
+#pragma omp for schedule(dynamic, 1)
+        for (size_t isub = 0; isub < nsub; isub++) {
+          const size_t istart = isub * CUTSKY_OMP_SUBCHUNK;
+          const size_t iend = (istart + CUTSKY_OMP_SUBCHUNK < ifile->ndata) ?
+              istart + CUTSKY_OMP_SUBCHUNK : ifile->ndata;
+          SEG *sg = seg + nseg + isub;
+          sg->tid = tid;
+          seg_mark(conf->ncat, data, sg->start);
+
+          /* Apply coordinate conversion and survey geometry. */
+          double *in[6];
+          for (int k = 0; k < 6; k++) in[k] = ifile->data[k] + istart;
+          int ecode;
+          if ((ecode = cutsky_infoot(zcvt, geom, pbatch[tid], in,
+              iend - istart, nbox + istart, data))) {
             DATA_CLEAN_OMP; ifits_destroy(ifile);
-            exit(CUTSKY_ERR_FILE);
+            exit(ecode);
           }
+          seg_mark(conf->ncat, data, sg->end);
         }
 
-        /* Apply coordinate conversion and survey geometry. */
-        for (size_t i = istart; i < iend; i++) {
-          if (cutsky_infoot(zcvt, geom, ifile->data[0][i], ifile->data[1][i],
-              ifile->data[2][i], ifile->data[3][i], ifile->data[4][i],
-              ifile->data[5][i], conf->ncap, ra_shift, is_ngc, data)) {
-            DATA_CLEAN_OMP; ifits_destroy(ifile);
-            exit(CUTSKY_ERR_CUTSKY);
+        if (conf->ostream) {
+          for (int i = 0; i < conf->ncat; i++) {
+            if (cutsky_select(conf, geom, i, dens_sim, 0, data[i])) {
+              DATA_CLEAN_OMP; ifits_destroy(ifile);
+              exit(CUTSKY_ERR_MEMORY);
+            }
           }
         }
-        pdata[0][tid] = data[0];
-        if (conf->ncap == 2) pdata[1][tid] = data[1];
       } /* omp parallel */
+      nseg += nsub;
+
+      if (conf->ostream) {
+        if (cutsky_stream_seg(conf, pdata, seg, nseg, ocat)) {
+          DATA_CLEAN_OMP; ifits_destroy(ifile);
+          return CUTSKY_ERR_FILE;
+        }
+        nseg = 0;
+      }
+      nbox += ifile->ndata;
     }
 
     /* Close the input file. */
@@ -889,6 +1919,11 @@ static int process_omp(const CONF *conf, const ZCVT *zcvt, const GEOM *geom) {
   }
 #endif
 
+  /* Release the batch workspaces. */
+  for (int i = 0; i < conf->nthread; i++) batch_release(pbuf, pbatch[i]);
+  free(pbatch);
+  pbatch = NULL;
+
   if (!nbox) {
     P_ERR("no data in the input catalog\n");
     DATA_CLEAN_OMP;
@@ -908,158 +1943,553 @@ static int process_omp(const CONF *conf, const ZCVT *zcvt, const GEOM *geom) {
     nbox = conf->ndata;
   }
 
+  /* The catalogues are saved already with streaming. */
+  if (conf->ostream) {
+    for (int i = 0; i < conf->ncat; i++) {
+      if (!ocat[i])
+        P_WRN("no data after footprint trimming for %s\n",
+            cat_label(conf, i));
+      else if (conf->verbose)
+        printf("  %zu objects saved to the output for %s\n",
+            ocat[i]->n, cat_label(conf, i));
+    }
+    DATA_CLEAN_OMP;
+    return 0;
+  }
+
+  /* Compute the comoving number density. */
+  dens_sim = nbox / pow(conf->Lbox, 3);
+
 #pragma omp parallel num_threads(conf->nthread)
   {
     const int tid = omp_get_thread_num();
 
-    for (int i = 0; i < conf->ncap; i++) {
+    for (int i = 0; i < conf->ncat; i++) {
       DATA *data = pdata[i][tid];
       if (!data->n) continue;
 
-      /* Reduce memory cost if applicable. */
-      if (data->n < data->max) {
+      /* Reduce memory cost if the buffers are not reused. */
+      if (!pbuf && data->n < data->max) {
         for (int k = 0; k < 4; k++) {
           float *tmp = realloc(data->x[k], data->n * sizeof(float));
           if (tmp) data->x[k] = tmp;
         }
       }
 
-      if (conf->fnz) {          /* apply radial selection */
-        DATA_CHUNK *chunk = pchunk[i][tid];
-        if (!chunk->n) {
-          P_ERR("unexpected empty data chunk\n");
-          DATA_CLEAN_OMP;
-          exit(CUTSKY_ERR_UNKNOWN);
-        }
+      /* Apply radial selection and the footprint of interest. */
+      const size_t off = ioff ? ioff[tid] : 0;
+      if (cutsky_select(conf, geom, i, dens_sim, off, data)) {
+        DATA_CLEAN_OMP;
+        exit(CUTSKY_ERR_MEMORY);
+      }
 
-        if (chunk->n < chunk->max) {
-          size_t *tmp = realloc(chunk->start, chunk->n * sizeof(size_t));
-          if (tmp) chunk->start = tmp;
-        }
+      /* The keys of random numbers are no longer needed. */
+      if (!pbuf && data->key) {
+        free(data->key);
+        data->key = NULL;
+      }
+    }
+  }     /* omp parallel */
 
-        /* Allocate memory for the cut-sky catalog and data chunks. */
-        if (!(data->nz = malloc(data->n * sizeof(float))) ||
-            !(data->ran = malloc(data->n * sizeof(float))) ||
-            !(data->status = calloc(data->n, sizeof(uint8_t))) ||
-            !(chunk->length = malloc(chunk->n * sizeof(size_t))) ||
-            !(chunk->iglobal = malloc(chunk->n * sizeof(size_t)))) {
-          P_ERR("failed to allocate memory for the cut-sky catalog\n");
-          DATA_CLEAN_OMP;
-          exit(CUTSKY_ERR_MEMORY);
-        }
+  /* Save the catalogues in the order of the input. */
+  for (int i = 0; i < conf->ncat; i++) {
+    if (cutsky_save_seg(conf, i, pdata[i], seg, nseg, ocat + i)) {
+      DATA_CLEAN_OMP;
+      return CUTSKY_ERR_FILE;
+    }
+    if (conf->verbose)
+      printf("  %zu objects saved to the output for %s\n",
+          ocat[i]->n, cat_label(conf, i));
+  }
 
-        /* Compute the lengths of different chunks. */
-        for (int k = 1; k < chunk->n; k++)
-          chunk->length[k - 1] = chunk->start[k] - chunk->start[k - 1];
-        chunk->length[chunk->n - 1] = data->n - chunk->start[chunk->n - 1];
+  DATA_CLEAN_OMP;
+  return 0;
+}
 
-#pragma omp barrier
-        /* Compute the global starting indices of different chunks. */
-#pragma omp single
-        {
-          DATA_CHUNK **c = pchunk[i];
-          c[0]->iglobal[0] = 0;
-          for (int j = 1; j < conf->nthread; j++)
-            c[j]->iglobal[0] = c[j - 1]->iglobal[0] + c[j - 1]->length[0];
-
-          const int last = conf->nthread - 1;
-          const int nlast = c[last]->n;
-          for (int k = 1; k < nlast; k++) {
-            c[0]->iglobal[k] = c[last]->iglobal[k - 1] + c[last]->length[k - 1];
-            for (int j = 1; j < conf->nthread; j++)
-              c[j]->iglobal[k] = c[j - 1]->iglobal[k] + c[j - 1]->length[k];
-          }
+#endif          /* OMP */
 
-          if (c[0]->n > nlast) {
-            c[0]->iglobal[c[0]->n - 1] =
-                c[last]->iglobal[nlast] + c[last]->length[nlast];
-            for (int j = 1; j < conf->nthread; j++) {
-              if (c[j]->n == nlast) break;
-              c[j]->iglobal[nlast] =
-                  c[j - 1]->iglobal[nlast] + c[j - 1]->length[nlast];
-            }
-          }
-        }
-#pragma omp barrier
-
-        /* Compute the comoving number density. */
-        double dens_sim = nbox / pow(conf->Lbox, 3);
-
-        for (int k = 0; k < chunk->n; k++) {
-          /* Reset random number generator. */
-          int err = 0;
-          prand_t *rng = geom->rng;
-          rng->reset(rng->state_stream[tid], geom->seed[i], chunk->iglobal[k],
-              &err);
-          if (PRAND_IS_ERROR(err) || PRAND_IS_WARN(err)) {
-            P_ERR("failed to set the random number generator\n");
-            DATA_CLEAN_OMP;
-            exit(CUTSKY_ERR_RAND);
-          }
+#ifdef MPI
 
-          for (size_t n = chunk->start[k];
-              n < chunk->start[k] + chunk->length[k]; n++) {
-            /* Apply radial selection. */
-            data->nz[n] = geom_get_nz(geom, data->x[2][n]);
-            data->ran[n] = rng->get_double(rng->state_stream[tid]);
-            double prop = data->nz[n] / dens_sim;
-            if (data->ran[n] < prop) data->status[n] = geom->rad_sel;
-
-            /* Apply the current footprint of interest. */
-            if (conf->foot &&
-                geom_infoot(geom->foot[1], data->x[0][n], data->x[1][n]))
-              data->status[n] += geom->infoot;
-          }
-        }
-      }         /* if (conf->fnz) */
-      else if (conf->foot) {            /* add bitcodes for footprint */
-        /* Allocate memory. */
-        if (!(data->status = calloc(data->n, sizeof(uint8_t)))) {
-          P_ERR("failed to allocate memory for the cut-sky catalog\n");
-          DATA_CLEAN_OMP;
-          exit(CUTSKY_ERR_MEMORY);
-        }
+/* Shortcut for garbage collection. */
+#define DATA_CLEAN_MPI                                                  \
+  DATA_CLEAN_SERIAL;                                                    \
+  batch_release(pbuf, bat);
 
-        /* Check footprint. */
-        for (size_t n = 0; n < data->n; n++) {
-          if (geom_infoot(geom->foot[1], data->x[0][n], data->x[1][n]))
-            data->status[n] = geom->infoot;
-        }
+/******************************************************************************
+Function `mpi_sync`:
+  Synchronise error codes of all MPI ranks.
+Arguments:
+  * `ecode`:    error code of the current rank.
+Return:
+  Zero if there is no error on any rank; non-zero otherwise.
+******************************************************************************/
+static int mpi_sync(const int ecode) {
+  int err = (ecode != 0);
+  if (MPI_Allreduce(MPI_IN_PLACE, &err, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD)
+      != MPI_SUCCESS) {
+    P_ERR("failed to synchronise the MPI ranks\n");
+    return CUTSKY_ERR_MPI;
+  }
+  return err ? (ecode ? ecode : CUTSKY_ERR_MPI) : 0;
+}
+
+/******************************************************************************
+Function `mpi_prefix`:
+  Compute the number of objects on preceding MPI ranks, and the total number
+  of objects on all ranks.
+Arguments:
+  * `num`:      number of objects on the current rank;
+  * `before`:   number of objects on ranks with lower IDs;
+  * `total`:    number of objects on all ranks.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int mpi_prefix(const size_t num, size_t *before, size_t *total) {
+  unsigned long long n = num, nb = 0, nt = 0;
+  if (MPI_Exscan(&n, &nb, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM,
+      MPI_COMM_WORLD) != MPI_SUCCESS ||
+      MPI_Allreduce(&n, &nt, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM,
+      MPI_COMM_WORLD) != MPI_SUCCESS) {
+    P_ERR("failed to gather the number of objects from MPI ranks\n");
+    return CUTSKY_ERR_MPI;
+  }
+
+  /* The result of `MPI_Exscan` is undefined on the first rank. */
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  if (before) *before = rank ? nb : 0;
+  if (total) *total = nt;
+  return 0;
+}
+
+/******************************************************************************
+Function `ocat_spool`:
+  Create a rank-local temporary ASCII catalogue, for collecting the outputs
+  before writing them to the shared file.
+Arguments:
+  * `ncol`:     number of columns, see `cutsky_ncol`;
+  * `header`:   true for writing the header to the temporary file.
+Return:
+  Interface for writing the cut-sky catalogue on success; NULL on error.
+******************************************************************************/
+static OCAT *ocat_spool(const int ncol, const bool header) {
+  OCAT *ocat = calloc(1, sizeof *ocat);
+  if (!ocat) {
+    P_ERR("failed to allocate memory for catalog writing\n");
+    return NULL;
+  }
+  ocat->fmt = CUTSKY_FFMT_ASCII;
+  ocat->ncol = ncol;
+  if (!(ocat->ofile = output_init()) || output_newtmp(ocat->ofile) ||
+      (header && ocat_header(ocat))) {
+    ocat_close(ocat);
+    return NULL;
+  }
+  return ocat;
+}
+
+/******************************************************************************
+Function `ocat_merge`:
+  Write the temporary ASCII catalogues of all MPI ranks to a shared file,
+  with offsets in the order of ranks.
+Arguments:
+  * `ocat`:     the rank-local temporary catalogue;
+  * `fname`:    name of the shared output file.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int ocat_merge(OCAT *ocat, const char *fname) {
+  OFILE *ofile = ocat->ofile;
+  int ecode = output_flush(ofile);
+  long fsize = 0;
+  if (!ecode && (fsize = ftell(ofile->fp)) < 0) {
+    P_ERR("failed to get the size of the temporary file\n");
+    ecode = CUTSKY_ERR_FILE;
+  }
+  if ((ecode = mpi_sync(ecode))) return ecode;
+
+  size_t len = fsize, off;
+  if (mpi_prefix(len, &off, NULL)) return CUTSKY_ERR_MPI;
+
+  /* Create or truncate the shared file, before any rank writes to it. */
+  MPI_File fh;
+  if (MPI_File_open(MPI_COMM_WORLD, (char *) fname,
+      MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+    P_ERR("failed to open the file for writing: `%s'\n", fname);
+    return CUTSKY_ERR_FILE;
+  }
+  if (MPI_File_set_size(fh, 0) != MPI_SUCCESS) {
+    P_ERR("failed to truncate the file: `%s'\n", fname);
+    ecode = CUTSKY_ERR_FILE;
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  /* Copy the temporary file by chunks. */
+  rewind(ofile->fp);
+  while (!ecode && len) {
+    const size_t n = (len < (size_t) ofile->max) ? len : (size_t) ofile->max;
+    if (fread(ofile->chunk, n, 1, ofile->fp) != 1) {
+      P_ERR("failed to read the temporary file\n");
+      ecode = CUTSKY_ERR_FILE;
+    }
+    else if (MPI_File_write_at(fh, (MPI_Offset) off, ofile->chunk, (int) n,
+        MPI_CHAR, MPI_STATUS_IGNORE) != MPI_SUCCESS) {
+      P_ERR("failed to write to the output file: `%s'\n", fname);
+      ecode = CUTSKY_ERR_FILE;
+    }
+    off += n;
+    len -= n;
+  }
+
+  if (MPI_File_close(&fh) != MPI_SUCCESS) {
+    P_ERR("failed to close the file: `%s'\n", fname);
+    if (!ecode) ecode = CUTSKY_ERR_FILE;
+  }
+  return mpi_sync(ecode);
+}
+
+/******************************************************************************
+Function `cutsky_funnel`:
+  Save the cut-sky catalogues of all MPI ranks to a shared file, by sending
+  them to the root rank in chunks, in the order of ranks.  This is used for
+  FITS outputs, which cannot be written concurrently by multiple processes.
+Arguments:
+  * `conf`:     structure for storing configurations;
+  * `icat`:     index of the catalog;
+  * `data`:     the cut-sky catalogue of the current rank;
+  * `rank`:     ID of the current rank;
+  * `nrank`:    number of ranks.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int cutsky_funnel(const CONF *conf, const int icat, const DATA *data,
+    const int rank, const int nrank) {
+  const int ncol = cutsky_ncol(conf);
+  int ecode = 0;
+
+  if (rank) {           /* send the catalogue to the root rank */
+    unsigned long long n = data->n;
+    MPI_Send(&n, 1, MPI_UNSIGNED_LONG_LONG, 0, 0, MPI_COMM_WORLD);
+    for (size_t i = 0; i < data->n; i += CUTSKY_DATA_CHUNK) {
+      const int cnt = (data->n - i < CUTSKY_DATA_CHUNK) ?
+          data->n - i : CUTSKY_DATA_CHUNK;
+      for (int k = 0; k < 4; k++)
+        MPI_Send(data->x[k] + i, cnt, MPI_FLOAT, 0, 0, MPI_COMM_WORLD);
+      if (ncol >= 5)
+        MPI_Send(data->status + i, cnt, MPI_UINT8_T, 0, 0, MPI_COMM_WORLD);
+      if (ncol == 7) {
+        MPI_Send(data->nz + i, cnt, MPI_FLOAT, 0, 0, MPI_COMM_WORLD);
+        MPI_Send(data->ran + i, cnt, MPI_FLOAT, 0, 0, MPI_COMM_WORLD);
       }
     }
-  }     /* omp parallel */
+    return mpi_sync(0);
+  }
 
-  for (int i = 0; i < conf->ncap; i++) {
-    for (int j = 0; j < conf->nthread; j++) chunk_destroy(pchunk[i][j]);
-    free(pchunk[i]);
+  /* Buffers for receiving catalogues from the other ranks. */
+  DATA *buf = cutsky_init(false);
+  if (!buf || !(buf->status = malloc(buf->max * sizeof(uint8_t))) ||
+      !(buf->nz = malloc(buf->max * sizeof(float))) ||
+      !(buf->ran = malloc(buf->max * sizeof(float)))) {
+    P_ERR("failed to allocate memory for receiving the catalogs\n");
+    MPI_Abort(MPI_COMM_WORLD, CUTSKY_ERR_MEMORY);
   }
 
-  /* Save the catalogues. */
-  for (int i = 0; i < conf->ncap; i++) {
-    if (cutsky_save(conf->output[i], conf->ofmt, pdata[i], conf->nthread)) {
-      for (int ii = i; ii < conf->ncap; ii++) {
-        for (int jj = 0; jj < conf->nthread; jj++)
-          cutsky_destroy(pdata[ii][jj]);
-        free(pdata[ii]);
+  OCAT *ocat = NULL;
+  if (!ecode && !(ocat = ocat_open(conf->output[icat], conf->ofmt, ncol)))
+    ecode = CUTSKY_ERR_FILE;
+  if (!ecode && ocat_write(ocat, data, 0, data->n)) ecode = CUTSKY_ERR_FILE;
+
+  /* Receive all the messages even on error, to avoid blocking the senders. */
+  for (int r = 1; r < nrank; r++) {
+    unsigned long long n;
+    MPI_Recv(&n, 1, MPI_UNSIGNED_LONG_LONG, r, 0, MPI_COMM_WORLD,
+        MPI_STATUS_IGNORE);
+    for (size_t i = 0; i < n; i += CUTSKY_DATA_CHUNK) {
+      const int cnt = (n - i < CUTSKY_DATA_CHUNK) ? n - i : CUTSKY_DATA_CHUNK;
+      DATA tmp = *buf;
+      for (int k = 0; k < 4; k++)
+        MPI_Recv(tmp.x[k], cnt, MPI_FLOAT, r, 0, MPI_COMM_WORLD,
+            MPI_STATUS_IGNORE);
+      if (ncol >= 5)
+        MPI_Recv(tmp.status, cnt, MPI_UINT8_T, r, 0, MPI_COMM_WORLD,
+            MPI_STATUS_IGNORE);
+      if (ncol == 7) {
+        MPI_Recv(tmp.nz, cnt, MPI_FLOAT, r, 0, MPI_COMM_WORLD,
+            MPI_STATUS_IGNORE);
+        MPI_Recv(tmp.ran, cnt, MPI_FLOAT, r, 0, MPI_COMM_WORLD,
+            MPI_STATUS_IGNORE);
+      }
+      if (!ecode && ocat_write(ocat, &tmp, 0, cnt)) ecode = CUTSKY_ERR_FILE;
+    }
+  }
+
+  cutsky_destroy(buf);
+  ocat_close(ocat);
+  return mpi_sync(ecode);
+}
+
+/******************************************************************************
+Function `process_mpi`:
+  Process the input data catalogue with MPI parallelisation.  Each rank reads
+  a byte range of the ASCII-format input, or a subset of the FITS files, and
+  objects are indexed in the order of the entire input, so the results are
+  identical to the serial ones.
+Arguments:
+  * `conf`:     structure for storing configurations;
+  * `zcvt`:     interface for redshift conversion;
+  * `geom`:     interface for survey geometry;
+  * `rank`:     ID of the current rank;
+  * `nrank`:    number of ranks.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int process_mpi(const CONF *conf, const ZCVT *zcvt, const GEOM *geom,
+    PBUF *pbuf, const int rank, const int nrank) {
+  /* Process sky regions of each tracer individually. */
+  DATA *data[CUTSKY_MAX_NCAT] = {NULL};
+  OCAT *ocat[CUTSKY_MAX_NCAT] = {NULL}; /* rank-local ASCII outputs */
+  BATCH *bat = NULL;
+  int ecode = 0;
+
+  for (int i = 0; i < conf->ncat; i++) {
+    if (!(data[i] = cutsky_acquire(pbuf, conf->fnz != NULL)))
+      ecode = CUTSKY_ERR_MEMORY;
+  }
+  if (!ecode && !(bat = batch_acquire(pbuf))) ecode = CUTSKY_ERR_MEMORY;
+  if ((ecode = mpi_sync(ecode))) {
+    DATA_CLEAN_MPI;
+    return ecode;
+  }
+
+  /* FITS outputs are collected by the root rank, and cannot be streamed. */
+  bool ascii = true;
+#ifdef WITH_CFITSIO
+  ascii = (conf->ofmt == CUTSKY_FFMT_ASCII);
+  if (!ascii && conf->ostream && !rank)
+    P_WRN("streaming is disabled for FITS outputs with MPI\n");
+#endif
+  const bool stream = conf->ostream && ascii;
+
+  /* Distribute the input catalog to ranks. */
+  size_t range[2] = {0, 0};     /* byte range of the ASCII-format input */
+#ifdef WITH_CFITSIO
+  int ifile0 = 0, nfile = 0;    /* subset of the FITS-format inputs */
+#endif
+  size_t nloc = 0;              /* number of objects on this rank */
+  const bool count = (conf->ostream || conf->thin) && conf->fnz;
+
+#ifdef WITH_CFITSIO
+  if (conf->ifmt == CUTSKY_FFMT_ASCII) {        /* ASCII file */
+#endif
+    /* Split the file into byte ranges aligned to line breaks. */
+    unsigned long long *bounds = NULL;
+    if (!rank) {
+      size_t *offset = malloc((nrank + 1) * sizeof(size_t));
+      if (!(bounds = malloc(2 * nrank * sizeof(unsigned long long))) ||
+          !offset) {
+        P_ERR("failed to allocate memory for byte ranges of the input\n");
+        ecode = CUTSKY_ERR_MEMORY;
+      }
+      else if (input_ranges(conf->input, nrank, offset))
+        ecode = CUTSKY_ERR_FILE;
+      else {
+        for (int i = 0; i < nrank; i++) {
+          bounds[2 * i] = offset[i];
+          bounds[2 * i + 1] = offset[i + 1];
+        }
       }
+      if (offset) free(offset);
+    }
+    MPI_Bcast(&ecode, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (ecode) {
+      if (bounds) free(bounds);
+      DATA_CLEAN_MPI;
+      return ecode;
+    }
+    unsigned long long lim[2];
+    MPI_Scatter(bounds, 2, MPI_UNSIGNED_LONG_LONG, lim, 2,
+        MPI_UNSIGNED_LONG_LONG, 0, MPI_COMM_WORLD);
+    if (bounds) free(bounds);
+    range[0] = lim[0];
+    range[1] = lim[1];
+
+    /* Count objects in the range beforehand, for indexing objects. */
+    if (count && input_count_records(conf->input, range[0], range[1],
+        conf->comment, &nloc)) ecode = CUTSKY_ERR_FILE;
+#ifdef WITH_CFITSIO
+  }
+  else {                                        /* FITS file(s) */
+    /* Distribute contiguous subsets of the files to ranks. */
+    ifile0 = (long) conf->ninput * rank / nrank;
+    nfile = (long) conf->ninput * (rank + 1) / nrank - ifile0;
+    if (count && nfile && ifits_count_rows((const char **) conf->inputs +
+        ifile0, nfile, &nloc)) ecode = CUTSKY_ERR_FILE;
+  }
+#endif
+  if ((ecode = mpi_sync(ecode))) {
+    DATA_CLEAN_MPI;
+    return ecode;
+  }
+
+  /* Objects are indexed globally if the numbers are known beforehand. */
+  size_t ioff = 0, nbox = 0;
+  double dens_sim = 0;
+  if (count) {
+    if (mpi_prefix(nloc, &ioff, &nbox)) {
+      DATA_CLEAN_MPI;
+      return CUTSKY_ERR_MPI;
+    }
+    if (conf->ndata != DEFAULT_NDATA) nbox = conf->ndata;
+    else if (conf->verbose)
+      printf("  %zu objects counted in the input catalog\n", nbox);
+    if (!nbox) {
+      if (!rank) P_ERR("no data in the input catalog\n");
+      DATA_CLEAN_MPI;
       return CUTSKY_ERR_FILE;
     }
+    dens_sim = nbox / pow(conf->Lbox, 3);
+    thin_setup(conf, geom, dens_sim, &bat, 1);
+  }
+
+  /* Rank-local outputs for streaming. */
+  if (stream) {
+    for (int i = 0; i < conf->ncat; i++) {
+      if (!(ocat[i] = ocat_spool(cutsky_ncol(conf), !rank)))
+        ecode = CUTSKY_ERR_FILE;
+    }
+    if ((ecode = mpi_sync(ecode))) {
+      DATA_CLEAN_MPI;
+      return ecode;
+    }
+  }
+
+  /* Read and process the subset of this rank independently. */
+  size_t pnbox = ioff;
+#ifdef WITH_CFITSIO
+  if (conf->ifmt == CUTSKY_FFMT_ASCII) {        /* ASCII file */
+#endif
+    IFILE *ifile = input_init();
+    if (!ifile || input_newrange(ifile, conf->input, range[0], range[1],
+        conf->immap)) ecode = CUTSKY_ERR_FILE;
+    else {
+      do {
+        if ((ecode = input_readlines(ifile, CUTSKY_DATA_CHUNK)) ||
+            (ecode = cutsky_lines(conf, zcvt, geom, bat, ifile, 0,
+            ifile->nline, data, &pnbox)) ||
+            (stream && (ecode = cutsky_stream(conf, geom, dens_sim, data,
+            ocat)))) break;
+      }
+      while (ifile->nline);
+    }
+    input_destroy(ifile);
+#ifdef WITH_CFITSIO
+  }
+  else if (nfile) {                             /* FITS file(s) */
+    IFFILE *ifile = ifits_init();
+    if (!ifile || ifits_newfiles(ifile, (const char **) conf->inputs +
+        ifile0, nfile)) ecode = CUTSKY_ERR_FILE;
+    else {
+      for (;;) {
+        if ((ecode = ifits_readlines(ifile, CUTSKY_DATA_CHUNK)) ||
+            !ifile->ndata) break;
+        if ((ecode = cutsky_infoot(zcvt, geom, bat, ifile->data,
+            ifile->ndata, pnbox, data)) ||
+            (stream && (ecode = cutsky_stream(conf, geom, dens_sim, data,
+            ocat)))) break;
+        pnbox += ifile->ndata;
+      }
+    }
+    ifits_destroy(ifile);
+  }
+#endif
+  if ((ecode = mpi_sync(ecode))) {
+    DATA_CLEAN_MPI;
+    return ecode;
+  }
+  batch_release(pbuf, bat);
+  bat = NULL;
+
+  /* Objects are indexed locally otherwise, and shifted afterwards. */
+  nloc = pnbox - ioff;
+  size_t nbefore;
+  if (mpi_prefix(nloc, &nbefore, &nbox)) {
+    DATA_CLEAN_MPI;
+    return CUTSKY_ERR_MPI;
+  }
+  if (!count) ioff = nbefore;
+
+  if (!nbox) {
+    if (!rank) P_ERR("no data in the input catalog\n");
+    DATA_CLEAN_MPI;
+    return CUTSKY_ERR_FILE;
+  }
+  if (conf->fnz && conf->ndata != DEFAULT_NDATA) {
+    if (!rank && fabs((double) conf->ndata - nbox) >
+        (double) nbox * CUTSKY_NDATA_MISMATCH) {
+      P_WRN("mismatched number of objects: %ld from the configuration, "
+          "while %zu in the catalog\n"
+          "Using the number in the configuration anyway\n",
+          conf->ndata, nbox);
+    }
+    nbox = conf->ndata;
+  }
+  if (conf->verbose)
+    printf("  %zu objects read from the input catalog\n", nbox);
+
+  if (!stream) {
+    /* Compute the comoving number density. */
+    if (!count) dens_sim = nbox / pow(conf->Lbox, 3);
+
+    for (int i = 0; i < conf->ncat; i++) {
+      /* Apply radial selection and the footprint of interest. */
+      const size_t off = count ? 0 : ioff;
+      if (cutsky_select(conf, geom, i, dens_sim, off, data[i]))
+        ecode = CUTSKY_ERR_MEMORY;
+
+      /* The keys of random numbers are no longer needed. */
+      if (!pbuf && data[i]->key) {
+        free(data[i]->key);
+        data[i]->key = NULL;
+      }
+
+      /* Format the ASCII-format outputs on all ranks. */
+      if (!ecode && ascii && (!(ocat[i] = ocat_spool(cutsky_ncol(conf),
+          !rank)) || ocat_write(ocat[i], data[i], 0, data[i]->n)))
+        ecode = CUTSKY_ERR_FILE;
+    }
+    if ((ecode = mpi_sync(ecode))) {
+      DATA_CLEAN_MPI;
+      return ecode;
+    }
+  }
 
-    if (conf->verbose) {
-      size_t ndata = 0;
-      for (int j = 0; j < conf->nthread; j++) ndata += pdata[i][j]->n;
-      printf("  %zu objects saved to the output for %cGC\n",
-          ndata, conf->gcap[i]);
+  /* Save the catalogues to the shared files. */
+  for (int i = 0; i < conf->ncat; i++) {
+    size_t ndata;
+    if (mpi_prefix(ascii ? ocat[i]->n : data[i]->n, NULL, &ndata)) {
+      DATA_CLEAN_MPI;
+      return CUTSKY_ERR_MPI;
+    }
+    if (!ndata) {
+      if (!rank)
+        P_WRN("no data after footprint trimming for %s\n", cat_label(conf, i));
+      continue;
     }
 
-    for (int j = 0; j < conf->nthread; j++) cutsky_destroy(pdata[i][j]);
-    free(pdata[i]);
+    if ((ecode = ascii ? ocat_merge(ocat[i], conf->output[i]) :
+        cutsky_funnel(conf, i, data[i], rank, nrank))) {
+      DATA_CLEAN_MPI;
+      return ecode;
+    }
+    if (conf->verbose) printf("  %zu objects saved to the output for %s\n",
+        ndata, cat_label(conf, i));
   }
 
+  DATA_CLEAN_MPI;
   return 0;
 }
 
-#endif          /* OMP */
+#endif          /* MPI */
 
 /*============================================================================*\
                      Interface for the main cutsky process
@@ -1071,11 +2501,12 @@ Function `process`:
 Arguments:
   * `conf`:     structure for storing configurations;
   * `zcvt`:     interface for redshift conversion;
-  * `geom`:     interface for survey geometry.
+  * `geom`:     interface for survey geometry;
+  * `pbuf`:     buffers reused between catalogs, NULL for disabling reuse.
 Return:
   Zero on success; non-zero on error.
 ******************************************************************************/
-int process(const CONF *conf, const ZCVT *zcvt, const GEOM *geom) {
+int process(const CONF *conf, const ZCVT *zcvt, const GEOM *geom, PBUF *pbuf) {
   printf("Running the cutsky process ...");
   if (!conf) {
     P_ERR("configurations are not loaded\n");
@@ -1089,16 +2520,33 @@ int process(const CONF *conf, const ZCVT *zcvt, const GEOM *geom) {
     P_ERR("survey geometry is not initialized\n");
     return CUTSKY_ERR_ARG;
   }
+  if (conf->fnz && zcvt->ndup > CRAND_MAX_NDUP) {
+    P_ERR("too many box replicas for generating random numbers\n");
+    return CUTSKY_ERR_ARG;
+  }
   if (conf->verbose) printf("\n");
   fflush(stdout);
 
+#ifdef MPI
+  /* Ranks process their subsets of the input serially. */
+  int rank, nrank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &nrank);
+  if (nrank > 1) {
+    if (process_mpi(conf, zcvt, geom, pbuf, rank, nrank))
+      return CUTSKY_ERR_CUTSKY;
+    printf(FMT_DONE);
+    return 0;
+  }
+#endif
+
 #ifdef OMP
   if (conf->nthread > 1) {
-    if (process_omp(conf, zcvt, geom)) return CUTSKY_ERR_CUTSKY;
+    if (process_omp(conf, zcvt, geom, pbuf)) return CUTSKY_ERR_CUTSKY;
   }
   else {
 #endif
-    if (process_serial(conf, zcvt, geom)) return CUTSKY_ERR_CUTSKY;
+    if (process_serial(conf, zcvt, geom, pbuf)) return CUTSKY_ERR_CUTSKY;
 #ifdef OMP
   }
 #endif
@@ -1106,3 +2554,52 @@ int process(const CONF *conf, const ZCVT *zcvt, const GEOM *geom) {
   printf(FMT_DONE);
   return 0;
 }
+
+/******************************************************************************
+Function `pbuf_init`:
+  Initialise the pool of buffers to be reused for processing multiple
+  catalogs with the same configurations.
+Arguments:
+  * `conf`:     structure for storing configurations.
+Return:
+  Instance of the pool on success; NULL on error.
+******************************************************************************/
+PBUF *pbuf_init(const CONF *conf) {
+  if (!conf) {
+    P_ERR("configurations are not loaded\n");
+    return NULL;
+  }
+  PBUF *pbuf = calloc(1, sizeof *pbuf);
+  if (!pbuf) {
+    P_ERR("failed to allocate memory for the reusable buffers\n");
+    return NULL;
+  }
+  /* Catalogs of all tracers and caps, and workspaces for all threads. */
+#ifdef OMP
+  pbuf->max = conf->ncat * conf->nthread;
+#else
+  pbuf->max = conf->ncat;
+#endif
+  if (!(pbuf->data = malloc(pbuf->max * sizeof(DATA *))) ||
+      !(pbuf->bat = malloc(pbuf->max * sizeof(BATCH *)))) {
+    P_ERR("failed to allocate memory for the reusable buffers\n");
+    pbuf_destroy(pbuf);
+    return NULL;
+  }
+  return pbuf;
+}
+
+/******************************************************************************
+Function `pbuf_destroy`:
+  Deconstruct the pool of reusable buffers.
+Arguments:
+  * `pbuf`:     the pool of reusable buffers.
+******************************************************************************/
+void pbuf_destroy(PBUF *pbuf) {
+  if (!pbuf) return;
+  for (int i = 0; i < pbuf->ndata; i++) cutsky_destroy(pbuf->data[i]);
+  for (int i = 0; i < pbuf->nbat; i++) batch_destroy(pbuf->bat[i]);
+  if (pbuf->data) free(pbuf->data);
+  if (pbuf->bat) free(pbuf->bat);
+  free(pbuf);
+}
@@ -47,9 +47,13 @@ typedef struct {
   float *x[4];          /* coordinates: RA, DEC, Z_RSD, Z_REAL        */
   float *nz;            /* comoving number density                    */
   float *ran;           /* random number for radial selection         */
+  uint64_t *key;        /* key of the random number                   */
   uint8_t *status;      /* bitcode for footprint and radial selection */
 } DATA;
 
+/* Buffers that are reused for processing multiple catalogs. */
+typedef struct cutsky_pbuf PBUF;
+
 /*============================================================================*\
                      Interface for the main cutsky process
 \*============================================================================*/
@@ -60,10 +64,30 @@ Function `process`:
 Arguments:
   * `conf`:     structure for storing configurations;
   * `zcvt`:     interface for redshift conversion;
-  * `geom`:     interface for survey geometry.
+  * `geom`:     interface for survey geometry;
+  * `pbuf`:     buffers reused between catalogs, NULL for disabling reuse.
 Return:
   Zero on success; non-zero on error.
 ******************************************************************************/
-int process(const CONF *conf, const ZCVT *zcvt, const GEOM *geom);
+int process(const CONF *conf, const ZCVT *zcvt, const GEOM *geom, PBUF *pbuf);
+
+/******************************************************************************
+Function `pbuf_init`:
+  Initialise the pool of buffers to be reused for processing multiple
+  catalogs with the same configurations.
+Arguments:
+  * `conf`:     structure for storing configurations.
+Return:
+  Instance of the pool on success; NULL on error.
+******************************************************************************/
+PBUF *pbuf_init(const CONF *conf);
+
+/******************************************************************************
+Function `pbuf_destroy`:
+  Deconstruct the pool of reusable buffers.
+Arguments:
+  * `pbuf`:     the pool of reusable buffers.
+******************************************************************************/
+void pbuf_destroy(PBUF *pbuf);
 
 #endif
@@ -64,49 +64,52 @@ int read_ascii_twocol(const char *fname, double **x, double **y, size_t *num) {
   }
 
   size_t n = 0;
-  for (;;) {
-    if (input_readline(ifile)) {
+  do {
+    /* Read lines in batch, with line breaks located at once. */
+    if (input_readlines(ifile, CUTSKY_DATA_CHUNK)) {
       input_destroy(ifile); free(nx); free(ny);
       return CUTSKY_ERR_FILE;
     }
 
-    const char *p = ifile->line;
-    if (!p) break;
-
-    while (isspace(*p)) ++p;    /* omit leading whitespaces */
-    if (*p == CUTSKY_READ_COMMENT || *p == '\0') continue;
-
-    /* Parse the line. */
-    if (sscanf(p, "%lf %lf", nx + n, ny + n) != 2) {
-      P_ERR("failed to parse line: %s\n", p);
-      input_destroy(ifile); free(nx); free(ny);
-      return CUTSKY_ERR_FILE;
-    }
+    for (size_t i = 0; i < ifile->nline; i++) {
+      const char *p = ifile->chunk + ifile->lines[i];
+      while (isspace(*p)) ++p;  /* omit leading whitespaces */
+      if (*p == CUTSKY_READ_COMMENT || *p == '\0') continue;
 
-    /* Enlarge memory for the data if necessary. */
-    if (++n >= nmax) {
-      if (SIZE_MAX / 2 < nmax) {
-        P_ERR("too many records in file: `%s'\n", fname);
+      /* Parse the line. */
+      double *const col[2] = {nx, ny};
+      if (parse_dbl_fields(p, 2, col, n) != 2) {
+        P_ERR("failed to parse line: %s\n", p);
         input_destroy(ifile); free(nx); free(ny);
         return CUTSKY_ERR_FILE;
       }
 
-      nmax <<= 1;
-      double *tmp = realloc(nx, nmax * sizeof(double));
-      if (!tmp) {
-        P_ERR("failed to allocate memory for the input data\n");
-        input_destroy(ifile); free(nx); free(ny);
-        return CUTSKY_ERR_MEMORY;
-      }
-      nx = tmp;
-      if (!(tmp = realloc(ny, nmax * sizeof(double)))) {
-        P_ERR("failed to allocate memory for the input data\n");
-        input_destroy(ifile); free(nx); free(ny);
-        return CUTSKY_ERR_MEMORY;
+      /* Enlarge memory for the data if necessary. */
+      if (++n >= nmax) {
+        if (SIZE_MAX / 2 < nmax) {
+          P_ERR("too many records in file: `%s'\n", fname);
+          input_destroy(ifile); free(nx); free(ny);
+          return CUTSKY_ERR_FILE;
+        }
+
+        nmax <<= 1;
+        double *tmp = realloc(nx, nmax * sizeof(double));
+        if (!tmp) {
+          P_ERR("failed to allocate memory for the input data\n");
+          input_destroy(ifile); free(nx); free(ny);
+          return CUTSKY_ERR_MEMORY;
+        }
+        nx = tmp;
+        if (!(tmp = realloc(ny, nmax * sizeof(double)))) {
+          P_ERR("failed to allocate memory for the input data\n");
+          input_destroy(ifile); free(nx); free(ny);
+          return CUTSKY_ERR_MEMORY;
+        }
+        ny = tmp;
       }
-      ny = tmp;
     }
   }
+  while (ifile->nline == CUTSKY_DATA_CHUNK);
 
   input_destroy(ifile);
 
@@ -131,21 +134,24 @@ int read_ascii_twocol(const char *fname, double **x, double **y, size_t *num) {
 }
 
 /******************************************************************************
-Function `read_filelist`:
-  Read filenames from a list.
+Function `read_fieldlist`:
+  Read whitespace-separated string fields from a list, with spaces inside
+  fields escaped by `CUTSKY_SPACE_ESCAPE`.
 Arguments:
   * `fname`:    filename of the input list;
-  * `list`:     list of filenames read from file;
+  * `nfield`:   number of fields to be read from each line;
+  * `list`:     fields read from file, with `nfield` elements per line;
   * `num`:      number of lines read successfully.
 Return:
   Zero on success; non-zero on error.
 ******************************************************************************/
-int read_filelist(const char *fname, char ***list, int *num) {
+int read_fieldlist(const char *fname, const int nfield, char ***list,
+    int *num) {
   if (!fname || !(*fname)) {
     P_ERR("invalid name of input file\n");
     return CUTSKY_ERR_ARG;
   }
-  if (!list || !num) {
+  if (nfield <= 0 || !list || !num) {
     P_ERR("variables for storing the input data are not initialized\n");
     return CUTSKY_ERR_ARG;
   }
@@ -157,12 +163,11 @@ int read_filelist(const char *fname, char ***list, int *num) {
     return CUTSKY_ERR_FILE;
   }
 
-  /* Allocate memory for the filenames. */
+  /* Allocate memory for the fields. */
   size_t nmax = CUTSKY_DATA_INIT_NUM;
-  size_t imax = CUTSKY_DATA_INIT_NUM;
-  char *names = NULL;           /* a single array for all filenames */
-  size_t *idx = NULL;           /* indices of filenames in the array */
-
+  size_t imax = CUTSKY_DATA_INIT_NUM * nfield;
+  char *names = NULL;           /* a single array for all fields */
+  size_t *idx = NULL;           /* indices of fields in the array */
   if (!(names = malloc(nmax * sizeof(char))) ||
       !(idx = malloc(imax * sizeof(size_t)))) {
     P_ERR("failed to allocate memory for filenames\n");
@@ -178,7 +183,6 @@ int read_filelist(const char *fname, char ***list, int *num) {
       input_destroy(ifile); free(names); free(idx);
       return CUTSKY_ERR_FILE;
     }
-
     const char *p = ifile->line;
     if (!p) break;
 
@@ -186,36 +190,44 @@ int read_filelist(const char *fname, char ***list, int *num) {
     if (*p == CUTSKY_READ_COMMENT || *p == '\0') continue;
 
     /* Parse the line. */
-    idx[n] = size;
-    do {
-      if (isspace (*p)) {
-        /* Overwrite the escape character if applicable. */
-        if (*(p - 1) == CUTSKY_SPACE_ESCAPE) size--;
-        else break;
+    for (int k = 0; k < nfield; k++) {
+      while (isspace(*p)) ++p;
+      if (*p == '\0') {
+        P_ERR("too few fields in line %d of file: `%s'\n", n + 1, fname);
+        input_destroy(ifile); free(names); free(idx);
+        return CUTSKY_ERR_FILE;
       }
-      names[size] = *p;
-      /* Enlarge memory for the filenames if necessary. */
-      if (++size >= nmax - 1) {         /* reserve one byte for '\0' */
-        if (SIZE_MAX / 2 < nmax) {
-          P_ERR("too many characters in file: `%s'\n", fname);
-          input_destroy(ifile); free(names); free(idx);
-          return CUTSKY_ERR_MEMORY;
+      idx[(size_t) n * nfield + k] = size;
+      do {
+        if (isspace (*p)) {
+          /* Overwrite the escape character if applicable. */
+          if (*(p - 1) == CUTSKY_SPACE_ESCAPE) size--;
+          else break;
         }
-        nmax <<= 1;
-        char *tmp = realloc(names, nmax * sizeof(char));
-        if (!tmp) {
-          P_ERR("failed to allocate memory for filenames\n");
-          input_destroy(ifile); free(names); free(idx);
-          return CUTSKY_ERR_MEMORY;
+        names[size] = *p;
+        /* Enlarge memory for the fields if necessary. */
+        if (++size >= nmax - 1) {       /* reserve one byte for '\0' */
+          if (SIZE_MAX / 2 < nmax) {
+            P_ERR("too many characters in file: `%s'\n", fname);
+            input_destroy(ifile); free(names); free(idx);
+            return CUTSKY_ERR_MEMORY;
+          }
+          nmax <<= 1;
+          char *tmp = realloc(names, nmax * sizeof(char));
+          if (!tmp) {
+            P_ERR("failed to allocate memory for filenames\n");
+            input_destroy(ifile); free(names); free(idx);
+            return CUTSKY_ERR_MEMORY;
+          }
+          names = tmp;
         }
-        names = tmp;
       }
+      while (*(++p) != '\0');
+      names[size++] = '\0';             /* null termination */
     }
-    while (*(++p) != '\0');
-    names[size++] = '\0';               /* null termination */
 
     /* Enlarge memory for the indices if necessary. */
-    if (++n >= imax) {
+    if ((size_t) ++n * nfield >= imax) {
       if (INT_MAX / 2 < imax) {
         P_ERR("too many entries in file: `%s'\n", fname);
         input_destroy(ifile); free(names); free(idx);
@@ -235,7 +247,7 @@ int read_filelist(const char *fname, char ***list, int *num) {
   input_destroy(ifile);
 
   if (!n || !size) {
-    P_ERR("no valid filename found in file: `%s'\n", fname);
+    P_ERR("no valid entry found in file: `%s'\n", fname);
     free(names); free(idx);
     return CUTSKY_ERR_FILE;
   }
@@ -246,16 +258,31 @@ int read_filelist(const char *fname, char ***list, int *num) {
     if (tmp) names = tmp;
   }
 
-  /* Allocate memory for the filename array. */
-  if (!(*list = malloc(n * sizeof(char *)))) {
+  /* Allocate memory for the field array. */
+  const size_t ntot = (size_t) n * nfield;
+  if (!(*list = malloc(ntot * sizeof(char *)))) {
     P_ERR("failed to allocate memory for filenames\n");
     free(names); free(idx);
     return CUTSKY_ERR_MEMORY;
   }
   **list = names;
-  for (int i = 1; i < n; i++) (*list)[i] = names + idx[i];
+  for (size_t i = 1; i < ntot; i++) (*list)[i] = names + idx[i];
   *num = n;
 
   free(idx);
   return 0;
 }
+
+/******************************************************************************
+Function `read_filelist`:
+  Read filenames from a list.
+Arguments:
+  * `fname`:    filename of the input list;
+  * `list`:     list of filenames read from file;
+  * `num`:      number of lines read successfully.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+int read_filelist(const char *fname, char ***list, int *num) {
+  return read_fieldlist(fname, 1, list, num);
+}
@@ -51,6 +51,21 @@ Return:
 int read_ascii_twocol(const char *fname, double **x, double **y, size_t *num);
 
 
+/******************************************************************************
+Function `read_fieldlist`:
+  Read whitespace-separated string fields from a list, with spaces inside
+  fields escaped by `CUTSKY_SPACE_ESCAPE`.
+Arguments:
+  * `fname`:    filename of the input list;
+  * `nfield`:   number of fields to be read from each line;
+  * `list`:     fields read from file, with `nfield` elements per line;
+  * `num`:      number of lines read successfully.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+int read_fieldlist(const char *fname, const int nfield, char ***list,
+    int *num);
+
 #ifdef WITH_CFITSIO
 
 /******************************************************************************
@@ -10,14 +10,23 @@
 
 *******************************************************************************/
 
+/* For `realpath`. */
+#define _XOPEN_SOURCE 700
+
 #include "define.h"
 #include "survey_geom.h"
 #include "read_data.h"
 #include "cspline.h"
+#include "crand.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
 #include <math.h>
+#include <string.h>
+#include <stdint.h>
+
+/* Maximum of |t^3 - t| / 6 for t in [0,1], i.e., 1 / (9 sqrt(3)). */
+#define SPLINE_CUBIC_BOUND      0.06415003
 
 /*============================================================================*\
                      Functions for applying survey geometry
@@ -27,17 +36,17 @@
 Function `load_nz`:
   Load n(z) from file and prepare for the interpolation.
 Arguments:
-  * `geom`:     interface for survey geometry;
+  * `trc`:      selection of the tracer;
   * `fname`:    name of the file storing n(z);
   * `zmin`:     minimum redshift of interest;
   * `zmax`:     maximum redshift of interest.
 Return:
   Zero on success; non-zero on error.
 ******************************************************************************/
-static inline int load_nz(GEOM *geom, const char *fname, const double zmin,
+static inline int load_nz(TRACER *trc, const char *fname, const double zmin,
     const double zmax) {
   size_t num = 0;
-  if (read_ascii_twocol(fname, &geom->z, &geom->nz, &num)) {
+  if (read_ascii_twocol(fname, &trc->z, &trc->nz, &num)) {
     P_ERR("failed to read the n(z) file: `%s'\n", fname);
     return CUTSKY_ERR_FILE;
   }
@@ -49,29 +58,308 @@ static inline int load_nz(GEOM *geom, const char *fname, const double zmin,
 
   /* Validate the redshifts in file. */
   for (size_t i = 1; i < num; i++) {
-    if (geom->z[i] <= geom->z[i - 1]) {
+    if (trc->z[i] <= trc->z[i - 1]) {
       P_ERR("redshifts must be in ascending order in file: `%s'\n", fname);
       return CUTSKY_ERR_FILE;
     }
   }
-  if (geom->z[0] > zmin || geom->z[num - 1] < zmax) {
+  if (trc->z[0] > zmin || trc->z[num - 1] < zmax) {
     P_ERR("redshifts in file must cover the range (" OFMT_DBL ", " OFMT_DBL
         "): `%s'\n", zmin, zmax, fname);
     return CUTSKY_ERR_FILE;
   }
 
   /* Compute the second derivative of n(z) for interpolation. */
-  if (!(geom->nzpp = malloc(num * 2 * sizeof(double)))) {
+  if (!(trc->nzpp = malloc(num * 2 * sizeof(double)))) {
     P_ERR("failed to allocate memory for n(z) interpolation\n");
     return CUTSKY_ERR_MEMORY;
   }
 
-  cspline_ypp(geom->z, geom->nz, num, geom->nzpp);
-  geom->nsp = num;
+  cspline_ypp(trc->z, trc->nz, num, trc->nzpp);
+  trc->nsp = num;
+
+  return 0;
+}
+
+/******************************************************************************
+Function `path_hash`:
+  Compute the 64-bit FNV-1a hash of the canonical form of a file path.
+Arguments:
+  * `fname`:    the file path.
+Return:
+  The hash value.
+******************************************************************************/
+static uint64_t path_hash(const char *fname) {
+  /* Hash the path as is if it cannot be resolved. */
+  char *path = realpath(fname, NULL);
+  const char *str = path ? path : fname;
+
+  uint64_t hash = UINT64_C(0xcbf29ce484222325);
+  for (const unsigned char *c = (const unsigned char *) str; *c; c++) {
+    hash ^= *c;
+    hash *= UINT64_C(0x100000001b3);
+  }
+
+  free(path);
+  return hash;
+}
+
+/******************************************************************************
+Function `mask_cache_name`:
+  Construct the filename of the binary cache for a polygon file.
+  If the cache directory is set, the hash of the full path of the polygon
+  file is added to the name, to distinguish files with the same basename.
+Arguments:
+  * `conf`:     structure for storing configurations;
+  * `fname`:    filename of the polygon file.
+Return:
+  The filename of the cache on success; NULL on error.
+******************************************************************************/
+static char *mask_cache_name(const CONF *conf, const char *fname) {
+  const char *base = fname;
+  size_t dlen = 0;
+  size_t hlen = 0;
+  if (conf->mcdir) {
+    const char *end = strrchr(fname, CUTSKY_PATH_SEP);
+    if (end) base = end + 1;
+    dlen = strlen(conf->mcdir) + 1;
+    hlen = 17;          /* '.' and 16 hexadecimal digits of the hash */
+  }
+  const size_t blen = strlen(base);
+  const size_t elen = strlen(CUTSKY_MASK_CACHE_EXT);
+
+  char *fcache = malloc(dlen + blen + hlen + elen + 1);
+  if (!fcache) return NULL;
+  if (dlen) {
+    memcpy(fcache, conf->mcdir, dlen - 1);
+    fcache[dlen - 1] = CUTSKY_PATH_SEP;
+  }
+  memcpy(fcache + dlen, base, blen);
+  if (hlen) {
+    sprintf(fcache + dlen + blen, ".%016llx",
+        (unsigned long long) path_hash(fname));
+  }
+  memcpy(fcache + dlen + blen + hlen, CUTSKY_MASK_CACHE_EXT, elen + 1);
+  return fcache;
+}
+
+/******************************************************************************
+Function `load_foot`:
+  Load a Mangle polygon-format footprint, with the optional binary cache.
+Arguments:
+  * `conf`:     structure for storing configurations;
+  * `fname`:    filename of the polygon file;
+  * `wmin`:     minimum weight of polygons to be kept;
+  * `err`:      an integer for indicating error messages.
+Return:
+  Address of the structure for the footprint.
+******************************************************************************/
+static MANGLE *load_foot(const CONF *conf, const char *fname,
+    const double wmin, int *err) {
+  char *fcache = NULL;
+  if (conf->mcache && !(fcache = mask_cache_name(conf, fname))) {
+    P_WRN("failed to allocate memory for the mask cache name\n");
+  }
+
+  MANGLE *foot = mangle_init(fname, wmin, fcache, err);
+  if (foot && !(*err)) {
+    switch (foot->cache) {
+      case MANGLE_CACHE_LOADED:
+        if (conf->verbose) printf("  Binary cache mapped: `%s'\n", fcache);
+        break;
+      case MANGLE_CACHE_SAVED:
+        if (conf->verbose) printf("  Binary cache created: `%s'\n", fcache);
+        break;
+      case MANGLE_CACHE_FAILED:
+        P_WRN("failed to create the binary cache: `%s'\n", fcache);
+        break;
+      default:
+        break;
+    }
+  }
+
+  if (fcache) free(fcache);
+  return foot;
+}
+
+/******************************************************************************
+Function `load_tracer`:
+  Load the footprint and n(z) of a tracer.
+Arguments:
+  * `conf`:     structure for storing configurations;
+  * `geom`:     interface for survey geometry;
+  * `idx`:      index of the tracer.
+Return:
+  Zero on success; non-zero on error.
+******************************************************************************/
+static int load_tracer(const CONF *conf, GEOM *geom, const int idx) {
+  TRACER *trc = geom->trc + idx;
+  const char *ftrim = conf->foot_all;
+  const char *fnz = conf->fnz;
+  trc->zmin = conf->zmin;
+  trc->zmax = conf->zmax;
+  if (conf->trc) {
+    char *const *entry = conf->trc + (size_t) idx * CUTSKY_TRACER_NFIELD;
+    ftrim = entry[0];
+    fnz = entry[1];
+    trc->zmin = conf->tzlim[2 * idx];
+    trc->zmax = conf->tzlim[2 * idx + 1];
+  }
+
+  /* Tracers with the same footprint share the polygons. */
+  for (int i = 0; conf->trc && i < idx; i++) {
+    if (!strcmp(ftrim, conf->trc[(size_t) i * CUTSKY_TRACER_NFIELD])) {
+      trc->foot = geom->trc[i].foot;
+      trc->shared = true;
+      break;
+    }
+  }
+  if (!trc->foot) {
+    int err = 0;
+    trc->foot = load_foot(conf, ftrim, CUTSKY_WMIN_FOOT_ALL, &err);
+    if (!trc->foot || err) {
+      P_ERR("failed to process the entire footprint: %s\n",
+          mangle_errmsg(err));
+      return CUTSKY_ERR_GEOM;
+    }
+    if (conf->verbose)
+      printf("  The entire DESI footprint is loaded from `%s'\n", ftrim);
+  }
 
+  /* Load the n(z) file and prepare for the interpolation. */
+  if (fnz) {
+    if (load_nz(trc, fnz, trc->zmin, trc->zmax)) return CUTSKY_ERR_FILE;
+    if (conf->verbose)
+      printf("  %d n(z) samples read from file `%s'\n", trc->nsp, fnz);
+  }
   return 0;
 }
 
+/******************************************************************************
+Function `region_range`:
+  Set the coordinate ranges of a sky region.
+Arguments:
+  * `reg`:      the sky region;
+  * `ra_min`:   minimum right ascension, in degrees;
+  * `ra_max`:   maximum right ascension, in degrees;
+  * `dec_min`:  minimum declination, in degrees;
+  * `dec_max`:  maximum declination, in degrees.
+******************************************************************************/
+static void region_range(REGION *reg, const double ra_min, const double ra_max,
+    const double dec_min, const double dec_max) {
+  double width = ra_max - ra_min;
+  if (width < 0) width += 360;          /* range across RA = 0 */
+  reg->ra_all = (width >= 360);
+  reg->wide = (width > 180);
+  reg->ra[0] = ra_min * DEGREE_2_RAD;
+  reg->ra[1] = width * DEGREE_2_RAD;
+  reg->bound[0][0] = cos(ra_min * DEGREE_2_RAD);
+  reg->bound[0][1] = sin(ra_min * DEGREE_2_RAD);
+  reg->bound[1][0] = cos(ra_max * DEGREE_2_RAD);
+  reg->bound[1][1] = sin(ra_max * DEGREE_2_RAD);
+  /* The poles are always included for the full declination range. */
+  reg->sdec[0] = (dec_min <= -90) ? -2 : sin(dec_min * DEGREE_2_RAD);
+  reg->sdec[1] = (dec_max >= 90) ? 2 : sin(dec_max * DEGREE_2_RAD);
+}
+
+/******************************************************************************
+Function `region_contains`:
+  Check if a direction is inside a sky region.
+Arguments:
+  * `reg`:      the sky region;
+  * `v`:        unit vector of the direction.
+Return:
+  True if the direction is inside the region.
+******************************************************************************/
+static inline bool region_contains(const REGION *reg, const double *v) {
+  bool in = true;
+  if (!reg->ra_all) {
+    /* Signs of the cross products indicate the sides of the bounds. */
+    const double c1 = reg->bound[0][0] * v[1] - reg->bound[0][1] * v[0];
+    const double c2 = v[0] * reg->bound[1][1] - v[1] * reg->bound[1][0];
+    in = reg->wide ? (c1 > 0 || c2 > 0) : (c1 > 0 && c2 > 0);
+  }
+  if (in) in = v[2] >= reg->sdec[0] && v[2] < reg->sdec[1];
+  if (in && reg->mask) in = geom_infoot_vec(reg->mask, v) != NULL;
+  return in != reg->inv;
+}
+
+/******************************************************************************
+Function `region_pix`:
+  Classify a pixel of the region map with respect to a sky region.
+Arguments:
+  * `reg`:      the sky region;
+  * `idx`:      index of the pixel;
+  * `bound`:    ranges of the azimuth angle and the sine of the elevation
+                angle of the pixel, extended by `CUTSKY_REGION_TOL`.
+Return:
+  MANGLE_CLS_IN if the pixel is fully inside the region; MANGLE_CLS_OUT if
+  the pixel is fully outside the region; MANGLE_CLS_EDGE otherwise.
+******************************************************************************/
+static int region_pix(const REGION *reg, const int idx, const double *bound) {
+  int cls = MANGLE_CLS_IN;
+  if (!reg->ra_all) {
+    /* Azimuth range of the pixel, relative to the minimum RA. */
+    double d0 = fmod(bound[0] - reg->ra[0], 2 * M_PI);
+    if (d0 < 0) d0 += 2 * M_PI;
+    const double d1 = d0 + bound[1] - bound[0];
+    if (d0 > reg->ra[1] && d1 < 2 * M_PI) cls = MANGLE_CLS_OUT;
+    else if (d0 <= 0 || d1 >= reg->ra[1]) cls = MANGLE_CLS_EDGE;
+  }
+  if (cls != MANGLE_CLS_OUT) {
+    if (bound[3] < reg->sdec[0] || bound[2] >= reg->sdec[1])
+      cls = MANGLE_CLS_OUT;
+    else if (bound[2] <= reg->sdec[0] || bound[3] >= reg->sdec[1])
+      cls = MANGLE_CLS_EDGE;
+  }
+  if (cls != MANGLE_CLS_OUT && reg->mask) {
+    const int mcls = mangle_pix_status(reg->mask, CUTSKY_REGION_RES, idx);
+    if (mcls != MANGLE_CLS_IN) cls = mcls;
+  }
+  if (reg->inv && cls != MANGLE_CLS_EDGE)
+    cls = (cls == MANGLE_CLS_IN) ? MANGLE_CLS_OUT : MANGLE_CLS_IN;
+  return cls;
+}
+
+/******************************************************************************
+Function `region_map`:
+  Classify all pixels of the `simple` pixelization scheme with respect to the
+  sky regions, for routing directions to the regions.
+Arguments:
+  * `geom`:     interface for survey geometry.
+Return:
+  Number of pixels crossed by boundaries of regions; negative on error.
+******************************************************************************/
+static int region_map(GEOM *geom) {
+  const int nside = 1 << CUTSKY_REGION_RES;
+  const int npix = nside * nside;
+  if (!(geom->rmap = malloc(npix * sizeof(uint16_t))) ||
+      !(geom->azi = mangle_azidx_init(CUTSKY_REGION_RES))) return -1;
+
+  int nedge = 0;
+  for (int idx = 0; idx < npix; idx++) {
+    const int n = idx >> CUTSKY_REGION_RES;
+    const int m = idx & (nside - 1);
+    double bound[4];
+    bound[0] = 2 * M_PI * m / nside - CUTSKY_REGION_TOL;
+    bound[1] = 2 * M_PI * (m + 1) / nside + CUTSKY_REGION_TOL;
+    bound[2] = 1 - 2.0 * (n + 1) / nside - CUTSKY_REGION_TOL;
+    bound[3] = 1 - 2.0 * n / nside + CUTSKY_REGION_TOL;
+
+    /* Regions fully covering the pixel are recorded in the low byte, and
+       those to be tested for directions in the pixel in the high byte. */
+    uint16_t code = 0;
+    for (int i = 0; i < geom->nreg; i++) {
+      const int cls = region_pix(geom->reg + i, idx, bound);
+      if (cls == MANGLE_CLS_IN) code |= 1U << i;
+      else if (cls == MANGLE_CLS_EDGE) code |= 1U << (i + CUTSKY_MAX_REGION);
+    }
+    geom->rmap[idx] = code;
+    if (code >> CUTSKY_MAX_REGION) nedge++;
+  }
+  return nedge;
+}
+
 /******************************************************************************
 Function `bin_search`:
   Binary search the x coordinate for interpolation.
@@ -124,59 +412,112 @@ GEOM *geom_init(const CONF *conf) {
     P_ERR("failed to allocate memory for survey geometry\n");
     return NULL;
   }
-  geom->foot[0] = geom->foot[1] = NULL;
-  geom->rng = NULL;
-  geom->z = geom->nz = geom->nzpp = NULL;
-  geom->nsp = 0;
+  geom->foot = NULL;
+  geom->trc = NULL;
+  geom->obs = NULL;
+  geom->reg = NULL;
+  geom->rmap = NULL;
+  geom->azi = NULL;
+  geom->ntrc = geom->nreg = 0;
   geom->infoot = CUTSKY_BITCODE_INFOOT;
   geom->rad_sel = CUTSKY_BITCODE_RAD_SEL;
 
-  /* Process Mangle polygon-format footprints. */
-  int err = 0;
-  geom->foot[0] = mangle_init(conf->foot_all, CUTSKY_WMIN_FOOT_ALL, &err);
-  if (!(geom->foot[0]) || err) {
-    P_ERR("failed to process the entire footprint: %s\n", mangle_errmsg(err));
+  /* Process footprints and n(z) of the tracers. */
+  if (!(geom->trc = calloc(conf->ntrc, sizeof(TRACER)))) {
+    P_ERR("failed to allocate memory for survey geometry\n");
     geom_destroy(geom);
     return NULL;
   }
-  if (conf->verbose)
-    printf("  The entire DESI footprint is loaded from `%s'\n", conf->foot_all);
-
-  if (conf->foot) {
-    geom->foot[1] = mangle_init(conf->foot, CUTSKY_WMIN_FOOT, &err);
-    if (!(geom->foot[1]) || err) {
-      P_ERR("failed to process the footprint of interest: %s\n",
-          mangle_errmsg(err));
+  geom->ntrc = conf->ntrc;
+  for (int i = 0; i < geom->ntrc; i++) {
+    if (load_tracer(conf, geom, i)) {
       geom_destroy(geom);
       return NULL;
     }
-    if (conf->verbose)
-      printf("  The footprint of interest is loaded from `%s'\n", conf->foot);
   }
 
-  /* Load the n(z) file and prepare for the interpolation. */
-  if (conf->fnz) {
-    if (load_nz(geom, conf->fnz, conf->zmin, conf->zmax)) {
+  /* Positions and rotations of the observers, at the origin by default. */
+  if (!(geom->obs = calloc(conf->nobs, sizeof(OBSERVER)))) {
+    P_ERR("failed to allocate memory for survey geometry\n");
+    geom_destroy(geom);
+    return NULL;
+  }
+  geom->nobs = conf->nobs;
+  for (int i = 0; i < geom->nobs; i++) {
+    OBSERVER *obs = geom->obs + i;
+    for (int j = 0; j < 3; j++) obs->rot[j][j] = 1;
+    if (!conf->obs) continue;
+    const double *entry = conf->obs + (size_t) i * CUTSKY_OBSERVER_NFIELD;
+    for (int j = 0; j < 3; j++) {
+      obs->pos[j] = entry[j];
+      if (obs->pos[j] != 0) obs->shift = true;
+    }
+    for (int j = 0; j < 3; j++) {
+      for (int k = 0; k < 3; k++) {
+        obs->rot[j][k] = entry[3 + 3 * j + k];
+        if (obs->rot[j][k] != (j == k)) obs->rotate = true;
+      }
+    }
+  }
+
+  /* Sky regions, with NGC being a right ascension range, and SGC the rest. */
+  if (!(geom->reg = calloc(conf->nreg, sizeof(REGION)))) {
+    P_ERR("failed to allocate memory for survey geometry\n");
+    geom_destroy(geom);
+    return NULL;
+  }
+  geom->nreg = conf->nreg;
+  for (int i = 0; i < geom->nreg; i++) {
+    REGION *reg = geom->reg + i;
+    if (!conf->reg) {
+      region_range(reg, DESI_NGC_RA_MIN, DESI_NGC_RA_MAX, -90, 90);
+      reg->inv = (conf->gcap[i] == 'S');
+      continue;
+    }
+
+    const double *lim = conf->rlim + 4 * i;
+    region_range(reg, lim[0], lim[1], lim[2], lim[3]);
+    const char *fmask = conf->reg[(size_t) i * CUTSKY_REGION_NFIELD + 4];
+    if (!strcmp(fmask, CUTSKY_REGION_NOMASK)) continue;
+    int err = 0;
+    reg->mask = load_foot(conf, fmask, CUTSKY_WMIN_FOOT, &err);
+    if (!(reg->mask) || err) {
+      P_ERR("failed to process the polygons of region %d: %s\n", i + 1,
+          mangle_errmsg(err));
       geom_destroy(geom);
       return NULL;
     }
+    if (conf->verbose)
+      printf("  Polygons of region %d are loaded from `%s'\n", i + 1, fmask);
+  }
 
-    /* Initialise random number generator. */
+  const int nedge = region_map(geom);
+  if (nedge < 0) {
+    P_ERR("failed to allocate memory for survey geometry\n");
+    geom_destroy(geom);
+    return NULL;
+  }
+  if (conf->verbose) {
+    printf("  %d sky regions are mapped to %d pixels, with %d pixels on the "
+        "boundaries\n", geom->nreg, 1 << (CUTSKY_REGION_RES << 1), nedge);
+  }
+
+  /* Seeds of the counter-based random number generator. */
+  geom->nsub = conf->fnz ? conf->nsub : 0;
+  if (conf->fnz) geom_set_seed(geom, conf->seed, conf->ncat);
+
+  /* Process the Mangle polygon-format footprint of interest. */
+  if (conf->foot) {
     int err = 0;
-    for (int i = 0; i < conf->ncap; i++) geom->seed[i] = conf->seed[i];
-#ifdef OMP
-    geom->rng = prand_init(conf->rng, geom->seed[0], conf->nthread, 0, &err);
-#else
-    geom->rng = prand_init(conf->rng, geom->seed[0], 1, 0, &err);
-#endif
-    if (PRAND_IS_ERROR(err) || PRAND_IS_WARN(err)) {
-      P_ERR("failed to initialise the random number generator\n");
+    geom->foot = load_foot(conf, conf->foot, CUTSKY_WMIN_FOOT, &err);
+    if (!(geom->foot) || err) {
+      P_ERR("failed to process the footprint of interest: %s\n",
+          mangle_errmsg(err));
       geom_destroy(geom);
       return NULL;
     }
-
     if (conf->verbose)
-      printf("  %d n(z) samples read from file `%s'\n", geom->nsp, conf->fnz);
+      printf("  The footprint of interest is loaded from `%s'\n", conf->foot);
   }
 
   printf(FMT_DONE);
@@ -191,12 +532,26 @@ Arguments:
 ******************************************************************************/
 void geom_destroy(GEOM *geom) {
   if (!geom) return;
-  if (geom->foot[0]) mangle_destroy(geom->foot[0]);
-  if (geom->foot[1]) mangle_destroy(geom->foot[1]);
-  if (geom->rng) prand_destroy(geom->rng);
-  if (geom->z) free(geom->z);
-  if (geom->nz) free(geom->nz);
-  if (geom->nzpp) free(geom->nzpp);
+  if (geom->trc) {
+    for (int i = 0; i < geom->ntrc; i++) {
+      TRACER *trc = geom->trc + i;
+      if (trc->foot && !trc->shared) mangle_destroy(trc->foot);
+      if (trc->z) free(trc->z);
+      if (trc->nz) free(trc->nz);
+      if (trc->nzpp) free(trc->nzpp);
+    }
+    free(geom->trc);
+  }
+  if (geom->obs) free(geom->obs);
+  if (geom->reg) {
+    for (int i = 0; i < geom->nreg; i++) {
+      if (geom->reg[i].mask) mangle_destroy(geom->reg[i].mask);
+    }
+    free(geom->reg);
+  }
+  if (geom->rmap) free(geom->rmap);
+  if (geom->azi) mangle_azidx_destroy(geom->azi);
+  if (geom->foot) mangle_destroy(geom->foot);
   free(geom);
 }
 
@@ -204,16 +559,91 @@ void geom_destroy(GEOM *geom) {
 Function `geom_get_nz`:
   Compute the expected comoving density given redshift by interpolating n(z).
 Arguments:
-  * `geom`:     interface for survey geometry;
+  * `trc`:      selection of the tracer;
   * `z`:        the given redshift.
 Return:
   The comoving density on success; HUGE_VAL on error.
 ******************************************************************************/
-double geom_get_nz(const GEOM *geom, const double z) {
-  int idx = bin_search(geom->z, geom->nsp, z);
+double geom_get_nz(const TRACER *trc, const double z) {
+  int idx = bin_search(trc->z, trc->nsp, z);
   if (idx == INT_MAX) return HUGE_VAL;
 
-  double nz = (idx == geom->nsp - 1) ? geom->nz[idx] :
-      cspline_eval(geom->z, geom->nz, geom->nzpp, z, idx);
+  double nz = (idx == trc->nsp - 1) ? trc->nz[idx] :
+      cspline_eval(trc->z, trc->nz, trc->nzpp, z, idx);
   return nz;
 }
+
+/******************************************************************************
+Function `geom_max_nz`:
+  Compute an upper bound of the interpolated n(z) in a redshift range.
+Arguments:
+  * `trc`:      selection of the tracer;
+  * `zmin`:     the minimum redshift of the range;
+  * `zmax`:     the maximum redshift of the range.
+Return:
+  The upper bound of the comoving density.
+******************************************************************************/
+double geom_max_nz(const TRACER *trc, const double zmin, const double zmax) {
+  const double *z = trc->z;
+  const double *nz = trc->nz;
+  const double *ypp = trc->nzpp;
+  double max = 0;
+  for (int i = 0; i < trc->nsp - 1; i++) {
+    if (z[i + 1] < zmin || z[i] > zmax) continue;
+
+    /* The cubic terms of the spline on the interval are bounded by the
+       negative second derivatives, times h^2 / (9 sqrt(3)). */
+    const double h = z[i + 1] - z[i];
+    double bound = (nz[i] > nz[i + 1]) ? nz[i] : nz[i + 1];
+    if (ypp[i] < 0) bound -= ypp[i] * h * h * SPLINE_CUBIC_BOUND;
+    if (ypp[i + 1] < 0) bound -= ypp[i + 1] * h * h * SPLINE_CUBIC_BOUND;
+    if (bound > max) max = bound;
+  }
+
+  /* Leave room for rounding errors of the interpolation. */
+  return max * (1 + DOUBLE_TOL);
+}
+
+/******************************************************************************
+Function `geom_region`:
+  Find the sky regions containing a direction, with the regions that cover a
+  pixel entirely looked up from the map, and the others tested only if their
+  boundaries cross the pixel.
+Arguments:
+  * `geom`:     interface for survey geometry;
+  * `v`:        unit vector of the direction in the equatorial frame.
+Return:
+  Bitmask of the regions containing the direction.
+******************************************************************************/
+unsigned int geom_region(const GEOM *geom, const double *v) {
+  /* Pixel of the direction, following the `simple` pixelization scheme.
+     Rounding errors are absorbed by the margins of the pixels. */
+  const int nside = 1 << CUTSKY_REGION_RES;
+  const int m = mangle_azidx_pix(geom->azi, v);
+  int n = (v[2] >= 1) ? 0 : ceil((1 - v[2]) * 0.5 * nside) - 1;
+  if (n >= nside) n = nside - 1;
+
+  const unsigned int code = geom->rmap[(n << CUTSKY_REGION_RES) + m];
+  unsigned int in = code & ((1U << CUTSKY_MAX_REGION) - 1);
+  const unsigned int edge = code >> CUTSKY_MAX_REGION;
+  for (int i = 0; edge >> i; i++) {
+    if ((edge >> i & 1) && region_contains(geom->reg + i, v)) in |= 1U << i;
+  }
+  return in;
+}
+
+/******************************************************************************
+Function `geom_set_seed`:
+  Set seeds for radial selection of all catalogs and subsamples.
+Arguments:
+  * `geom`:     interface for survey geometry;
+  * `seed`:     seeds of the catalogs;
+  * `ncat`:     number of catalogs.
+******************************************************************************/
+void geom_set_seed(GEOM *geom, const long *seed, const int ncat) {
+  /* The first subsample is drawn with the seeds of the catalogs. */
+  for (int k = 0; k < geom->nsub; k++) {
+    for (int i = 0; i < ncat; i++)
+      geom->seed[k][i] = crand_seed_split(seed[i], k);
+  }
+}
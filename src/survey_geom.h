@@ -33,21 +33,59 @@
 
 #include "load_conf.h"
 #include "mangle.h"
-#include "prand.h"
 #include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
 
 /*============================================================================*\
                        Data structure for survey geometry
 \*============================================================================*/
 
+/* Selection of a tracer: footprint, redshift range, and n(z). */
 typedef struct {
-  MANGLE *foot[2];      /* DESI entire and current footprints      */
-  prand_t *rng;         /* interface of random number generator    */
-  size_t seed[2];       /* random seeds                            */
+  MANGLE *foot;         /* DESI entire footprint of the tracer     */
+  bool shared;          /* indicate if the footprint is shared     */
+  double zmin;          /* minimum redshift of the tracer          */
+  double zmax;          /* maximum redshift of the tracer          */
   double *z;            /* array for redshift values               */
   double *nz;           /* array for comoving number densities     */
   double *nzpp;         /* second derivative of comoving densities */
   int nsp;              /* number of n(z) samples                  */
+} TRACER;
+
+/* Observer of the box: position and rotation of the sky. */
+typedef struct {
+  double pos[3];        /* position of the observer in the box     */
+  double rot[3][3];     /* rotation matrix for the directions      */
+  bool shift;           /* indicate if the observer is off origin  */
+  bool rotate;          /* indicate if the rotation is non-trivial */
+} OBSERVER;
+
+/* Sky region of the outputs: ranges of coordinates, and polygons. */
+typedef struct {
+  MANGLE *mask;         /* polygons of the region, NULL for none   */
+  double bound[2][2];   /* unit vectors on the equator for the RA  */
+                        /* limits of the region                    */
+  double ra[2];         /* minimum and width of RA, in radians     */
+  double sdec[2];       /* sines of the minimum and maximum Dec    */
+  bool ra_all;          /* indicate if RA is not limited           */
+  bool wide;            /* indicate if the RA range exceeds 180    */
+  bool inv;             /* indicate if the complement is taken     */
+} REGION;
+
+typedef struct {
+  MANGLE *foot;         /* DESI current footprint                  */
+  TRACER *trc;          /* selections of the tracers               */
+  int ntrc;             /* number of tracers                       */
+  OBSERVER *obs;        /* positions and rotations of observers    */
+  int nobs;             /* number of observers                     */
+  REGION *reg;          /* sky regions, or galactic caps           */
+  int nreg;             /* number of sky regions                   */
+  uint16_t *rmap;       /* regions fully covering (low byte) and   */
+                        /* crossing (high byte) each pixel         */
+  MANGLE_AZIDX *azi;    /* azimuthal pixel lookup of the region map */
+  int nsub;             /* number of radial selection subsamples   */
+  uint64_t seed[CUTSKY_MAX_SUBSAMPLE][CUTSKY_MAX_NCAT];  /* seeds */
   uint8_t infoot;       /* bitcode for the current footprint       */
   uint8_t rad_sel;      /* bitcode for radial selection            */
 } GEOM;
@@ -68,6 +106,17 @@ Return:
 ******************************************************************************/
 #define geom_infoot(foot, ra, dec)      mangle_query(foot, ra, dec)
 
+/******************************************************************************
+Macro `geom_infoot_vec`:
+  Check if a direction is inside a given footprint.
+Arguments:
+  * `foot`:     the footprint;
+  * `v`:        unit vector of the direction in the equatorial frame.
+Return:
+  NULL if the direction is NOT inside the footprint.
+******************************************************************************/
+#define geom_infoot_vec(foot, v)        mangle_query_vec(foot, v)
+
 /******************************************************************************
 Function `geom_init`:
   Initialise the interface for applying survey geometry.
@@ -90,11 +139,46 @@ void geom_destroy(GEOM *geom);
 Function `geom_get_nz`:
   Compute the expected comoving density given redshift by interpolating n(z).
 Arguments:
-  * `geom`:     interface for survey geometry;
+  * `trc`:      selection of the tracer;
   * `z`:        the given redshift.
 Return:
   The comoving density on success; HUGE_VAL on error.
 ******************************************************************************/
-double geom_get_nz(const GEOM *geom, const double z);
+double geom_get_nz(const TRACER *trc, const double z);
+
+/******************************************************************************
+Function `geom_max_nz`:
+  Compute an upper bound of the interpolated n(z) in a redshift range.
+Arguments:
+  * `trc`:      selection of the tracer;
+  * `zmin`:     the minimum redshift of the range;
+  * `zmax`:     the maximum redshift of the range.
+Return:
+  The upper bound of the comoving density.
+******************************************************************************/
+double geom_max_nz(const TRACER *trc, const double zmin, const double zmax);
+
+/******************************************************************************
+Function `geom_region`:
+  Find the sky regions containing a direction, with the regions that cover a
+  pixel entirely looked up from the map, and the others tested only if their
+  boundaries cross the pixel.
+Arguments:
+  * `geom`:     interface for survey geometry;
+  * `v`:        unit vector of the direction in the equatorial frame.
+Return:
+  Bitmask of the regions containing the direction.
+******************************************************************************/
+unsigned int geom_region(const GEOM *geom, const double *v);
+
+/******************************************************************************
+Function `geom_set_seed`:
+  Set seeds for radial selection of all catalogs and subsamples.
+Arguments:
+  * `geom`:     interface for survey geometry;
+  * `seed`:     seeds of the catalogs;
+  * `ncat`:     number of catalogs.
+******************************************************************************/
+void geom_set_seed(GEOM *geom, const long *seed, const int ncat);
 
 #endif